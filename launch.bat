@@ -11,6 +11,7 @@ set "OUT_DIR=web"
 set "TEMP_BUILD_DIR=temp_build"
 set "LOG_DIR=logs"
 set "SOURCE_FILE=%SRC_DIR%\engine.cpp"
+set "ENSEMBLE_FILE=%SRC_DIR%\ensemble.cpp"
 set "OUTPUT_FILE=%OUT_DIR%\engine.js"
 set "PORT=8005"
 set "SERVER_SCRIPT=server.py"
@@ -117,7 +118,7 @@ set "TEMP_OUT=%TEMP_BUILD_DIR%\engine.js"
 if exist "%TEMP_OUT%" del "%TEMP_OUT%"
 
 :: Generate temp batch for compilation command to handle complexity
-echo emcc %EMCC_FLAGS% "%SOURCE_FILE%" -o "%TEMP_OUT%" > build_step.bat
+echo emcc %EMCC_FLAGS% "%SOURCE_FILE%" "%ENSEMBLE_FILE%" -o "%TEMP_OUT%" > build_step.bat
 
 :: Execute using PowerShell to allow Tee-Object (Shows output in console AND saves to file)
 powershell -Command ".\build_step.bat 2>&1 | Tee-Object -FilePath '%LOG_DIR%\compile.log'"
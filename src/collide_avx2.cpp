@@ -0,0 +1,19 @@
+// Eight-lane collision kernels. Native x86 builds define FLUID_AVX2_KERNELS for engine.cpp, which
+// picks them at runtime on CPUs with AVX2. Only the kernel code is compiled for AVX2: the engine
+// and standard headers come first, for the baseline, so any inline function this unit emits out
+// of line is the same code engine.o emits, whichever copy the linker keeps.
+#include "engine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define SIMD_AVX2
+#include "collide_simd.h"
+
+#define FLUID_AVX2_KERNEL(W, H) template void FluidEngine::collideRows<8, W, H>(int startY, int endY, CollideBand& band);
+FLUID_AVX2_KERNEL(0, 0)
+FLUID_GRID_SIZES(FLUID_AVX2_KERNEL)
+#pragma GCC pop_options
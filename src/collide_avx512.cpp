@@ -0,0 +1,18 @@
+// Sixteen-lane collision kernels. Native x86 builds define FLUID_AVX512_KERNELS for engine.cpp,
+// which picks them at runtime on CPUs with AVX-512F. As in collide_avx2.cpp, only the kernel code
+// is compiled for the wider instruction set.
+#include "engine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#define SIMD_AVX512
+#include "collide_simd.h"
+
+#define FLUID_AVX512_KERNEL(W, H) template void FluidEngine::collideRows<16, W, H>(int startY, int endY, CollideBand& band);
+FLUID_AVX512_KERNEL(0, 0)
+FLUID_GRID_SIZES(FLUID_AVX512_KERNEL)
+#pragma GCC pop_options
@@ -0,0 +1,314 @@
+#pragma once
+#include "engine.h"
+#include "grid_sizes.h"
+#include "lattice.h"
+#include "simd.h"
+#include <type_traits>
+
+// Collision and push streaming for rows [startY, endY), N cells per vector step. A run of N cells
+// that cannot take the vector path tries a 4-cell step before falling back to collideCell for
+// cells next to walls, solids or sponges, so every width visits cells in the same blocks as the
+// 4-wide kernel and, lane for lane, repeats its arithmetic: all widths produce the same fields
+// bit for bit. The engine instantiates N = 4; native x86 builds add N = 8 and N = 16 from
+// collide_avx2.cpp and collide_avx512.cpp. The block body is a lambda so each instantiation keeps
+// its own copy, compiled for the instruction set of its translation unit. Nonzero W and H fix
+// the lattice size at compile time (see grid_sizes.h); the locals shadow the members so the body
+// reads the same either way.
+template <int N, int W, int H>
+void FluidEngine::collideRows(int startY, int endY, CollideBand& band) {
+    const int w = W > 0 ? W : this->w;
+    const int h = H > 0 ? H : this->h;
+    const bool diag = band.diagnostics;
+    const bool forces = band.forces;
+    const bool stats = band.stats;
+
+    auto vectorizable = [&](int x, int y, int lanes) {
+        if (x < 1 || x > w - lanes - 1 || y <= 0 || y >= h - 1 || band.useNonNewtonian) return false;
+        int idx = y * w + x;
+        unsigned char solid = 0;
+        for (int i = 0; i < lanes; ++i) solid |= barriers[idx + i];
+        if (solid != 0) return false;
+        if (spongeStrength > 0.0f && spongeWidth > 0) {
+             bool in_sponge = (spongeLeft && x < spongeWidth) ||
+                              (spongeRight && (x + lanes - 1) >= w - spongeWidth) ||
+                              (spongeTop && y >= h - spongeWidth) ||
+                              (spongeBottom && y < spongeWidth);
+             if (in_sponge) return false;
+        }
+        return true;
+    };
+
+    // acc holds the row's diagnostics partials: mass, kinetic energy, peak speed squared, dye,
+    // heat and clamped cells.
+    auto block = [&](auto width, int idx, bool rowClear, auto* acc) {
+        constexpr int M = decltype(width)::value;
+        using V = simd::Vec<M>;
+        const V v_zero = simd::splat<M>(0.0f);
+        const V v_one = simd::splat<M>(1.0f);
+        const V v_two = simd::splat<M>(2.0f);
+        const V v_three = simd::splat<M>(3.0f);
+        const V v_four_point_five = simd::splat<M>(4.5f);
+        const V v_one_point_five = simd::splat<M>(1.5f);
+        const V v_half = simd::splat<M>(0.5f);
+
+        V v_weights[9];
+        for(int k=0; k<9; ++k) v_weights[k] = simd::splat<M>(weights[k]);
+
+        V v_cx[9], v_cy[9];
+        for(int k=0; k<9; ++k) {
+            v_cx[k] = simd::splat<M>((float)cx[k]);
+            v_cy[k] = simd::splat<M>((float)cy[k]);
+        }
+
+        V v_f[9];
+        for(int k=0; k<9; ++k) v_f[k] = simd::load<M>(&f[k][idx]);
+
+        V v_rho = v_f[0];
+        V v_ux = simd::mul(v_f[0], v_cx[0]);
+        V v_uy = simd::mul(v_f[0], v_cy[0]);
+
+        for(int k=1; k<9; ++k) {
+            v_rho = simd::add(v_rho, v_f[k]);
+            v_ux = simd::madd(v_f[k], v_cx[k], v_ux);
+            v_uy = simd::madd(v_f[k], v_cy[k], v_uy);
+        }
+
+        V v_inv_rho = simd::div(v_one, v_rho);
+        V v_u_val = simd::mul(v_ux, v_inv_rho);
+        V v_v_val = simd::mul(v_uy, v_inv_rho);
+
+        simd::store<M>(&rho[idx], v_rho);
+
+        V v_fx = simd::load<M>(&forceX[idx]);
+        V v_fy = simd::load<M>(&forceY[idx]);
+        V v_gx = simd::splat<M>(gravityX);
+        V v_gy = simd::splat<M>(gravityY);
+
+        v_fx = simd::add(v_fx, v_gx);
+        v_fy = simd::add(v_fy, v_gy);
+
+        if (thermalExpansion != 0.0f) {
+            V v_temp = simd::load<M>(&temperature[idx]);
+            V v_refT = simd::splat<M>(referenceTemperature);
+            V v_exp = simd::splat<M>(thermalExpansion);
+            V v_buoyancy = simd::mul(v_gy, simd::mul(v_exp, simd::sub(v_temp, v_refT)));
+            v_fy = simd::add(v_fy, v_buoyancy);
+        }
+
+        V v_dt = simd::splat<M>(dt);
+        V v_porosity = simd::load<M>(&porosity[idx]);
+        V v_globalDrag = simd::splat<M>(globalDrag);
+        V v_porosityDrag = simd::splat<M>(porosityDrag);
+
+        V v_drag = simd::add(v_globalDrag, simd::mul(v_porosityDrag, simd::sub(v_one, v_porosity)));
+        V v_damp = simd::sub(v_one, v_drag);
+        v_damp = simd::max(v_damp, v_zero);
+
+        V v_u_eq = simd::mul(simd::madd(v_fx, v_dt, v_u_val), v_damp);
+        V v_v_eq = simd::mul(simd::madd(v_fy, v_dt, v_v_val), v_damp);
+
+        V v_maxVel = simd::splat<M>(maxVelocity);
+        V v_speedSq = simd::madd(v_u_eq, v_u_eq, simd::mul(v_v_eq, v_v_eq));
+        V v_speed = simd::sqrt(v_speedSq);
+        simd::Mask<M> v_over = simd::gt(v_speed, v_maxVel);
+
+        if (simd::anyTrue(v_over)) {
+            V v_ratio = simd::div(v_maxVel, v_speed);
+            v_u_eq = simd::select(v_over, simd::mul(v_u_eq, v_ratio), v_u_eq);
+            v_v_eq = simd::select(v_over, simd::mul(v_v_eq, v_ratio), v_v_eq);
+        }
+
+        simd::store<M>(&ux[idx], v_u_eq);
+        simd::store<M>(&uy[idx], v_v_eq);
+
+        if (stats) {
+            // Welford: mean += d / n, M2 += d * (x - new mean); the cross term
+            // pairs u's old-mean deviation with v's new-mean deviation.
+            V v_invN = simd::splat<M>(band.invSamples);
+            V v_mu = simd::load<M>(&statMeanU[idx]);
+            V v_mv = simd::load<M>(&statMeanV[idx]);
+            V v_du = simd::sub(v_u_eq, v_mu);
+            V v_dv = simd::sub(v_v_eq, v_mv);
+            v_mu = simd::madd(v_du, v_invN, v_mu);
+            v_mv = simd::madd(v_dv, v_invN, v_mv);
+            V v_du2 = simd::sub(v_u_eq, v_mu);
+            V v_dv2 = simd::sub(v_v_eq, v_mv);
+            simd::store<M>(&statMeanU[idx], v_mu);
+            simd::store<M>(&statMeanV[idx], v_mv);
+            simd::store<M>(&statM2U[idx], simd::madd(v_du, v_du2, simd::load<M>(&statM2U[idx])));
+            simd::store<M>(&statM2V[idx], simd::madd(v_dv, v_dv2, simd::load<M>(&statM2V[idx])));
+            simd::store<M>(&statCUV[idx], simd::madd(v_du, v_dv2, simd::load<M>(&statCUV[idx])));
+            V v_md = simd::load<M>(&statMeanDye[idx]);
+            v_md = simd::madd(simd::sub(simd::load<M>(&dye[idx]), v_md), v_invN, v_md);
+            simd::store<M>(&statMeanDye[idx], v_md);
+            V v_mt = simd::load<M>(&statMeanT[idx]);
+            v_mt = simd::madd(simd::sub(simd::load<M>(&temperature[idx]), v_mt), v_invN, v_mt);
+            simd::store<M>(&statMeanT[idx], v_mt);
+        }
+
+        V v_omega = simd::splat<M>(omega);
+        V v_feq[9];
+
+        V v_u2 = simd::madd(v_u_eq, v_u_eq, simd::mul(v_v_eq, v_v_eq));
+        if (diag) {
+            acc[0] = simd::add(acc[0], v_rho);
+            acc[1] = simd::madd(v_rho, v_u2, acc[1]);
+            acc[2] = simd::max(acc[2], v_speedSq);
+            acc[5] = simd::add(acc[5], simd::ones(v_over));
+            if (dyeActive) acc[3] = simd::add(acc[3], simd::load<M>(&dye[idx]));
+            if (temperatureActive) acc[4] = simd::add(acc[4], simd::load<M>(&temperature[idx]));
+            band.diag.fluidCells += M;
+        }
+        V v_u2_term = simd::mul(v_one_point_five, v_u2);
+
+        for(int k=0; k<9; ++k) {
+             V v_eu = simd::madd(v_cx[k], v_u_eq, simd::mul(v_cy[k], v_v_eq));
+             V v_t1 = simd::madd(v_three, v_eu, v_one);
+             V v_t2 = simd::sub(simd::mul(v_four_point_five, simd::mul(v_eu, v_eu)), v_u2_term);
+             v_feq[k] = simd::mul(v_weights[k], simd::mul(v_rho, simd::add(v_t1, v_t2)));
+        }
+
+        V v_Qxx = v_zero;
+        V v_Qxy = v_zero;
+        V v_Qyy = v_zero;
+        if (band.useSmagorinsky || band.collision == COLLISION_REGULARIZED) {
+            for(int k=0; k<9; ++k) {
+                V v_fneq = simd::sub(v_f[k], v_feq[k]);
+                v_Qxx = simd::madd(simd::mul(v_cx[k], v_cx[k]), v_fneq, v_Qxx);
+                v_Qxy = simd::madd(simd::mul(v_cx[k], v_cy[k]), v_fneq, v_Qxy);
+                v_Qyy = simd::madd(simd::mul(v_cy[k], v_cy[k]), v_fneq, v_Qyy);
+            }
+        }
+
+        if (band.useTempVisc || band.useSmagorinsky) {
+            V v_tau = simd::div(v_one, v_omega);
+            V v_nu = simd::div(simd::sub(v_tau, v_half), v_three);
+
+            if (band.useTempVisc) {
+                 V v_T = simd::load<M>(&temperature[idx]);
+                 V v_tvisc = simd::splat<M>(temperatureViscosity);
+                 V v_factor = simd::div(v_one, simd::add(v_one, simd::mul(v_tvisc, v_T)));
+                 v_nu = simd::mul(v_nu, v_factor);
+            }
+
+            if (band.useSmagorinsky) {
+                V v_magS_sq = simd::add(simd::mul(v_Qxx, v_Qxx),
+                                        simd::add(simd::mul(v_two, simd::mul(v_Qxy, v_Qxy)),
+                                                  simd::mul(v_Qyy, v_Qyy)));
+                V v_magS = simd::sqrt(v_magS_sq);
+
+                V v_smag = simd::splat<M>(smagorinskyConstant);
+                V v_eddy = simd::mul(simd::mul(v_smag, v_smag), v_magS);
+                v_nu = simd::add(v_nu, v_eddy);
+            }
+
+            V v_tau_eff = simd::madd(v_three, v_nu, v_half);
+            v_omega = simd::div(v_one, v_tau_eff);
+            v_omega = simd::max(v_omega, simd::splat<M>(0.05f));
+            v_omega = simd::min(v_omega, simd::splat<M>(1.95f));
+        }
+
+        V v_one_minus_omega = simd::sub(v_one, v_omega);
+        V v_post[9];
+
+        if (band.collision == COLLISION_BGK) {
+            for (int k = 0; k < 9; ++k)
+                v_post[k] = simd::madd(v_f[k], v_one_minus_omega, simd::mul(v_feq[k], v_omega));
+        } else {
+            // Recursive regularized BGK, as in collideCell, with the Hermite sums written out for
+            // the rest, axis and diagonal links so no lane multiplies a zero coefficient.
+            V v_dx = simd::sub(simd::mul(v_rho, v_u_eq), v_ux);
+            V v_dy = simd::sub(simd::mul(v_rho, v_v_eq), v_uy);
+            V v_axxy = simd::madd(simd::mul(v_two, v_u_eq), v_Qxy, simd::mul(v_v_eq, v_Qxx));
+            V v_axyy = simd::madd(simd::mul(v_two, v_v_eq), v_Qxy, simd::mul(v_u_eq, v_Qyy));
+            const V v_minus_three = simd::splat<M>(-3.0f);
+            const V v_nine = simd::splat<M>(9.0f);
+            const V v_minus_one_point_five = simd::splat<M>(-1.5f);
+            const V v_minus_four_point_five = simd::splat<M>(-4.5f);
+
+            V v_qsum = simd::add(v_Qxx, v_Qyy);
+            V v_sx = simd::madd(v_three, v_Qxx, simd::mul(v_minus_one_point_five, v_Qyy));
+            V v_sy = simd::madd(v_three, v_Qyy, simd::mul(v_minus_one_point_five, v_Qxx));
+            V v_ax = simd::madd(v_minus_three, v_dx, simd::mul(v_minus_four_point_five, v_axyy));
+            V v_ay = simd::madd(v_minus_three, v_dy, simd::mul(v_minus_four_point_five, v_axxy));
+            V v_sd = simd::mul(v_three, v_qsum);
+            V v_xy = simd::mul(v_nine, v_Qxy);
+            V v_bx = simd::madd(v_minus_three, v_dx, simd::mul(v_nine, v_axyy));
+            V v_by = simd::madd(v_minus_three, v_dy, simd::mul(v_nine, v_axxy));
+            V v_axis = simd::mul(simd::splat<M>(weights[1]), v_one_minus_omega);
+            V v_diag = simd::mul(simd::splat<M>(weights[5]), v_one_minus_omega);
+
+            v_post[0] = simd::madd(simd::mul(v_minus_one_point_five, v_qsum),
+                                   simd::mul(simd::splat<M>(weights[0]), v_one_minus_omega), v_feq[0]);
+            for (int k = 1; k < 9; ++k) {
+                V v_neq;
+                if (cy[k] == 0) {
+                    v_neq = cx[k] > 0 ? simd::add(v_sx, v_ax) : simd::sub(v_sx, v_ax);
+                } else if (cx[k] == 0) {
+                    v_neq = cy[k] > 0 ? simd::add(v_sy, v_ay) : simd::sub(v_sy, v_ay);
+                } else {
+                    v_neq = cx[k] * cy[k] > 0 ? simd::add(v_sd, v_xy) : simd::sub(v_sd, v_xy);
+                    v_neq = cx[k] > 0 ? simd::add(v_neq, v_bx) : simd::sub(v_neq, v_bx);
+                    v_neq = cy[k] > 0 ? simd::add(v_neq, v_by) : simd::sub(v_neq, v_by);
+                }
+                v_post[k] = simd::madd(v_neq, (cx[k] != 0 && cy[k] != 0) ? v_diag : v_axis, v_feq[k]);
+            }
+        }
+
+        for (int k = 0; k < 9; ++k) {
+            V v_out = v_post[k];
+
+            if (rowClear) {
+                simd::store<M>(&f_new[k][idx + cx[k] + cy[k] * w], v_out);
+                continue;
+            }
+
+            float out_vals[M];
+            simd::store<M>(out_vals, v_out);
+
+            int dest_base = idx + cx[k] + cy[k] * w;
+            for (int i = 0; i < M; ++i) {
+                int n_idx = dest_base + i;
+                if (!barriers[n_idx]) f_new[k][n_idx] = out_vals[i];
+                else {
+                    f_new[opp[k]][idx + i] = out_vals[i];
+                    if (forces) exchangeMomentum(band, n_idx, k, out_vals[i]);
+                }
+            }
+        }
+    };
+
+    auto flush = [&](auto* acc) {
+        band.diag.mass += simd::sumLanes(acc[0]);
+        band.diag.kinetic += simd::sumLanes(acc[1]);
+        band.diag.maxSpeedSq = std::max(band.diag.maxSpeedSq, simd::maxLanes(acc[2]));
+        band.diag.dye += simd::sumLanes(acc[3]);
+        band.diag.heat += simd::sumLanes(acc[4]);
+        band.diag.clampedCells += (uint64_t)simd::sumLanes(acc[5]);
+    };
+
+    simd::Vec<N> sums[6];
+    simd::Vec<4> sums4[6];
+    for (int y = startY; y < endY; ++y) {
+        const bool rowClear = rowsBarrierFree(y);
+        for (int i = 0; i < 6; ++i) {
+            sums[i] = simd::splat<N>(0.0f);
+            sums4[i] = simd::splat<4>(0.0f);
+        }
+        for (int x = 0; x < w; ++x) {
+            if (vectorizable(x, y, N)) {
+                block(std::integral_constant<int, N>(), y * w + x, rowClear, sums);
+                x += N - 1;
+            } else if (N > 4 && vectorizable(x, y, 4)) {
+                block(std::integral_constant<int, 4>(), y * w + x, rowClear, sums4);
+                x += 3;
+            } else {
+                collideCell(x, y, band);
+            }
+        }
+        if (diag) {
+            flush(sums);
+            if (N > 4) flush(sums4);
+        }
+    }
+}
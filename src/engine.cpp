@@ -1,20 +1,322 @@
 #include "engine.h"
+#include "collide_simd.h"
 #include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <cstdlib>
 #include <future>
 #include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#ifdef __wasm_simd128__
 #include <wasm_simd128.h>
-
+#endif
+#include <sys/stat.h>
+#ifndef __EMSCRIPTEN__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#define NUMA_PLACEMENT_SUPPORTED 1
+#endif
+// Worker, output and async threads exist in every native build and in WebAssembly builds with
+// pthreads; elsewhere the same calls run inline on the caller's thread.
+#if defined(__EMSCRIPTEN_PTHREADS__) || !defined(__EMSCRIPTEN__)
+#define FLUID_THREADS 1
+#endif
+
+#ifdef __EMSCRIPTEN__
 using namespace emscripten;
+#endif
+
+// Wider collision kernels live in their own translation units, compiled for AVX2 and AVX-512
+// (see collide_avx2.cpp, collide_avx512.cpp); native builds that link them define these macros.
+#ifdef FLUID_AVX2_KERNELS
+#define FLUID_AVX2_KERNEL(W, H) extern template void FluidEngine::collideRows<8, W, H>(int startY, int endY, CollideBand& band);
+FLUID_AVX2_KERNEL(0, 0)
+FLUID_GRID_SIZES(FLUID_AVX2_KERNEL)
+#undef FLUID_AVX2_KERNEL
+#endif
+#ifdef FLUID_AVX512_KERNELS
+#define FLUID_AVX512_KERNEL(W, H) extern template void FluidEngine::collideRows<16, W, H>(int startY, int endY, CollideBand& band);
+FLUID_AVX512_KERNEL(0, 0)
+FLUID_GRID_SIZES(FLUID_AVX512_KERNEL)
+#undef FLUID_AVX512_KERNEL
+#endif
+
+static bool simdWidthSupported(int width) {
+    switch (width) {
+    case 4: return true;
+#ifdef FLUID_AVX2_KERNELS
+    case 8: return __builtin_cpu_supports("avx2");
+#endif
+#ifdef FLUID_AVX512_KERNELS
+    case 16: return __builtin_cpu_supports("avx512f");
+#endif
+    default: return false;
+    }
+}
+
+// Widest collision kernel at most `limit` lanes wide that this build and CPU can run.
+static int pickSimdWidth(int limit) {
+    int width = 4;
+    for (int candidate : {8, 16}) {
+        if (candidate <= limit && simdWidthSupported(candidate)) width = candidate;
+    }
+    return width;
+}
+
+// Counter-based RNG (Widynski "Squares"): a pure function of (key, counter), so it can be
+// evaluated independently per cell from any worker thread or SIMD lane.
+static inline uint64_t rngKey(uint32_t seed, uint32_t stream) {
+    uint64_t z = ((uint64_t)seed << 32 | stream) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return z | 1ull;
+}
+
+static inline uint32_t rngSquares32(uint64_t key, uint64_t ctr) {
+    uint64_t x = ctr * key;
+    uint64_t y = x;
+    uint64_t z = y + key;
+    x = x * x + y; x = (x >> 32) | (x << 32);
+    x = x * x + z; x = (x >> 32) | (x << 32);
+    x = x * x + y; x = (x >> 32) | (x << 32);
+    return (uint32_t)((x * x + z) >> 32);
+}
+
+static inline float rngSigned(uint64_t key, uint64_t ctr) {
+    return (float)(rngSquares32(key, ctr) >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+// IEEE binary16 conversion with round-to-nearest-even; overflow saturates to the largest finite half.
+static inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t mag = bits & 0x7FFFFFFFu;
+
+    if (mag >= 0x7F800000u) return (uint16_t)(sign | (mag > 0x7F800000u ? 0x7E00u : 0x7BFFu));
+    if (mag >= 0x477FF000u) return (uint16_t)(sign | 0x7BFFu);
+    if (mag < 0x38800000u) {
+        float sub;
+        uint32_t magBits = mag;
+        std::memcpy(&sub, &magBits, 4);
+        return (uint16_t)(sign | (uint32_t)(sub * 16777216.0f + 0.5f));
+    }
+    uint32_t rounded = mag + 0x0FFFu + ((mag >> 13) & 1u);
+    return (uint16_t)(sign | ((rounded - 0x38000000u) >> 13));
+}
+
+// Session journal: a header, a checkpoint of the state recording started from, then one entry per
+// mutating call as [op u8][varint steps since previous entry][arguments, little-endian].
+namespace {
+const uint32_t JOURNAL_MAGIC = 0x524A424Cu;
+const uint32_t JOURNAL_VERSION = 1;
+// Power of two; at 64 bytes a slot this is 64 KB, far more than a frame's worth of UI edits.
+const uint32_t COMMAND_RING_SIZE = 1024;
+
+enum JournalOp {
+    OP_LOAD_CHECKPOINT = 0,
+    OP_STEP = 1,
+    OP_ADD_FORCE,
+    OP_SET_VISCOSITY,
+    OP_SET_DECAY,
+    OP_SET_GLOBAL_DRAG,
+    OP_SET_BOUNDARY_CONDITIONS,
+    OP_SET_INFLOW_PROPERTIES,
+    OP_SET_MOVING_WALL_VELOCITY,
+    OP_SET_DT,
+    OP_SET_GRAVITY,
+    OP_SET_THERMAL_PROPERTIES,
+    OP_SET_THERMAL_DIFFUSIVITY,
+    OP_SET_VORTICITY_CONFINEMENT,
+    OP_SET_MAX_VELOCITY,
+    OP_SET_SMAGORINSKY_CONSTANT,
+    OP_SET_TEMPERATURE_VISCOSITY,
+    OP_SET_FLOW_BEHAVIOR_INDEX,
+    OP_SET_CONSISTENCY_INDEX,
+    OP_SET_POROSITY_DRAG,
+    OP_SET_SPONGE_PROPERTIES,
+    OP_SET_SPONGE_BOUNDARIES,
+    OP_SET_SURFACE_TENSION,
+    OP_SET_G_COHESION,
+    OP_SET_THREAD_COUNT,
+    OP_SET_BFECC,
+    OP_SET_RANDOM_SEED,
+    OP_SET_INFLOW_TURBULENCE,
+    OP_RESET,
+    OP_ADD_DENSITY,
+    OP_ADD_TEMPERATURE,
+    OP_CLEAR_REGION,
+    OP_ADD_OBSTACLE,
+    OP_APPLY_DIMENSIONAL_BRUSH,
+    OP_APPLY_GENERIC_BRUSH,
+    OP_APPLY_POROSITY_BRUSH,
+    OP_STEP_PHASES,
+    OP_SET_OBSTACLE_ID,
+    OP_LABEL_OBSTACLES,
+    OP_SET_ROW_OFFSET,
+    OP_SET_COLLISION_MODEL,
+    OP_COUNT
+};
+
+struct JournalHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t threadCount;
+    uint32_t checkpointSize;
+    uint64_t startStep;
+};
+
+struct JournalReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok;
+
+    void read(void* dst, size_t bytes) {
+        if ((size_t)(end - p) < bytes) {
+            ok = false;
+            std::memset(dst, 0, bytes);
+            return;
+        }
+        std::memcpy(dst, p, bytes);
+        p += bytes;
+    }
+    int readInt() { int32_t v; read(&v, 4); return v; }
+    unsigned int readUnsigned() { uint32_t v; read(&v, 4); return v; }
+    float readFloat() { float v; read(&v, 4); return v; }
+    bool readBool() { uint8_t v; read(&v, 1); return v != 0; }
+    uint64_t readVarint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            read(&byte, 1);
+            if (!ok) return 0;
+            v |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+};
+}
+
+void FluidEngine::encodeArg(std::vector<uint8_t>& out, int v) {
+    int32_t value = v;
+    const uint8_t* bytes = (const uint8_t*)&value;
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+void FluidEngine::encodeArg(std::vector<uint8_t>& out, unsigned int v) {
+    uint32_t value = v;
+    const uint8_t* bytes = (const uint8_t*)&value;
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+void FluidEngine::encodeArg(std::vector<uint8_t>& out, float v) {
+    const uint8_t* bytes = (const uint8_t*)&v;
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+void FluidEngine::encodeArg(std::vector<uint8_t>& out, bool v) {
+    out.push_back(v ? 1 : 0);
+}
+
+template <class... Args>
+void FluidEngine::record(uint64_t atStep, int op, Args... args) {
+    journal.push_back((uint8_t)op);
+    uint64_t delta = atStep - journalStep;
+    journalStep = atStep;
+    do {
+        uint8_t byte = delta & 0x7F;
+        delta >>= 7;
+        journal.push_back(delta ? (byte | 0x80) : byte);
+    } while (delta);
+    int expand[] = { 0, (encodeArg(journal, args), 0)... };
+    (void)expand;
+}
+
+// Every mutating call goes through here. In async mode a call from outside the simulation thread
+// is pushed onto the command ring and applied by that thread at the next iteration boundary;
+// otherwise it runs now and is journaled.
+template <class... Args>
+bool FluidEngine::intercept(int op, Args... args) {
+    static_assert((0 + ... + sizeof(Args)) <= sizeof(QueuedCommand::args), "command arguments overflow the ring slot");
+    if (asyncActive && std::this_thread::get_id() != asyncThreadId) {
+        if (op == OP_STEP) return true;
+        static thread_local std::vector<uint8_t> scratch;
+        scratch.clear();
+        int expand[] = { 0, (encodeArg(scratch, args), 0)... };
+        (void)expand;
+        QueuedCommand cmd;
+        cmd.op = op;
+        cmd.size = (int)scratch.size();
+        std::memcpy(cmd.args, scratch.data(), cmd.size);
+        cmd.checkpoint = nullptr;
+        pushCommand(cmd);
+        return true;
+    }
+    if (journalActive) record(stepCount, op, args...);
+    return false;
+}
+
+// Setters only overwrite their own parameter, so a later update of the same key supersedes an
+// earlier one as long as no other command sits between them. Returns -1 for every other command.
+static int setterKey(int op, const uint8_t* args) {
+    bool setter = (op >= OP_SET_VISCOSITY && op <= OP_SET_INFLOW_TURBULENCE) || op == OP_SET_COLLISION_MODEL;
+    if (!setter) return -1;
+    if (op != OP_SET_MOVING_WALL_VELOCITY) return op;
+    int32_t side;
+    std::memcpy(&side, args, 4);
+    return OP_COUNT + std::max(0, std::min(3, (int)side));
+}
+
+// Single producer (the caller's thread), single consumer (the simulation thread). The slot is
+// written before head is published, and only reused once the consumer has moved tail past it.
+// The caller never waits on the simulation: once the ring is full, commands go to an overflow
+// list under a mutex, and keep going there until the consumer has taken it, so order is kept.
+// Only a setter superseded by a newer update of the same parameter in that list is dropped.
+void FluidEngine::pushCommand(const QueuedCommand& cmd) {
+    uint32_t head = commandHead.load(std::memory_order_relaxed);
+    if (!commandOverflowPending.load(std::memory_order_relaxed) &&
+        head - commandTail.load(std::memory_order_acquire) < COMMAND_RING_SIZE) {
+        commandRing[head & (COMMAND_RING_SIZE - 1)] = cmd;
+        commandHead.store(head + 1, std::memory_order_release);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(commandOverflowMutex);
+    int key = setterKey(cmd.op, cmd.args);
+    if (key >= 0) {
+        for (size_t i = commandOverflow.size(); i-- > 0;) {
+            int other = setterKey(commandOverflow[i].op, commandOverflow[i].args);
+            if (other < 0) break;
+            if (other != key) continue;
+            commandOverflow[i] = cmd;
+            commandsDropped++;
+            return;
+        }
+    }
+    commandOverflow.push_back(cmd);
+    commandOverflowPending.store(true, std::memory_order_release);
+}
+
+unsigned int FluidEngine::getCommandsDropped() {
+    return commandsDropped;
+}
 
-const int slip_h[9] = {0, 1, 4, 3, 2, 8, 7, 6, 5};
-const int slip_v[9] = {0, 3, 2, 1, 4, 6, 5, 8, 7};
-const int cx[9] = {0, 1, 0, -1, 0, 1, -1, -1, 1};
-const int cy[9] = {0, 0, 1, 0, -1, 1, 1, -1, -1};
-const int opp[9] = {0, 3, 4, 1, 2, 7, 8, 5, 6};
-const float weights[9] = {4.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f, 1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f};
+bool FluidEngine::commandsPending() const {
+    return commandHead.load(std::memory_order_acquire) != commandTail.load(std::memory_order_relaxed) ||
+           commandOverflowPending.load(std::memory_order_acquire);
+}
 
 FluidEngine::FluidEngine(int width, int height)
     : w(width), h(height)
@@ -36,6 +338,7 @@ FluidEngine::FluidEngine(int width, int height)
     , vorticityConfinement(0.0f)
     , maxVelocity(0.57f)
     , smagorinskyConstant(0.0f)
+    , collisionModel(COLLISION_BGK)
     , temperatureViscosity(0.0f)
     , flowBehaviorIndex(1.0f)
     , consistencyIndex(0.0f)
@@ -46,18 +349,93 @@ FluidEngine::FluidEngine(int width, int height)
     , spongeTop(false), spongeBottom(false)
     , surfaceTension(0.0f)
     , gCohesion(0.0f)
-    , threadCount(1), stop_pool(false)
+    , threadCount(1)
+    , numaPlacement(false)
+    , simdWidth(pickSimdWidth(16))
+    , stop_pool(false)
     , pending_workers(0)
     , work_generation(0)
     , barriersDirty(true)
     , dataVersion(1)
     , useBFECC(false)
+    , randomSeed(0x2545F491u)
+    , stepCount(0)
+    , brushSerial(0)
+    , inflowTurbulenceIntensity(0.0f)
+    , inflowTurbulenceScale(8.0f)
+    , rowOffset(0), rowPeriod(0)
+    , dyeActive(false)
+    , temperatureActive(false)
+    , packedFormat(PACKED_OFF)
+    , packedFactor(1)
+    , packedW(width), packedH(height)
+    , packedStamp(0)
+    , packedVersion(0)
+    , outputActive(false)
+    , outputStop(false)
+    , outputFieldMask(0)
+    , outputFieldCount(0)
+    , outputStride(1)
+    , outputFrameCounter(0)
+    , outputOffset(0)
+    , outputFile(nullptr)
+    , outputWritten(0)
+    , outputDropped(0)
+    , outputLate(0)
+    , outputCodec(COMPRESS_NONE)
+    , outputErrorBound(0.0f)
+    , checkpointCodec(COMPRESS_NONE)
+    , compressionRatio(0.0f)
+    , journalActive(false)
+    , journalStep(0)
+    , asyncActive(false)
+    , asyncStop(false)
+    , asyncTickRate(60.0f)
+    , asyncIterations(1)
+    , asyncTickMs(0.0f)
+    , frameBudgetMs(0.0f)
+    , budgetMinIterations(1)
+    , budgetMaxIterations(1)
+    , budgetIterations(1)
+    , iterationCostMs(0.0f)
+    , stepPhase(0)
+    , diagnosticsEnabled(false)
+    , diagnosticsDue(true)
+    , diagnosticsPass(false)
+    , diagnosticsLatest(DIAG_COUNT, 0.0)
+    , diagnosticsCount(0)
+    , obstacleIdBrush(0)
+    , forceTracking(false)
+    , forceIterations(0)
+    , forceLatest(FORCE_RECORD_SIZE, 0.0)
+    , forceSum(2 * OBSTACLE_ID_COUNT, 0.0)
+    , forceCount(0)
+    , probeRecordSize(1)
+    , probeCapacity(4096)
+    , probeHead(0)
+    , probeTail(0)
+    , probeDropped(0)
+    , statisticsActive(false)
+    , statisticsSamples(0)
+    , spectrumInterval(0)
+    , spectrumWindow(0)
+    , spectrumStep(0)
+    , commandRing(COMMAND_RING_SIZE)
+    , commandHead(0)
+    , commandTail(0)
+    , commandsDropped(0)
+    , commandOverflowPending(false)
+    , snapshotShared(1)
+    , snapshotBack(0)
+    , snapshotFront(2)
 {
     std::cout << "DEBUG: FluidEngine Created (w="
               << width << ", h=" << height
               << "). Threading support initialized."
               << std::endl;
 
+    for (int i = 0; i < PHASE_COUNT; ++i) phaseCostUs[i] = 0.0f;
+
     int size = w * h;
 
     for (int k = 0; k < 9; ++k) {
@@ -69,6 +447,7 @@ FluidEngine::FluidEngine(int width, int height)
     ux.resize(size, 0.0f);
     uy.resize(size, 0.0f);
     barriers.resize(size, 0);
+    obstacleIds.resize(size, 0);
     dye.resize(size, 0.0f);
     dye_new.resize(size, 0.0f);
     temperature.resize(size, 0.0f);
@@ -80,6 +459,7 @@ FluidEngine::FluidEngine(int width, int height)
     forceX.resize(size, 0.0f);
     forceY.resize(size, 0.0f);
     curl.resize(size, 0.0f);
+    barrierRowCount.resize(h, 0);
 
     float feq[9];
     equilibrium(1.0f, 0.0f, 0.0f, feq);
@@ -87,8 +467,22 @@ FluidEngine::FluidEngine(int width, int height)
     for (int k = 0; k < 9; ++k) {
         std::fill(f[k].begin(), f[k].end(), feq[k]);
     }
+
+    for (int c = 0; c < 4; ++c) {
+        packedChannels[c] = PACK_NONE;
+        packedMin[c] = 0.0f;
+        packedMax[c] = 0.0f;
+    }
+
+    for (int i = 0; i < FIELD_COUNT; ++i) {
+        fieldVersion[i] = 0;
+        dirtyRowStart[i] = h;
+        dirtyRowEnd[i] = 0;
+        markFieldDirty(i);
+    }
     
     setHandlers();
+    setCollideKernel();
 }
 
 void FluidEngine::setHandlers() {
@@ -106,6 +500,28 @@ void FluidEngine::setHandlers() {
     topHandler = selectHandler(boundaryTop, &FluidEngine::handlerNoSlip, &FluidEngine::handlerSlipH, &FluidEngine::handlerMovingTop);
 }
 
+template <int W, int H>
+FluidEngine::CollideKernel FluidEngine::collideKernelFor(int width) {
+    switch (width) {
+#ifdef FLUID_AVX512_KERNELS
+    case 16: return &FluidEngine::collideRows<16, W, H>;
+#endif
+#ifdef FLUID_AVX2_KERNELS
+    case 8: return &FluidEngine::collideRows<8, W, H>;
+#endif
+    default: return &FluidEngine::collideRows<4, W, H>;
+    }
+}
+
+// Collision kernel for the current SIMD width, specialised for the lattice size when it is one of
+// FLUID_GRID_SIZES.
+void FluidEngine::setCollideKernel() {
+    collideKernel = collideKernelFor<0, 0>(simdWidth);
+#define FLUID_GRID_KERNEL(W, H) if (w == W && h == H) collideKernel = collideKernelFor<W, H>(simdWidth);
+    FLUID_GRID_SIZES(FLUID_GRID_KERNEL)
+#undef FLUID_GRID_KERNEL
+}
+
 void FluidEngine::applySurfaceTension() {
     if (surfaceTension <= 0.0f || gCohesion <= 0.0f) return;
 
@@ -149,10 +565,12 @@ void FluidEngine::applySurfaceTension() {
 }
 
 void FluidEngine::setSurfaceTension(float st) {
+    if (intercept(OP_SET_SURFACE_TENSION, st)) return;
     surfaceTension = st;
 }
 
 void FluidEngine::setGCohesion(float g) {
+    if (intercept(OP_SET_G_COHESION, g)) return;
     gCohesion = g;
 }
 
@@ -183,10 +601,16 @@ void FluidEngine::handlerMovingBottom(int& dest_k, float& f_bounce, int k, int i
 }
 
 void FluidEngine::setBFECC(bool enable) {
+    if (intercept(OP_SET_BFECC, enable)) return;
     useBFECC = enable;
 }
 
+// Rows are backtraced in global coordinates and clamped to the global lattice as well as to the
+// rows held here, so a band of a split lattice (see setRowOffset) interpolates exactly like the
+// undivided one; with rowOffset 0 this is the plain clamp to [0.5, h - 1.5].
 void FluidEngine::performAdvection(const std::vector<float>& src, std::vector<float>& dst, float dt_scale, float decay_rate) {
+    const float rowLow = (float)std::max(rowOffset, 0) + 0.5f;
+    const float rowHigh = (float)(rowPeriod > 0 ? std::min(rowOffset + h, rowPeriod) : rowOffset + h) - 1.5f;
     parallel_for(0, h, [&](int startY, int endY) {
         const int BLOCK_SIZE = 32;
         for (int by = startY; by < endY; by += BLOCK_SIZE) {
@@ -203,17 +627,18 @@ void FluidEngine::performAdvection(const std::vector<float>& src, std::vector<fl
                         }
 
                         float x_prev = (float)x - ux[idx] * dt_scale;
-                        float y_prev = (float)y - uy[idx] * dt_scale;
+                        float y_prev = (float)(y + rowOffset) - uy[idx] * dt_scale;
 
                         if (x_prev < 0.5f) x_prev = 0.5f;
                         if (x_prev > w - 1.5f) x_prev = w - 1.5f;
-                        if (y_prev < 0.5f) y_prev = 0.5f;
-                        if (y_prev > h - 1.5f) y_prev = h - 1.5f;
+                        if (y_prev < rowLow) y_prev = rowLow;
+                        if (y_prev > rowHigh) y_prev = rowHigh;
 
                         int ix = static_cast<int>(x_prev);
                         int iy = static_cast<int>(y_prev);
                         float fx = x_prev - ix;
                         float fy = y_prev - iy;
+                        iy -= rowOffset;
 
                         int idx_tl = iy * w + ix;
                         int idx_tr = idx_tl + 1;
@@ -239,6 +664,7 @@ void FluidEngine::performAdvection(const std::vector<float>& src, std::vector<fl
 }
 
 void FluidEngine::setBoundaryConditions(int left, int right, int top, int bottom) {
+    if (intercept(OP_SET_BOUNDARY_CONDITIONS, left, right, top, bottom)) return;
     boundaryLeft = left;
     boundaryRight = right;
     boundaryTop = top;
@@ -247,12 +673,14 @@ void FluidEngine::setBoundaryConditions(int left, int right, int top, int bottom
 }
 
 void FluidEngine::setInflowProperties(float vx, float vy, float rho) {
+    if (intercept(OP_SET_INFLOW_PROPERTIES, vx, vy, rho)) return;
     inflowVelocityX = vx;
     inflowVelocityY = vy;
     inflowDensity = rho;
 }
 
 void FluidEngine::setMovingWallVelocity(int side, float vx, float vy) {
+    if (intercept(OP_SET_MOVING_WALL_VELOCITY, side, vx, vy)) return;
     switch (side) {
         case 0: movingWallVelocityLeftX = vx; movingWallVelocityLeftY = vy; break;
         case 1: movingWallVelocityRightX = vx; movingWallVelocityRightY = vy; break;
@@ -261,38 +689,105 @@ void FluidEngine::setMovingWallVelocity(int side, float vx, float vy) {
     }
 }
 
-void FluidEngine::applyMacroscopicBoundaries() {
+void FluidEngine::setRandomSeed(unsigned int seed) {
+    if (intercept(OP_SET_RANDOM_SEED, seed)) return;
+    randomSeed = seed;
+}
+
+void FluidEngine::setInflowTurbulence(float intensity, float lengthScale) {
+    if (intercept(OP_SET_INFLOW_TURBULENCE, intensity, lengthScale)) return;
+    inflowTurbulenceIntensity = std::max(0.0f, intensity);
+    inflowTurbulenceScale = std::max(1.0f, lengthScale);
+}
+
+// Global index of local row 0 when this engine owns a band of a larger lattice, so edge noise
+// along the left and right inflows and scalar backtraces line up across subdomains; a nonzero
+// period is the global height of a lattice that is periodic in y.
+void FluidEngine::setRowOffset(int offset, int period) {
+    if (intercept(OP_SET_ROW_OFFSET, offset, period)) return;
+    rowOffset = offset;
+    rowPeriod = std::max(0, period);
+}
+
+// Smooth value noise over (position along the inflow edge, time) with one lattice node every
+// inflowTurbulenceScale cells. Time advances at the mean inflow speed, so eddies enter the
+// domain with roughly the same size in the streamwise and spanwise directions.
+void FluidEngine::inflowPerturbation(int side, int s, float& du, float& dv) const {
+    float speed = std::sqrt(inflowVelocityX * inflowVelocityX + inflowVelocityY * inflowVelocityY);
+    float amplitude = inflowTurbulenceIntensity * speed;
+    float invScale = 1.0f / inflowTurbulenceScale;
+
+    float ps = (float)s * invScale;
+    float pt = (float)stepCount * speed * invScale;
+    int is = (int)ps;
+    int64_t it = (int64_t)pt;
+    float fs = ps - (float)is;
+    float ft = pt - (float)it;
+    fs = fs * fs * (3.0f - 2.0f * fs);
+    ft = ft * ft * (3.0f - 2.0f * ft);
+
+    uint64_t keyU = rngKey(randomSeed, 0x10000u + 2 * side);
+    uint64_t keyV = rngKey(randomSeed, 0x10000u + 2 * side + 1);
+    uint64_t c00 = ((uint64_t)it << 32) | (uint32_t)is;
+    uint64_t c10 = c00 + 1;
+    uint64_t c01 = c00 + (1ull << 32);
+    uint64_t c11 = c01 + 1;
+
+    auto lerp2 = [&](uint64_t key) {
+        float a = rngSigned(key, c00) + (rngSigned(key, c10) - rngSigned(key, c00)) * fs;
+        float b = rngSigned(key, c01) + (rngSigned(key, c11) - rngSigned(key, c01)) * fs;
+        return a + (b - a) * ft;
+    };
+    du = amplitude * lerp2(keyU);
+    dv = amplitude * lerp2(keyV);
+}
+
+void FluidEngine::applyInflowEquilibrium(int side, int idx, int s) {
+    float u = inflowVelocityX;
+    float v = inflowVelocityY;
+    if (inflowTurbulenceIntensity > 0.0f) {
+        float du, dv;
+        inflowPerturbation(side, s, du, dv);
+        u += du;
+        v += dv;
+        limitVelocity(u, v);
+    }
     float feq[9];
+    equilibrium(inflowDensity, u, v, feq);
+    for(int k = 0; k < 9; ++k) f[k][idx] = feq[k];
+}
+
+void FluidEngine::applyMacroscopicBoundaries() {
+    auto globalRow = [&](int y) {
+        int s = y + rowOffset;
+        return rowPeriod > 0 ? ((s % rowPeriod) + rowPeriod) % rowPeriod : s;
+    };
     if (boundaryLeft == 4) {
         for (int y = 0; y < h; ++y) {
             int idx = y * w + 0;
             if (barriers[idx]) continue;
-            equilibrium(inflowDensity, inflowVelocityX, inflowVelocityY, feq);
-            for(int k = 0; k < 9; ++k) f[k][idx] = feq[k];
+            applyInflowEquilibrium(0, idx, globalRow(y));
         }
     }
     if (boundaryRight == 4) {
         for (int y = 0; y < h; ++y) {
             int idx = y * w + (w - 1);
             if (barriers[idx]) continue;
-            equilibrium(inflowDensity, inflowVelocityX, inflowVelocityY, feq);
-            for(int k = 0; k < 9; ++k) f[k][idx] = feq[k];
+            applyInflowEquilibrium(1, idx, globalRow(y));
         }
     }
     if (boundaryBottom == 4) {
         for (int x = 0; x < w; ++x) {
             int idx = 0 * w + x;
             if (barriers[idx]) continue;
-            equilibrium(inflowDensity, inflowVelocityX, inflowVelocityY, feq);
-            for(int k = 0; k < 9; ++k) f[k][idx] = feq[k];
+            applyInflowEquilibrium(3, idx, x);
         }
     }
     if (boundaryTop == 4) {
         for (int x = 0; x < w; ++x) {
             int idx = (h - 1) * w + x;
             if (barriers[idx]) continue;
-            equilibrium(inflowDensity, inflowVelocityX, inflowVelocityY, feq);
-            for(int k = 0; k < 9; ++k) f[k][idx] = feq[k];
+            applyInflowEquilibrium(2, idx, x);
         }
     }
 }
@@ -332,27 +827,148 @@ unsigned int FluidEngine::getDataVersion() {
     return dataVersion.load();
 }
 
+uint64_t FluidEngine::getStepCount() const {
+    return stepCount;
+}
+
+void FluidEngine::markFieldDirty(int field, int startY, int endY) {
+    startY = std::max(0, startY);
+    endY = std::min(h, endY);
+    if (startY >= endY) return;
+    dirtyRowStart[field] = std::min(dirtyRowStart[field], startY);
+    dirtyRowEnd[field] = std::max(dirtyRowEnd[field], endY);
+    fieldVersion[field]++;
+}
+
+unsigned int FluidEngine::getFieldVersion(int field) {
+    if (field < 0 || field >= FIELD_COUNT) return 0;
+    return fieldVersion[field].load();
+}
+
+int FluidEngine::getDirtyRowStart(int field) {
+    if (field < 0 || field >= FIELD_COUNT) return 0;
+    return dirtyRowStart[field];
+}
+
+int FluidEngine::getDirtyRowEnd(int field) {
+    if (field < 0 || field >= FIELD_COUNT) return 0;
+    return dirtyRowEnd[field];
+}
+
+void FluidEngine::clearFieldDirty(int field) {
+    if (field < 0 || field >= FIELD_COUNT) return;
+    dirtyRowStart[field] = h;
+    dirtyRowEnd[field] = 0;
+}
+
 void FluidEngine::setFlowBehaviorIndex(float n) {
+    if (intercept(OP_SET_FLOW_BEHAVIOR_INDEX, n)) return;
     flowBehaviorIndex = n;
 }
 
 void FluidEngine::setConsistencyIndex(float k) {
+    if (intercept(OP_SET_CONSISTENCY_INDEX, k)) return;
     consistencyIndex = k;
 }
 
 void FluidEngine::setSmagorinskyConstant(float c) {
+    if (intercept(OP_SET_SMAGORINSKY_CONSTANT, c)) return;
     smagorinskyConstant = c;
 }
 
 void FluidEngine::setTemperatureViscosity(float v) {
+    if (intercept(OP_SET_TEMPERATURE_VISCOSITY, v)) return;
     temperatureViscosity = v;
 }
 
+void FluidEngine::setCollisionModel(int model) {
+    if (intercept(OP_SET_COLLISION_MODEL, model)) return;
+    collisionModel = (model > COLLISION_BGK && model < COLLISION_MODEL_COUNT) ? model : COLLISION_BGK;
+}
+
+int FluidEngine::getCollisionModel() {
+    return collisionModel;
+}
+
 bool FluidEngine::checkBarrierDirty() {
     return barriersDirty.exchange(false);
 }
 
+std::vector<int>* FluidEngine::dirtyRectList(int field) {
+    if (field == FIELD_BARRIERS) return &barrierRects;
+    if (field == FIELD_POROSITY) return &porosityRects;
+    return nullptr;
+}
+
+// Records a half-open [x0, x1) x [y0, y1) rectangle of changed mask cells. Overlapping consecutive
+// rectangles (a brush stroke) are merged, and a long list collapses to its bounding box.
+void FluidEngine::markDirtyRect(int field, int x0, int y0, int x1, int y1) {
+    const int MAX_DIRTY_RECTS = 64;
+    std::vector<int>* rects = dirtyRectList(field);
+    if (!rects) return;
+
+    x0 = std::max(0, x0); y0 = std::max(0, y0);
+    x1 = std::min(w, x1); y1 = std::min(h, y1);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    if (field == FIELD_BARRIERS) {
+        for (int y = y0; y < y1; ++y) {
+            int count = 0;
+            for (int x = 0; x < w; ++x) count += barriers[y * w + x] ? 1 : 0;
+            barrierRowCount[y] = count;
+        }
+    }
+
+    int n = (int)rects->size();
+    if (n >= 4) {
+        int* last = &(*rects)[n - 4];
+        if (x0 <= last[2] && x1 >= last[0] && y0 <= last[3] && y1 >= last[1]) {
+            last[0] = std::min(last[0], x0); last[1] = std::min(last[1], y0);
+            last[2] = std::max(last[2], x1); last[3] = std::max(last[3], y1);
+            return;
+        }
+    }
+
+    if (n / 4 >= MAX_DIRTY_RECTS) {
+        int bx0 = x0, by0 = y0, bx1 = x1, by1 = y1;
+        for (int i = 0; i < n; i += 4) {
+            bx0 = std::min(bx0, (*rects)[i]); by0 = std::min(by0, (*rects)[i + 1]);
+            bx1 = std::max(bx1, (*rects)[i + 2]); by1 = std::max(by1, (*rects)[i + 3]);
+        }
+        rects->assign({bx0, by0, bx1, by1});
+        return;
+    }
+    rects->insert(rects->end(), {x0, y0, x1, y1});
+}
+
+#ifdef __EMSCRIPTEN__
+val FluidEngine::getDirtyRects(int field) {
+    std::vector<int>* rects = dirtyRectList(field);
+    if (!rects) return val::null();
+    return val(typed_memory_view(rects->size(), rects->data()));
+}
+#endif
+
+int FluidEngine::getDirtyRectCount(int field) {
+    std::vector<int>* rects = dirtyRectList(field);
+    return rects ? (int)rects->size() / 4 : 0;
+}
+
+void FluidEngine::clearDirtyRects(int field) {
+    std::vector<int>* rects = dirtyRectList(field);
+    if (rects) rects->clear();
+}
+
+bool FluidEngine::rowsBarrierFree(int y) const {
+    if (barrierRowCount[y] != 0) return false;
+    if (y > 0 && barrierRowCount[y - 1] != 0) return false;
+    if (y < h - 1 && barrierRowCount[y + 1] != 0) return false;
+    return true;
+}
+
 FluidEngine::~FluidEngine() {
+    stopAsync();
+    closeFieldOutput();
     stop_pool = true;
     worker_cv.notify_all();
     for (std::thread &worker : workers) {
@@ -363,7 +979,7 @@ FluidEngine::~FluidEngine() {
 }
 
 void FluidEngine::initThreadPool(int count) {
-    #ifdef __EMSCRIPTEN_PTHREADS__
+    #ifdef FLUID_THREADS
         for(int i = 0; i < count; ++i) {
             workers.emplace_back([this, i] {
                 int my_generation = 0;
@@ -403,6 +1019,7 @@ void FluidEngine::initThreadPool(int count) {
 }
 
 void FluidEngine::setThreadCount(int count) {
+    if (intercept(OP_SET_THREAD_COUNT, count)) return;
     std::cout << "DEBUG: setThreadCount called with " << count << std::endl;
     int newCount = std::max(1, count);
     
@@ -422,13 +1039,139 @@ void FluidEngine::setThreadCount(int count) {
     if (threadCount > 1) {
         initThreadPool(threadCount);
     }
+    if (numaPlacement) {
+        applyWorkerAffinity();
+        rehomeFields();
+    }
+}
+
+static int currentNumaNode() {
+#ifdef NUMA_PLACEMENT_SUPPORTED
+    unsigned int cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return (int)node;
+#endif
+    return 0;
+}
+
+// Native Linux only: pins worker i to the i-th CPU this process may run on and moves every
+// per-cell field band onto the memory node of the worker that sweeps it. Worker i always takes
+// the i-th chunk of a parallel_for range, so bands line up across phases to within a row.
+bool FluidEngine::setNumaPlacement(bool enabled) {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    numaPlacement = enabled;
+    bool applied = applyWorkerAffinity();
+    if (enabled) rehomeFields();
+    return applied;
+}
+
+bool FluidEngine::applyWorkerAffinity() {
+#ifdef NUMA_PLACEMENT_SUPPORTED
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+    std::vector<int> cpus;
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+        if (CPU_ISSET(c, &allowed)) cpus.push_back(c);
+    }
+    if (cpus.empty()) return false;
+
+    bool ok = true;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        cpu_set_t mask = allowed;
+        if (numaPlacement) {
+            CPU_ZERO(&mask);
+            CPU_SET(cpus[i % cpus.size()], &mask);
+        }
+        if (pthread_setaffinity_np(workers[i].native_handle(), sizeof(mask), &mask) != 0) ok = false;
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
+// Pages already touched by the constructing thread stay on its node, so each worker copies its
+// band out, drops the whole pages inside it and writes the band back, faulting them in locally.
+// Pages straddling two bands are left where they are.
+void FluidEngine::rehomeFields() {
+#ifdef NUMA_PLACEMENT_SUPPORTED
+    std::vector<float>* fields[] = {
+        &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7], &f[8],
+        &f_new[0], &f_new[1], &f_new[2], &f_new[3], &f_new[4], &f_new[5], &f_new[6], &f_new[7], &f_new[8],
+        &rho, &ux, &uy, &dye, &dye_new, &temperature, &temperature_new, &porosity,
+        &tmp_bfecc1, &tmp_bfecc2, &forceX, &forceY, &curl};
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+
+    parallel_for(0, h, [&](int startY, int endY) {
+        std::vector<float> band;
+        for (std::vector<float>* field : fields) {
+            uintptr_t lo = (uintptr_t)(field->data() + (size_t)startY * w);
+            uintptr_t hi = (uintptr_t)(field->data() + (size_t)endY * w);
+            uintptr_t first = (lo + page - 1) & ~(page - 1);
+            uintptr_t last = hi & ~(page - 1);
+            if (last <= first) continue;
+
+            float* data = (float*)first;
+            size_t bytes = last - first;
+            band.assign(data, data + bytes / sizeof(float));
+            if (madvise((void*)first, bytes, MADV_DONTNEED) != 0) continue;
+            std::memcpy(data, band.data(), bytes);
+        }
+    });
+#endif
+}
+
+int FluidEngine::getSimdWidth() {
+    return simdWidth;
+}
+
+// Forces a narrower collision kernel (0 picks the widest again). Every width produces the same
+// fields, so this only changes speed.
+void FluidEngine::setSimdWidth(int width) {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    simdWidth = pickSimdWidth(width > 0 ? width : 16);
+    setCollideKernel();
+}
+
+// Aggregate read bandwidth of the population arrays in GB/s, indexed by the memory node each
+// band's worker ran on (a single entry where the node is unknown).
+std::vector<double> FluidEngine::measureNodeBandwidth(int passes) {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    std::mutex resultMutex;
+    std::vector<double> perNode;
+    passes = std::max(1, passes);
+
+    parallel_for(0, h, [&](int startY, int endY) {
+        size_t begin = (size_t)startY * w;
+        size_t end = (size_t)endY * w;
+        float sink = 0.0f;
+        auto start = std::chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; ++pass) {
+            for (int k = 0; k < 9; ++k) {
+                const float* data = f[k].data();
+                simd::Vec<4> acc = simd::splat<4>(0.0f);
+                size_t i = begin;
+                for (; i + 4 <= end; i += 4) acc = simd::add(acc, simd::load<4>(data + i));
+                for (; i < end; ++i) sink += data[i];
+                sink += (float)simd::sumLanes(acc);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double bytes = (double)passes * 9.0 * (end - begin) * sizeof(float);
+        int node = currentNumaNode();
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        if ((int)perNode.size() <= node) perNode.resize(node + 1, 0.0);
+        if (seconds > 0.0 && sink == sink) perNode[node] += bytes / seconds / 1e9;
+    });
+    return perNode;
 }
 
 void FluidEngine::parallel_for(int start, int end, std::function<void(int, int)> func) {
     if (threadCount <= 1) {
         func(start, end);
     } else {
-        #ifdef __EMSCRIPTEN_PTHREADS__
+        #ifdef FLUID_THREADS
             {
                 std::lock_guard<std::mutex> lock(worker_mutex);
                 current_task = func;
@@ -456,60 +1199,74 @@ void FluidEngine::equilibrium(float r, float u, float v, float* feq) {
 }
 
 void FluidEngine::setViscosity(float viscosity) {
+    if (intercept(OP_SET_VISCOSITY, viscosity)) return;
     omega = 1.0f / (3.0f * viscosity + 0.5f);
 }
 
 void FluidEngine::setDecay(float newDecay) {
+    if (intercept(OP_SET_DECAY, newDecay)) return;
     decay = newDecay;
 }
 
 void FluidEngine::setDt(float newDt) {
+    if (intercept(OP_SET_DT, newDt)) return;
     dt = newDt;
 }
 
 void FluidEngine::setGravity(float gx, float gy) {
+    if (intercept(OP_SET_GRAVITY, gx, gy)) return;
     gravityX = gx;
     gravityY = gy;
 }
 
 void FluidEngine::setThermalProperties(float expansion, float refTemp) {
+    if (intercept(OP_SET_THERMAL_PROPERTIES, expansion, refTemp)) return;
     thermalExpansion = expansion;
     referenceTemperature = refTemp;
 }
 
 void FluidEngine::setThermalDiffusivity(float td) {
+    if (intercept(OP_SET_THERMAL_DIFFUSIVITY, td)) return;
     thermalDiffusivity = td;
 }
 
 void FluidEngine::setVorticityConfinement(float vc) {
+    if (intercept(OP_SET_VORTICITY_CONFINEMENT, vc)) return;
     vorticityConfinement = vc;
 }
 
 void FluidEngine::setGlobalDrag(float drag) {
+    if (intercept(OP_SET_GLOBAL_DRAG, drag)) return;
     globalDrag = drag;
 }
 
 void FluidEngine::setPorosityDrag(float drag) {
+    if (intercept(OP_SET_POROSITY_DRAG, drag)) return;
     porosityDrag = drag;
 }
 
 void FluidEngine::setSpongeProperties(float strength, int width) {
+    if (intercept(OP_SET_SPONGE_PROPERTIES, strength, width)) return;
     spongeStrength = strength;
     spongeWidth = width;
 }
 
 void FluidEngine::setSpongeBoundaries(bool left, bool right, bool top, bool bottom) {
+    if (intercept(OP_SET_SPONGE_BOUNDARIES, left, right, top, bottom)) return;
     spongeLeft = left;
     spongeRight = right;
     spongeTop = top;
     spongeBottom = bottom;
 }
 
+#ifdef __EMSCRIPTEN__
 val FluidEngine::getPorosityView() {
     return val(typed_memory_view(w * h, porosity.data()));
 }
+#endif
 
 void FluidEngine::applyPorosityBrush(int x, int y, int radius, float strength, bool add, float falloffParam, float angle, float aspectRatio, int shape, int falloffMode) {
+    if (intercept(OP_APPLY_POROSITY_BRUSH, x, y, radius, strength, add, falloffParam, angle, aspectRatio, shape, falloffMode)) return;
     float rad = (float)radius;
     float angRad = angle * 3.14159265f / 180.0f;
     float cosA = std::cos(angRad);
@@ -561,92 +1318,103 @@ void FluidEngine::applyPorosityBrush(int x, int y, int radius, float strength, b
             if (porosity[idx] < 0.0f) porosity[idx] = 0.0f;
         }
     }
+    markFieldDirty(FIELD_POROSITY, y - radius, y + radius + 1);
+    markDirtyRect(FIELD_POROSITY, x - radius, y - radius, x + radius + 1, y + radius + 1);
     dataVersion++;
 }
 
 void FluidEngine::applyDimensionalBrush(int x, int y, int radius, int mode, float strength, float falloffParam, float angle, float aspectRatio, int shape, int falloffMode) {
+    if (intercept(OP_APPLY_DIMENSIONAL_BRUSH, x, y, radius, mode, strength, falloffParam, angle, aspectRatio, shape, falloffMode)) return;
     float rad = (float)radius;
     float angRad = angle * 3.14159265f / 180.0f;
     float cosA = std::cos(angRad);
     float sinA = std::sin(angRad);
     float aspect = std::max(0.01f, aspectRatio);
-
-    for (int dy = -radius; dy <= radius; ++dy) {
-        for (int dx = -radius; dx <= radius; ++dx) {
+    uint64_t noiseKeyX = rngKey(randomSeed, 2 * brushSerial);
+    uint64_t noiseKeyY = rngKey(randomSeed, 2 * brushSerial + 1);
+    uint64_t noiseBase = stepCount << 32;
+    brushSerial++;
+
+    parallel_for(-radius, radius + 1, [&](int startDy, int endDy) {
+        for (int dy = startDy; dy < endDy; ++dy) {
+            for (int dx = -radius; dx <= radius; ++dx) {
             
-            float px = (float)dx;
-            float py = (float)dy;
-
-            float rx = px * cosA - py * sinA;
-            float ry = px * sinA + py * cosA;
-
-            ry /= aspect;
-
-            float dist = 0.0f;
-            if (shape == 0) { 
-                dist = std::sqrt(rx * rx + ry * ry);
-            } else if (shape == 1) { 
-                dist = std::max(std::abs(rx), std::abs(ry));
-            } else if (shape == 2) { 
-                dist = (std::abs(rx) + std::abs(ry)); 
-                if (shape == 2) dist *= 0.7071f; 
-            }
+                float px = (float)dx;
+                float py = (float)dy;
+
+                float rx = px * cosA - py * sinA;
+                float ry = px * sinA + py * cosA;
+
+                ry /= aspect;
+
+                float dist = 0.0f;
+                if (shape == 0) { 
+                    dist = std::sqrt(rx * rx + ry * ry);
+                } else if (shape == 1) { 
+                    dist = std::max(std::abs(rx), std::abs(ry));
+                } else if (shape == 2) { 
+                    dist = (std::abs(rx) + std::abs(ry)); 
+                    if (shape == 2) dist *= 0.7071f; 
+                }
 
-            if (dist > rad) continue;
+                if (dist > rad) continue;
 
-            int nx = x + dx;
-            int ny = y + dy;
+                int nx = x + dx;
+                int ny = y + dy;
 
-            if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+                if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
 
-            int idx = ny * w + nx;
-            if (barriers[idx]) continue;
+                int idx = ny * w + nx;
+                if (barriers[idx]) continue;
 
-            float weight = 0.0f;
-            float normDist = dist / rad;
+                float weight = 0.0f;
+                float normDist = dist / rad;
             
-            if (falloffMode == 1) { 
-                weight = std::exp(-normDist * normDist * falloffParam);
-            } else { 
-                float t = 1.0f - normDist;
-                if (t < 0.0f) t = 0.0f;
-                float smoothT = t * t * (3.0f - 2.0f * t);
-                weight = (1.0f - falloffParam) + falloffParam * smoothT;
-            }
+                if (falloffMode == 1) { 
+                    weight = std::exp(-normDist * normDist * falloffParam);
+                } else { 
+                    float t = 1.0f - normDist;
+                    if (t < 0.0f) t = 0.0f;
+                    float smoothT = t * t * (3.0f - 2.0f * t);
+                    weight = (1.0f - falloffParam) + falloffParam * smoothT;
+                }
 
-            if (mode == 0) { 
-                float fx = -dy * strength * weight;
-                float fy = dx * strength * weight;
-                ux[idx] += fx * dt;
-                uy[idx] += fy * dt;
-            } else if (mode == 1) { 
-                float fx = dx * strength * weight;
-                float fy = dy * strength * weight;
-                ux[idx] += fx * dt;
-                uy[idx] += fy * dt;
-            } else if (mode == 2) { 
-                float randX = ((float)rand() / (float)RAND_MAX - 0.5f) * 2.0f;
-                float randY = ((float)rand() / (float)RAND_MAX - 0.5f) * 2.0f;
-                ux[idx] += randX * strength * weight * dt;
-                uy[idx] += randY * strength * weight * dt;
-            } else if (mode == 3) { 
-                float dampen = 1.0f - (strength * weight * dt);
-                if (dampen < 0.0f) dampen = 0.0f;
-                ux[idx] *= dampen;
-                uy[idx] *= dampen;
-            }
+                if (mode == 0) { 
+                    float fx = -dy * strength * weight;
+                    float fy = dx * strength * weight;
+                    ux[idx] += fx * dt;
+                    uy[idx] += fy * dt;
+                } else if (mode == 1) { 
+                    float fx = dx * strength * weight;
+                    float fy = dy * strength * weight;
+                    ux[idx] += fx * dt;
+                    uy[idx] += fy * dt;
+                } else if (mode == 2) { 
+                    float randX = rngSigned(noiseKeyX, noiseBase | (uint32_t)idx);
+                    float randY = rngSigned(noiseKeyY, noiseBase | (uint32_t)idx);
+                    ux[idx] += randX * strength * weight * dt;
+                    uy[idx] += randY * strength * weight * dt;
+                } else if (mode == 3) { 
+                    float dampen = 1.0f - (strength * weight * dt);
+                    if (dampen < 0.0f) dampen = 0.0f;
+                    ux[idx] *= dampen;
+                    uy[idx] *= dampen;
+                }
 
-            limitVelocity(ux[idx], uy[idx]);
+                limitVelocity(ux[idx], uy[idx]);
             
-            float feq[9];
-            equilibrium(rho[idx], ux[idx], uy[idx], feq);
-            for(int k=0; k<9; k++) f[k][idx] = feq[k];
+                float feq[9];
+                equilibrium(rho[idx], ux[idx], uy[idx], feq);
+                for(int k=0; k<9; k++) f[k][idx] = feq[k];
+            }
         }
-    }
+    });
+    markFieldDirty(FIELD_VELOCITY, y - radius, y + radius + 1);
     dataVersion++;
 }
 
 void FluidEngine::applyGenericBrush(int x, int y, int radius, float fx, float fy, float densityAmt, float tempAmt, float falloffParam, float angle, float aspectRatio, int shape, int falloffMode) {
+    if (intercept(OP_APPLY_GENERIC_BRUSH, x, y, radius, fx, fy, densityAmt, tempAmt, falloffParam, angle, aspectRatio, shape, falloffMode)) return;
     float rad = (float)radius;
     bool applyForce = (std::abs(fx) > 1e-5f || std::abs(fy) > 1e-5f);
     
@@ -719,16 +1487,28 @@ void FluidEngine::applyGenericBrush(int x, int y, int radius, float fx, float fy
             }
         }
     }
+    if (applyForce) markFieldDirty(FIELD_VELOCITY, y - radius, y + radius + 1);
+    if (densityAmt != 0.0f) {
+        dyeActive = true;
+        markFieldDirty(FIELD_DYE, y - radius, y + radius + 1);
+    }
+    if (tempAmt != 0.0f) {
+        temperatureActive = true;
+        markFieldDirty(FIELD_TEMPERATURE, y - radius, y + radius + 1);
+    }
     dataVersion++;
 }
 
 void FluidEngine::addTemperature(int x, int y, float amount) {
+    if (intercept(OP_ADD_TEMPERATURE, x, y, amount)) return;
     if (x < 0 || x >= w || y < 0 || y >= h) return;
     int idx = y * w + x;
     
     if (barriers[idx]) return;
 
     temperature[idx] += amount;
+    temperatureActive = true;
+    markFieldDirty(FIELD_TEMPERATURE, y, y + 1);
     dataVersion++;
 }
 
@@ -742,10 +1522,12 @@ void FluidEngine::limitVelocity(float &u, float &v) {
 }
 
 void FluidEngine::setMaxVelocity(float mv) {
+    if (intercept(OP_SET_MAX_VELOCITY, mv)) return;
     maxVelocity = mv;
 }
 
 void FluidEngine::addForce(int x, int y, float fx, float fy) {
+    if (intercept(OP_ADD_FORCE, x, y, fx, fy)) return;
     if (x < 1 || x >= w - 1 || y < 1 || y >= h - 1) return;
     int idx = y * w + x;
     
@@ -759,20 +1541,25 @@ void FluidEngine::addForce(int x, int y, float fx, float fy) {
     float feq[9];
     equilibrium(rho[idx], ux[idx], uy[idx], feq);
     for(int k=0; k<9; k++) f[k][idx] = feq[k];
+    markFieldDirty(FIELD_VELOCITY, y, y + 1);
     dataVersion++;
 }
 
 void FluidEngine::addDensity(int x, int y, float amount) {
+    if (intercept(OP_ADD_DENSITY, x, y, amount)) return;
     if (x < 0 || x >= w || y < 0 || y >= h) return;
     int idx = y * w + x;
     
     if (barriers[idx]) return;
 
     dye[idx] += amount;
+    dyeActive = true;
+    markFieldDirty(FIELD_DYE, y, y + 1);
     dataVersion++;
 }
 
 void FluidEngine::addObstacle(int x, int y, int radius, bool remove, float angle, float aspectRatio, int shape) {
+    if (intercept(OP_ADD_OBSTACLE, x, y, radius, remove, angle, aspectRatio, shape)) return;
     float rad = (float)radius;
     float angRad = angle * 3.14159265f / 180.0f;
     float cosA = std::cos(angRad);
@@ -807,6 +1594,7 @@ void FluidEngine::addObstacle(int x, int y, int radius, bool remove, float angle
             if (nx >= 0 && nx < w && ny >= 0 && ny < h) {
                 int idx = ny * w + nx;
                 barriers[idx] = remove ? 0 : 255;
+                obstacleIds[idx] = remove ? 0 : (unsigned char)obstacleIdBrush;
                 
                 if (!remove) {
                     ux[idx] = 0.0f;
@@ -821,16 +1609,26 @@ void FluidEngine::addObstacle(int x, int y, int radius, bool remove, float angle
             }
         }
     }
+    markFieldDirty(FIELD_BARRIERS, y - radius, y + radius + 1);
+    markDirtyRect(FIELD_BARRIERS, x - radius, y - radius, x + radius + 1, y + radius + 1);
+    if (!remove) {
+        markFieldDirty(FIELD_VELOCITY, y - radius, y + radius + 1);
+        markFieldDirty(FIELD_DENSITY, y - radius, y + radius + 1);
+        markFieldDirty(FIELD_DYE, y - radius, y + radius + 1);
+        markFieldDirty(FIELD_TEMPERATURE, y - radius, y + radius + 1);
+    }
     barriersDirty.store(true);
     dataVersion++;
 }
 
 void FluidEngine::reset() {
+    if (intercept(OP_RESET)) return;
     int size = w * h;
     std::fill(rho.begin(), rho.end(), 1.0f);
     std::fill(ux.begin(), ux.end(), 0.0f);
     std::fill(uy.begin(), uy.end(), 0.0f);
     std::fill(barriers.begin(), barriers.end(), 0);
+    std::fill(obstacleIds.begin(), obstacleIds.end(), 0);
     std::fill(dye.begin(), dye.end(), 0.0f);
     std::fill(temperature.begin(), temperature.end(), 0.0f);
     std::fill(porosity.begin(), porosity.end(), 1.0f);
@@ -841,410 +1639,2915 @@ void FluidEngine::reset() {
     for (int k = 0; k < 9; ++k) {
         std::fill(f[k].begin(), f[k].end(), feq[k]);
     }
+    dyeActive = false;
+    temperatureActive = false;
+    for (int i = 0; i < FIELD_COUNT; ++i) markFieldDirty(i);
+    markDirtyRect(FIELD_BARRIERS, 0, 0, w, h);
+    markDirtyRect(FIELD_POROSITY, 0, 0, w, h);
     barriersDirty.store(true);
     dataVersion++;
 }
 
-void FluidEngine::clearRegion(int x, int y, int radius) {
-    for (int dy = -radius; dy <= radius; ++dy) {
-        for (int dx = -radius; dx <= radius; ++dx) {
-            if (dx * dx + dy * dy <= radius * radius) {
-                int nx = x + dx;
-                int ny = y + dy;
-                if (nx >= 0 && nx < w && ny >= 0 && ny < h) {
-                    int idx = ny * w + nx;
-                    barriers[idx] = 0; 
-                    rho[idx] = 1.0f;
-                    ux[idx] = 0.0f;
-                    uy[idx] = 0.0f;
-                    dye[idx] = 0.0f;
-                    temperature[idx] = 0.0f;
+// Field codec. Rows are split into fixed bands that are coded independently, so output does not
+// depend on the thread count. Lossless: XOR with the left neighbour, byte-shuffle into four planes,
+// order-0 rANS per plane. Lossy: values quantized to 2*errorBound, 2D Lorenzo prediction of the
+// quantization indices, outliers kept verbatim, residual codes entropy coded like the lossless planes.
+namespace {
+const uint32_t CODEC_MAGIC = 0x5A43424Cu;
+const int CODEC_BAND_ROWS = 16;
+const uint32_t RANS_SCALE_BITS = 12;
+const uint32_t RANS_SCALE = 1u << RANS_SCALE_BITS;
+const uint32_t RANS_LOW = 1u << 23;
+const uint16_t LOSSY_WIDE = 0xFFFF;
+const uint16_t LOSSY_OUTLIER = 0xFFFE;
+const int LOSSY_CODE_RANGE = 16000;
+const float LOSSY_INDEX_RANGE = 268435456.0f;
+
+enum PlaneCoding {
+    PLANE_CONSTANT = 0,
+    PLANE_RAW,
+    PLANE_RANS
+};
+
+struct CodecHeader {
+    uint32_t magic;
+    uint32_t mode;
+    int32_t width;
+    int32_t height;
+    float errorBound;
+    uint32_t bandRows;
+    uint32_t bandCount;
+    uint32_t reserved;
+};
+
+void putU32(std::vector<uint8_t>& out, uint32_t v) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &v, 4);
+    out.insert(out.end(), bytes, bytes + 4);
+}
 
-                    float feq[9];
-                    equilibrium(1.0f, 0.0f, 0.0f, feq);
-                    for (int k = 0; k < 9; ++k) f[k][idx] = feq[k];
-                }
-            }
-        }
-    }
-    barriersDirty.store(true);
-    dataVersion++;
+uint32_t getU32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
 }
 
-void FluidEngine::step(int iterations) {
-    for(int i=0; i<iterations; ++i) {
-        applyMacroscopicBoundaries();
-        applySurfaceTension();
-        collideAndStream();
-        applyPostStreamBoundaries();
-        advectDye();
-        advectTemperature();
+void normalizeFrequencies(const uint32_t* counts, size_t total, uint32_t* freq) {
+    uint32_t sum = 0;
+    for (int s = 0; s < 256; ++s) {
+        if (counts[s] == 0) {
+            freq[s] = 0;
+            continue;
+        }
+        freq[s] = std::max<uint32_t>(1, (uint32_t)(((uint64_t)counts[s] * RANS_SCALE) / total));
+        sum += freq[s];
+    }
+    while (sum != RANS_SCALE) {
+        int best = 0;
+        for (int s = 1; s < 256; ++s) {
+            if (freq[s] > freq[best]) best = s;
+        }
+        if (sum < RANS_SCALE) {
+            freq[best] += RANS_SCALE - sum;
+            sum = RANS_SCALE;
+        } else {
+            uint32_t take = std::min(sum - RANS_SCALE, freq[best] - 1);
+            freq[best] -= take;
+            sum -= take;
+        }
     }
-    dataVersion++;
 }
 
-void FluidEngine::collideAndStream() {
-    parallel_for(0, h, [&](int startY, int endY) {
-        float feq_rest[9];
-        equilibrium(1.0f, 0.0f, 0.0f, feq_rest);
+void encodePlane(const uint8_t* src, size_t n, std::vector<uint8_t>& out) {
+    uint32_t counts[256] = {0};
+    for (size_t i = 0; i < n; ++i) counts[src[i]]++;
 
-        bool useSmagorinsky = (smagorinskyConstant > 0.0f);
-        bool useTempVisc = (temperatureViscosity > 0.0f);
-        bool useNonNewtonian = (consistencyIndex > 0.0f);
-        float n_idx_val = flowBehaviorIndex;
-        float k_idx_val = consistencyIndex;
-
-        // SIMD Constants
-        const v128_t v_zero = wasm_f32x4_splat(0.0f);
-        const v128_t v_one = wasm_f32x4_splat(1.0f);
-        const v128_t v_two = wasm_f32x4_splat(2.0f);
-        const v128_t v_three = wasm_f32x4_splat(3.0f);
-        const v128_t v_four_point_five = wasm_f32x4_splat(4.5f);
-        const v128_t v_one_point_five = wasm_f32x4_splat(1.5f);
-        const v128_t v_half = wasm_f32x4_splat(0.5f);
-        
-        v128_t v_weights[9];
-        for(int k=0; k<9; ++k) v_weights[k] = wasm_f32x4_splat(weights[k]);
+    int used = 0;
+    for (int s = 0; s < 256; ++s) {
+        if (counts[s]) used++;
+    }
+    if (used <= 1) {
+        out.push_back(PLANE_CONSTANT);
+        out.push_back(n ? src[0] : 0);
+        return;
+    }
 
-        v128_t v_cx[9], v_cy[9];
-        for(int k=0; k<9; ++k) {
-            v_cx[k] = wasm_f32x4_splat((float)cx[k]);
-            v_cy[k] = wasm_f32x4_splat((float)cy[k]);
+    uint32_t freq[256], start[256];
+    normalizeFrequencies(counts, n, freq);
+    uint32_t cumulative = 0;
+    for (int s = 0; s < 256; ++s) {
+        start[s] = cumulative;
+        cumulative += freq[s];
+    }
+
+    std::vector<uint8_t> scratch(n);
+    uint8_t* end = scratch.data() + n;
+    uint8_t* ptr = end;
+    uint32_t x = RANS_LOW;
+    bool fits = true;
+    for (size_t i = n; i-- > 0 && fits;) {
+        uint32_t s = src[i];
+        uint32_t fr = freq[s];
+        uint32_t xMax = ((RANS_LOW >> RANS_SCALE_BITS) << 8) * fr;
+        while (x >= xMax) {
+            if (ptr == scratch.data()) {
+                fits = false;
+                break;
+            }
+            *--ptr = (uint8_t)(x & 0xFF);
+            x >>= 8;
         }
+        x = ((x / fr) << RANS_SCALE_BITS) + (x % fr) + start[s];
+    }
 
-        for (int y = startY; y < endY; ++y) {
-            for (int x = 0; x < w; ++x) {
-                bool do_simd = (x >= 1) && (x <= w - 5) && (y > 0) && (y < h - 1) && !useNonNewtonian;
-                
-                if (do_simd) {
-                    int idx = y * w + x;
-                    uint32_t b_check;
-                    std::memcpy(&b_check, &barriers[idx], 4);
-                    if (b_check != 0) do_simd = false;
-                    
-                    if (do_simd && spongeStrength > 0.0f && spongeWidth > 0) {
-                         bool in_sponge = (spongeLeft && x < spongeWidth) || 
-                                          (spongeRight && (x+3) >= w - spongeWidth) ||
-                                          (spongeTop && y >= h - spongeWidth) || 
-                                          (spongeBottom && y < spongeWidth);
-                         if (in_sponge) do_simd = false;
-                    }
-                }
+    size_t streamBytes = (size_t)(end - ptr);
+    size_t encodedBytes = 32 + 2 * (size_t)used + 8 + streamBytes;
+    if (!fits || encodedBytes >= n) {
+        out.push_back(PLANE_RAW);
+        out.insert(out.end(), src, src + n);
+        return;
+    }
 
-                if (do_simd) {
-                    int idx = y * w + x;
-                    
-                    v128_t v_f[9];
-                    for(int k=0; k<9; ++k) v_f[k] = wasm_v128_load(&f[k][idx]);
+    out.push_back(PLANE_RANS);
+    uint8_t present[32] = {0};
+    for (int s = 0; s < 256; ++s) {
+        if (freq[s]) present[s >> 3] |= (uint8_t)(1 << (s & 7));
+    }
+    out.insert(out.end(), present, present + 32);
+    for (int s = 0; s < 256; ++s) {
+        if (!freq[s]) continue;
+        out.push_back((uint8_t)(freq[s] & 0xFF));
+        out.push_back((uint8_t)(freq[s] >> 8));
+    }
+    putU32(out, (uint32_t)streamBytes);
+    putU32(out, x);
+    out.insert(out.end(), ptr, end);
+}
 
-                    v128_t v_rho = v_f[0];
-                    v128_t v_ux = wasm_f32x4_mul(v_f[0], v_cx[0]);
-                    v128_t v_uy = wasm_f32x4_mul(v_f[0], v_cy[0]);
-                    
-                    for(int k=1; k<9; ++k) {
-                        v_rho = wasm_f32x4_add(v_rho, v_f[k]);
-                        v_ux = wasm_f32x4_add(v_ux, wasm_f32x4_mul(v_f[k], v_cx[k]));
-                        v_uy = wasm_f32x4_add(v_uy, wasm_f32x4_mul(v_f[k], v_cy[k]));
-                    }
-                    
-                    v128_t v_inv_rho = wasm_f32x4_div(v_one, v_rho);
-                    v128_t v_u_val = wasm_f32x4_mul(v_ux, v_inv_rho);
-                    v128_t v_v_val = wasm_f32x4_mul(v_uy, v_inv_rho);
-                    
-                    wasm_v128_store(&rho[idx], v_rho);
+bool decodePlane(const uint8_t*& p, const uint8_t* end, uint8_t* dst, size_t n) {
+    if (p >= end) return false;
+    int coding = *p++;
+    if (coding == PLANE_CONSTANT) {
+        if (p >= end) return false;
+        std::memset(dst, *p++, n);
+        return true;
+    }
+    if (coding == PLANE_RAW) {
+        if ((size_t)(end - p) < n) return false;
+        std::memcpy(dst, p, n);
+        p += n;
+        return true;
+    }
+    if (coding != PLANE_RANS || end - p < 32) return false;
+
+    const uint8_t* present = p;
+    p += 32;
+    uint32_t freq[256], start[256];
+    uint32_t cumulative = 0;
+    for (int s = 0; s < 256; ++s) {
+        freq[s] = 0;
+        if (present[s >> 3] & (1 << (s & 7))) {
+            if (end - p < 2) return false;
+            freq[s] = p[0] | (p[1] << 8);
+            p += 2;
+        }
+        start[s] = cumulative;
+        cumulative += freq[s];
+    }
+    if (cumulative != RANS_SCALE || end - p < 8) return false;
 
-                    v128_t v_fx = wasm_v128_load(&forceX[idx]);
-                    v128_t v_fy = wasm_v128_load(&forceY[idx]);
-                    v128_t v_gx = wasm_f32x4_splat(gravityX);
-                    v128_t v_gy = wasm_f32x4_splat(gravityY);
-                    
-                    v_fx = wasm_f32x4_add(v_fx, v_gx);
-                    v_fy = wasm_f32x4_add(v_fy, v_gy);
-
-                    if (thermalExpansion != 0.0f) {
-                        v128_t v_temp = wasm_v128_load(&temperature[idx]);
-                        v128_t v_refT = wasm_f32x4_splat(referenceTemperature);
-                        v128_t v_exp = wasm_f32x4_splat(thermalExpansion);
-                        v128_t v_buoyancy = wasm_f32x4_mul(v_gy, wasm_f32x4_mul(v_exp, wasm_f32x4_sub(v_temp, v_refT)));
-                        v_fy = wasm_f32x4_add(v_fy, v_buoyancy);
-                    }
+    uint8_t symbol[RANS_SCALE];
+    for (int s = 0; s < 256; ++s) {
+        std::memset(symbol + start[s], s, freq[s]);
+    }
 
-                    v128_t v_dt = wasm_f32x4_splat(dt);
-                    v128_t v_porosity = wasm_v128_load(&porosity[idx]);
-                    v128_t v_globalDrag = wasm_f32x4_splat(globalDrag);
-                    v128_t v_porosityDrag = wasm_f32x4_splat(porosityDrag);
-                    
-                    v128_t v_drag = wasm_f32x4_add(v_globalDrag, wasm_f32x4_mul(v_porosityDrag, wasm_f32x4_sub(v_one, v_porosity)));
-                    v128_t v_damp = wasm_f32x4_sub(v_one, v_drag);
-                    v_damp = wasm_f32x4_max(v_damp, v_zero);
+    uint32_t streamBytes = getU32(p);
+    uint32_t x = getU32(p + 4);
+    p += 8;
+    if ((size_t)(end - p) < streamBytes) return false;
+    const uint8_t* ptr = p;
+    const uint8_t* streamEnd = p + streamBytes;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t slot = x & (RANS_SCALE - 1);
+        uint32_t s = symbol[slot];
+        dst[i] = (uint8_t)s;
+        x = freq[s] * (x >> RANS_SCALE_BITS) + slot - start[s];
+        while (x < RANS_LOW) {
+            if (ptr >= streamEnd) return false;
+            x = (x << 8) | *ptr++;
+        }
+    }
+    p = streamEnd;
+    return true;
+}
 
-                    v128_t v_u_eq = wasm_f32x4_mul(wasm_f32x4_add(v_u_val, wasm_f32x4_mul(v_fx, v_dt)), v_damp);
-                    v128_t v_v_eq = wasm_f32x4_mul(wasm_f32x4_add(v_v_val, wasm_f32x4_mul(v_fy, v_dt)), v_damp);
-                    
-                    v128_t v_maxVel = wasm_f32x4_splat(maxVelocity);
-                    v128_t v_speedSq = wasm_f32x4_add(wasm_f32x4_mul(v_u_eq, v_u_eq), wasm_f32x4_mul(v_v_eq, v_v_eq));
-                    v128_t v_speed = wasm_f32x4_sqrt(v_speedSq);
-                    v128_t v_over = wasm_f32x4_gt(v_speed, v_maxVel);
-                    
-                    if (wasm_v128_any_true(v_over)) {
-                        v128_t v_ratio = wasm_f32x4_div(v_maxVel, v_speed);
-                        v_u_eq = wasm_v128_bitselect(wasm_f32x4_mul(v_u_eq, v_ratio), v_u_eq, v_over);
-                        v_v_eq = wasm_v128_bitselect(wasm_f32x4_mul(v_v_eq, v_ratio), v_v_eq, v_over);
+// Byte plane transpose of 16 words at a time: planes[k][i] is byte k of words[i].
+void shuffleBytes(const uint32_t* words, size_t n, uint8_t* planes) {
+    size_t i = 0;
+#ifdef __wasm_simd128__
+    for (; i + 16 <= n; i += 16) {
+        v128_t t0 = wasm_v128_load(words + i);
+        v128_t t1 = wasm_v128_load(words + i + 4);
+        v128_t t2 = wasm_v128_load(words + i + 8);
+        v128_t t3 = wasm_v128_load(words + i + 12);
+        t0 = wasm_i8x16_shuffle(t0, t0, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        t1 = wasm_i8x16_shuffle(t1, t1, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        t2 = wasm_i8x16_shuffle(t2, t2, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        t3 = wasm_i8x16_shuffle(t3, t3, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        v128_t a = wasm_i32x4_shuffle(t0, t1, 0, 4, 1, 5);
+        v128_t b = wasm_i32x4_shuffle(t2, t3, 0, 4, 1, 5);
+        v128_t c = wasm_i32x4_shuffle(t0, t1, 2, 6, 3, 7);
+        v128_t d = wasm_i32x4_shuffle(t2, t3, 2, 6, 3, 7);
+        wasm_v128_store(planes + i, wasm_i32x4_shuffle(a, b, 0, 1, 4, 5));
+        wasm_v128_store(planes + n + i, wasm_i32x4_shuffle(a, b, 2, 3, 6, 7));
+        wasm_v128_store(planes + 2 * n + i, wasm_i32x4_shuffle(c, d, 0, 1, 4, 5));
+        wasm_v128_store(planes + 3 * n + i, wasm_i32x4_shuffle(c, d, 2, 3, 6, 7));
+    }
+#endif
+    for (; i < n; ++i) {
+        for (int k = 0; k < 4; ++k) planes[k * n + i] = (uint8_t)(words[i] >> (8 * k));
+    }
+}
+
+void unshuffleBytes(const uint8_t* planes, size_t n, uint32_t* words) {
+    size_t i = 0;
+#ifdef __wasm_simd128__
+    for (; i + 16 <= n; i += 16) {
+        v128_t p0 = wasm_v128_load(planes + i);
+        v128_t p1 = wasm_v128_load(planes + n + i);
+        v128_t p2 = wasm_v128_load(planes + 2 * n + i);
+        v128_t p3 = wasm_v128_load(planes + 3 * n + i);
+        v128_t a = wasm_i32x4_shuffle(p0, p1, 0, 4, 1, 5);
+        v128_t b = wasm_i32x4_shuffle(p2, p3, 0, 4, 1, 5);
+        v128_t c = wasm_i32x4_shuffle(p0, p1, 2, 6, 3, 7);
+        v128_t d = wasm_i32x4_shuffle(p2, p3, 2, 6, 3, 7);
+        v128_t t0 = wasm_i32x4_shuffle(a, b, 0, 1, 4, 5);
+        v128_t t1 = wasm_i32x4_shuffle(a, b, 2, 3, 6, 7);
+        v128_t t2 = wasm_i32x4_shuffle(c, d, 0, 1, 4, 5);
+        v128_t t3 = wasm_i32x4_shuffle(c, d, 2, 3, 6, 7);
+        wasm_v128_store(words + i, wasm_i8x16_shuffle(t0, t0, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15));
+        wasm_v128_store(words + i + 4, wasm_i8x16_shuffle(t1, t1, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15));
+        wasm_v128_store(words + i + 8, wasm_i8x16_shuffle(t2, t2, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15));
+        wasm_v128_store(words + i + 12, wasm_i8x16_shuffle(t3, t3, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15));
+    }
+#endif
+    for (; i < n; ++i) {
+        words[i] = planes[i] | (planes[n + i] << 8) | (planes[2 * n + i] << 16) | ((uint32_t)planes[3 * n + i] << 24);
+    }
+}
+
+void encodeBandLossless(const float* src, int width, int rows, std::vector<uint8_t>& out) {
+    size_t n = (size_t)width * rows;
+    std::vector<uint32_t> delta(n);
+    std::vector<uint8_t> planes(4 * n);
+    const uint32_t* bits = (const uint32_t*)src;
+    for (int y = 0; y < rows; ++y) {
+        const uint32_t* row = bits + (size_t)y * width;
+        uint32_t* d = delta.data() + (size_t)y * width;
+        d[0] = row[0] ^ (y > 0 ? row[-width] : 0u);
+        int x = 1;
+#ifdef __wasm_simd128__
+        for (; x + 4 <= width; x += 4) {
+            wasm_v128_store(d + x, wasm_v128_xor(wasm_v128_load(row + x), wasm_v128_load(row + x - 1)));
+        }
+#endif
+        for (; x < width; ++x) d[x] = row[x] ^ row[x - 1];
+    }
+    shuffleBytes(delta.data(), n, planes.data());
+    for (int k = 0; k < 4; ++k) encodePlane(planes.data() + k * n, n, out);
+}
+
+bool decodeBandLossless(const uint8_t* p, const uint8_t* end, int width, int rows, float* dst) {
+    size_t n = (size_t)width * rows;
+    std::vector<uint8_t> planes(4 * n);
+    for (int k = 0; k < 4; ++k) {
+        if (!decodePlane(p, end, planes.data() + k * n, n)) return false;
+    }
+    uint32_t* bits = (uint32_t*)dst;
+    unshuffleBytes(planes.data(), n, bits);
+    for (int y = 0; y < rows; ++y) {
+        uint32_t* row = bits + (size_t)y * width;
+        if (y > 0) row[0] ^= row[-width];
+        for (int x = 1; x < width; ++x) row[x] ^= row[x - 1];
+    }
+    return true;
+}
+
+// Prediction runs on the integer quantization indices, so encoder and decoder agree exactly
+// whatever floating point contraction or reassociation the compiler applies.
+inline int64_t lorenzoPredict(const int64_t* k, int x, int y, int width) {
+    if (x > 0 && y > 0) return k[-1] + k[-width] - k[-width - 1];
+    if (x > 0) return k[-1];
+    if (y > 0) return k[-width];
+    return 0;
+}
+
+// Fast-math builds may assume values are finite and fold range checks that would reject NaN or
+// infinity, so the exponent bits decide.
+inline bool finiteBits(float v) {
+    uint32_t bits;
+    std::memcpy(&bits, &v, 4);
+    return (bits & 0x7F800000u) != 0x7F800000u;
+}
+
+void encodeBandLossy(const float* src, int width, int rows, float errorBound, std::vector<uint8_t>& out) {
+    size_t n = (size_t)width * rows;
+    std::vector<int64_t> index(n);
+    std::vector<uint8_t> planes(2 * n);
+    std::vector<int32_t> wide;
+    std::vector<float> outliers;
+    float quantum = 2.0f * errorBound;
+    float inverse = 1.0f / quantum;
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < width; ++x) {
+            size_t i = (size_t)y * width + x;
+            float v = src[i];
+            int64_t pred = lorenzoPredict(index.data() + i, x, y, width);
+            uint16_t code = LOSSY_OUTLIER;
+            float scaled = v * inverse;
+            if (finiteBits(scaled) && scaled > -LOSSY_INDEX_RANGE && scaled < LOSSY_INDEX_RANGE) {
+                int64_t k = (int64_t)std::floor(scaled + 0.5f);
+                if (std::fabs((float)k * quantum - v) <= errorBound) {
+                    int64_t residual = k - pred;
+                    if (residual > -LOSSY_CODE_RANGE && residual < LOSSY_CODE_RANGE) {
+                        code = (uint16_t)((residual << 1) ^ (residual >> 63));
+                    } else {
+                        code = LOSSY_WIDE;
+                        wide.push_back((int32_t)residual);
+                    }
+                    index[i] = k;
+                }
+            }
+            if (code == LOSSY_OUTLIER) {
+                outliers.push_back(v);
+                index[i] = pred;
+            }
+            planes[i] = (uint8_t)(code & 0xFF);
+            planes[n + i] = (uint8_t)(code >> 8);
+        }
+    }
+    putU32(out, (uint32_t)wide.size());
+    const uint8_t* raw = (const uint8_t*)wide.data();
+    out.insert(out.end(), raw, raw + wide.size() * sizeof(int32_t));
+    putU32(out, (uint32_t)outliers.size());
+    raw = (const uint8_t*)outliers.data();
+    out.insert(out.end(), raw, raw + outliers.size() * sizeof(float));
+    encodePlane(planes.data(), n, out);
+    encodePlane(planes.data() + n, n, out);
+}
+
+bool decodeBandLossy(const uint8_t* p, const uint8_t* end, int width, int rows, float errorBound, float* dst) {
+    size_t n = (size_t)width * rows;
+    if (end - p < 4) return false;
+    size_t wideCount = getU32(p);
+    p += 4;
+    if ((size_t)(end - p) / sizeof(int32_t) < wideCount) return false;
+    const uint8_t* wide = p;
+    p += wideCount * sizeof(int32_t);
+    if (end - p < 4) return false;
+    size_t outlierCount = getU32(p);
+    p += 4;
+    if ((size_t)(end - p) / sizeof(float) < outlierCount) return false;
+    const uint8_t* outliers = p;
+    p += outlierCount * sizeof(float);
+
+    std::vector<uint8_t> planes(2 * n);
+    if (!decodePlane(p, end, planes.data(), n)) return false;
+    if (!decodePlane(p, end, planes.data() + n, n)) return false;
+
+    std::vector<int64_t> index(n);
+    float quantum = 2.0f * errorBound;
+    size_t nextWide = 0, nextOutlier = 0;
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < width; ++x) {
+            size_t i = (size_t)y * width + x;
+            int64_t pred = lorenzoPredict(index.data() + i, x, y, width);
+            uint16_t code = planes[i] | (planes[n + i] << 8);
+            if (code == LOSSY_OUTLIER) {
+                if (nextOutlier >= outlierCount) return false;
+                std::memcpy(dst + i, outliers + nextOutlier * sizeof(float), sizeof(float));
+                nextOutlier++;
+                index[i] = pred;
+                continue;
+            }
+            int64_t residual;
+            if (code == LOSSY_WIDE) {
+                if (nextWide >= wideCount) return false;
+                int32_t value;
+                std::memcpy(&value, wide + nextWide * sizeof(int32_t), sizeof(int32_t));
+                nextWide++;
+                residual = value;
+            } else {
+                residual = (int64_t)(code >> 1) ^ -(int64_t)(code & 1);
+            }
+            index[i] = pred + residual;
+            dst[i] = (float)index[i] * quantum;
+        }
+    }
+    return true;
+}
+}
+
+void FluidEngine::encodeField(const float* src, int width, int height, int mode, float errorBound,
+                              std::vector<uint8_t>& out, bool parallel) {
+    bool lossy = (mode == COMPRESS_LOSSY && errorBound > 0.0f);
+    int bandCount = (height + CODEC_BAND_ROWS - 1) / CODEC_BAND_ROWS;
+    std::vector<std::vector<uint8_t>> bands(bandCount);
+    auto work = [&](int startBand, int endBand) {
+        for (int b = startBand; b < endBand; ++b) {
+            int y0 = b * CODEC_BAND_ROWS;
+            int rows = std::min(CODEC_BAND_ROWS, height - y0);
+            const float* band = src + (size_t)y0 * width;
+            if (lossy) encodeBandLossy(band, width, rows, errorBound, bands[b]);
+            else encodeBandLossless(band, width, rows, bands[b]);
+        }
+    };
+    if (parallel) parallel_for(0, bandCount, work);
+    else work(0, bandCount);
+
+    CodecHeader header;
+    header.magic = CODEC_MAGIC;
+    header.mode = lossy ? COMPRESS_LOSSY : COMPRESS_LOSSLESS;
+    header.width = width;
+    header.height = height;
+    header.errorBound = lossy ? errorBound : 0.0f;
+    header.bandRows = CODEC_BAND_ROWS;
+    header.bandCount = bandCount;
+    header.reserved = 0;
+
+    size_t total = sizeof(header) + 4 * (size_t)bandCount;
+    for (const auto& band : bands) total += band.size();
+    out.clear();
+    out.reserve(total);
+    const uint8_t* raw = (const uint8_t*)&header;
+    out.insert(out.end(), raw, raw + sizeof(header));
+    for (const auto& band : bands) putU32(out, (uint32_t)band.size());
+    for (const auto& band : bands) out.insert(out.end(), band.begin(), band.end());
+}
+
+bool FluidEngine::decodeField(const uint8_t* data, size_t size, int width, int height, float* dst, bool parallel) {
+    if (size < sizeof(CodecHeader)) return false;
+    CodecHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != CODEC_MAGIC || header.width != width || header.height != height) return false;
+    if (header.bandRows == 0 || header.bandCount != (height + header.bandRows - 1) / header.bandRows) return false;
+    if (header.mode != COMPRESS_LOSSLESS && header.mode != COMPRESS_LOSSY) return false;
+
+    int bandCount = header.bandCount;
+    if ((size - sizeof(header)) / 4 < (size_t)bandCount) return false;
+    std::vector<size_t> offsets(bandCount + 1);
+    offsets[0] = sizeof(header) + 4 * (size_t)bandCount;
+    for (int b = 0; b < bandCount; ++b) {
+        offsets[b + 1] = offsets[b] + getU32(data + sizeof(header) + 4 * b);
+    }
+    if (offsets[bandCount] > size) return false;
+
+    std::atomic<bool> ok(true);
+    auto work = [&](int startBand, int endBand) {
+        for (int b = startBand; b < endBand; ++b) {
+            int y0 = b * header.bandRows;
+            int rows = std::min((int)header.bandRows, height - y0);
+            const uint8_t* p = data + offsets[b];
+            const uint8_t* end = data + offsets[b + 1];
+            float* band = dst + (size_t)y0 * width;
+            bool decoded = (header.mode == COMPRESS_LOSSY)
+                ? decodeBandLossy(p, end, width, rows, header.errorBound, band)
+                : decodeBandLossless(p, end, width, rows, band);
+            if (!decoded) ok = false;
+        }
+    };
+    if (parallel) parallel_for(0, bandCount, work);
+    else work(0, bandCount);
+    return ok;
+}
+
+const std::vector<float>* FluidEngine::codecSource(int field) const {
+    if (field >= CODEC_F0 && field < CODEC_F0 + 9) return &f[field - CODEC_F0];
+    switch (field) {
+        case CODEC_UX: return &ux;
+        case CODEC_UY: return &uy;
+        case CODEC_RHO: return &rho;
+        case CODEC_DYE: return &dye;
+        case CODEC_TEMPERATURE: return &temperature;
+        case CODEC_POROSITY: return &porosity;
+        default: return nullptr;
+    }
+}
+
+// Halo rows carry everything the next iteration reads from a neighbour: populations, the
+// macroscopic fields, both scalars and the pending body force. Geometry is not exchanged; each
+// subdomain applies the same obstacle and porosity edits clipped to its own rows.
+static const int HALO_FIELD_COUNT = 16;
+
+int FluidEngine::getHaloRowSize() const {
+    return w * HALO_FIELD_COUNT;
+}
+
+// Rows one iteration reads across a band edge: streaming and the scalar backtrace reach two, the
+// BFECC round trip and the curl stencil of vorticity confinement reach four.
+int FluidEngine::getHaloRowsNeeded() const {
+    return (useBFECC || vorticityConfinement > 0.0f) ? 4 : 2;
+}
+
+void FluidEngine::exportRows(int y, int rows, float* dst) const {
+    const std::vector<float>* fields[HALO_FIELD_COUNT] = {
+        &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7], &f[8],
+        &rho, &ux, &uy, &dye, &temperature, &forceX, &forceY};
+    size_t count = (size_t)rows * w;
+    for (int i = 0; i < HALO_FIELD_COUNT; ++i) {
+        std::memcpy(dst, fields[i]->data() + (size_t)y * w, count * sizeof(float));
+        dst += count;
+    }
+}
+
+// Not journaled: a subdomain's session only replays together with its neighbours.
+void FluidEngine::importRows(int y, int rows, const float* src) {
+    std::vector<float>* fields[HALO_FIELD_COUNT] = {
+        &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7], &f[8],
+        &rho, &ux, &uy, &dye, &temperature, &forceX, &forceY};
+    size_t count = (size_t)rows * w;
+    for (int i = 0; i < HALO_FIELD_COUNT; ++i) {
+        std::memcpy(fields[i]->data() + (size_t)y * w, src, count * sizeof(float));
+        src += count;
+    }
+    const float* dyeRows = dye.data() + (size_t)y * w;
+    const float* temperatureRows = temperature.data() + (size_t)y * w;
+    for (size_t i = 0; i < count && !(dyeActive && temperatureActive); ++i) {
+        if (dyeRows[i] != 0.0f) dyeActive = true;
+        if (temperatureRows[i] != 0.0f) temperatureActive = true;
+    }
+    dataVersion++;
+}
+
+size_t FluidEngine::compressFieldTo(int field, int mode, float errorBound, std::vector<uint8_t>& out) {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    const std::vector<float>* src = codecSource(field);
+    if (!src || mode == COMPRESS_NONE) {
+        out.clear();
+        return 0;
+    }
+    encodeField(src->data(), w, h, mode, errorBound, out, true);
+    return out.size();
+}
+
+bool FluidEngine::decompressFieldTo(const uint8_t* data, size_t size, std::vector<float>& out) {
+    out.resize((size_t)w * h);
+    return decodeField(data, size, w, h, out.data(), true);
+}
+
+#ifdef __EMSCRIPTEN__
+val FluidEngine::compressField(int field, int mode, float errorBound) {
+    size_t size = compressFieldTo(field, mode, errorBound, codecBuffer);
+    compressionRatio = size ? (float)((double)w * h * sizeof(float) / size) : 0.0f;
+    return val(typed_memory_view(codecBuffer.size(), codecBuffer.data()));
+}
+
+val FluidEngine::decompressField(val buffer) {
+    val bytes = val::global("Uint8Array").new_(buffer);
+    size_t size = bytes["length"].as<size_t>();
+    codecBuffer.resize(size);
+    val(typed_memory_view(size, codecBuffer.data())).call<void>("set", bytes);
+    if (!decompressFieldTo(codecBuffer.data(), size, codecFloats)) return val::null();
+    return val(typed_memory_view(codecFloats.size(), codecFloats.data()));
+}
+#endif
+
+float FluidEngine::getCompressionRatio() {
+    return compressionRatio;
+}
+
+void FluidEngine::setCheckpointCompression(int mode) {
+    // Restarts must be exact, so checkpoints only take the lossless codec.
+    checkpointCodec = (mode == COMPRESS_NONE) ? COMPRESS_NONE : COMPRESS_LOSSLESS;
+}
+
+void FluidEngine::setOutputCompression(int mode, float errorBound) {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    outputCodec = mode;
+    outputErrorBound = errorBound;
+}
+
+// Checkpoint layout: a fixed header followed by raw little-endian blocks, each starting on a
+// CHECKPOINT_ALIGN boundary so a mapped file can be read in place.
+namespace {
+const uint32_t CHECKPOINT_MAGIC = 0x4B43424Cu;
+const uint32_t CHECKPOINT_VERSION = 2;
+const uint64_t CHECKPOINT_ALIGN = 64;
+const int CHECKPOINT_MAX_PARAMS = 48;
+
+enum CheckpointBlock {
+    BLOCK_F0 = 0,
+    BLOCK_BARRIERS = 9,
+    BLOCK_POROSITY,
+    BLOCK_DYE,
+    BLOCK_TEMPERATURE,
+    BLOCK_RHO,
+    BLOCK_UX,
+    BLOCK_UY,
+    BLOCK_FORCE_X,
+    BLOCK_FORCE_Y,
+    BLOCK_COUNT
+};
+
+enum CheckpointFlags {
+    CKPT_SPONGE_LEFT = 1 << 0,
+    CKPT_SPONGE_RIGHT = 1 << 1,
+    CKPT_SPONGE_TOP = 1 << 2,
+    CKPT_SPONGE_BOTTOM = 1 << 3,
+    CKPT_BFECC = 1 << 4,
+    CKPT_DYE_ACTIVE = 1 << 5,
+    CKPT_TEMPERATURE_ACTIVE = 1 << 6,
+    CKPT_PHASE_SHIFT = 8,
+    CKPT_PHASE_MASK = 0xF << CKPT_PHASE_SHIFT,
+    CKPT_COLLISION_SHIFT = 12,
+    CKPT_COLLISION_MASK = 0x3 << CKPT_COLLISION_SHIFT
+};
+
+struct CheckpointHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t flags;
+    int32_t width;
+    int32_t height;
+    int32_t boundary[4];
+    int32_t spongeWidth;
+    uint32_t randomSeed;
+    uint32_t brushSerial;
+    uint32_t paramCount;
+    uint64_t stepCount;
+    float params[CHECKPOINT_MAX_PARAMS];
+    uint64_t blockOffset[BLOCK_COUNT];
+    uint64_t blockSize[BLOCK_COUNT];
+    uint32_t blockCodec[BLOCK_COUNT];
+};
+
+uint64_t alignCheckpoint(uint64_t offset) {
+    return (offset + CHECKPOINT_ALIGN - 1) & ~(CHECKPOINT_ALIGN - 1);
+}
+
+void resampleField(const float* src, int sw, int sh, float* dst, int dw, int dh) {
+    float sx = (float)sw / (float)dw;
+    float sy = (float)sh / (float)dh;
+    for (int y = 0; y < dh; ++y) {
+        float py = std::min(std::max((y + 0.5f) * sy - 0.5f, 0.0f), (float)(sh - 1));
+        int iy = std::min((int)py, sh - 2 < 0 ? 0 : sh - 2);
+        float fy = (sh > 1) ? py - iy : 0.0f;
+        int iy1 = std::min(iy + 1, sh - 1);
+        for (int x = 0; x < dw; ++x) {
+            float px = std::min(std::max((x + 0.5f) * sx - 0.5f, 0.0f), (float)(sw - 1));
+            int ix = std::min((int)px, sw - 2 < 0 ? 0 : sw - 2);
+            float fx = (sw > 1) ? px - ix : 0.0f;
+            int ix1 = std::min(ix + 1, sw - 1);
+            float top = src[iy * sw + ix] * (1.0f - fx) + src[iy * sw + ix1] * fx;
+            float bottom = src[iy1 * sw + ix] * (1.0f - fx) + src[iy1 * sw + ix1] * fx;
+            dst[y * dw + x] = top * (1.0f - fy) + bottom * fy;
+        }
+    }
+}
+}
+
+int FluidEngine::checkpointParams(float** out) {
+    float* params[] = {
+        &omega, &decay, &globalDrag, &surfaceTension, &gCohesion, &dt,
+        &inflowVelocityX, &inflowVelocityY, &inflowDensity,
+        &movingWallVelocityLeftX, &movingWallVelocityLeftY,
+        &movingWallVelocityRightX, &movingWallVelocityRightY,
+        &movingWallVelocityTopX, &movingWallVelocityTopY,
+        &movingWallVelocityBottomX, &movingWallVelocityBottomY,
+        &gravityX, &gravityY, &thermalExpansion, &referenceTemperature,
+        &thermalDiffusivity, &vorticityConfinement, &maxVelocity,
+        &smagorinskyConstant, &temperatureViscosity, &flowBehaviorIndex, &consistencyIndex,
+        &porosityDrag, &spongeStrength, &inflowTurbulenceIntensity, &inflowTurbulenceScale
+    };
+    int count = (int)(sizeof(params) / sizeof(params[0]));
+    for (int i = 0; i < count; ++i) out[i] = params[i];
+    return count;
+}
+
+void FluidEngine::writeCheckpoint(std::vector<uint8_t>& out) {
+    size_t cells = (size_t)w * h;
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.headerSize = sizeof(CheckpointHeader);
+    header.width = w;
+    header.height = h;
+    header.boundary[0] = boundaryLeft;
+    header.boundary[1] = boundaryRight;
+    header.boundary[2] = boundaryTop;
+    header.boundary[3] = boundaryBottom;
+    header.spongeWidth = spongeWidth;
+    header.randomSeed = randomSeed;
+    header.brushSerial = brushSerial;
+    header.stepCount = stepCount;
+    header.flags = (spongeLeft ? CKPT_SPONGE_LEFT : 0) | (spongeRight ? CKPT_SPONGE_RIGHT : 0) |
+                   (spongeTop ? CKPT_SPONGE_TOP : 0) | (spongeBottom ? CKPT_SPONGE_BOTTOM : 0) |
+                   (useBFECC ? CKPT_BFECC : 0) | (dyeActive ? CKPT_DYE_ACTIVE : 0) |
+                   (temperatureActive ? CKPT_TEMPERATURE_ACTIVE : 0) |
+                   ((uint32_t)stepPhase << CKPT_PHASE_SHIFT) |
+                   ((uint32_t)collisionModel << CKPT_COLLISION_SHIFT);
+
+    float* params[CHECKPOINT_MAX_PARAMS];
+    header.paramCount = checkpointParams(params);
+    for (uint32_t i = 0; i < header.paramCount; ++i) header.params[i] = *params[i];
+
+    const void* blocks[BLOCK_COUNT];
+    for (int k = 0; k < 9; ++k) {
+        blocks[BLOCK_F0 + k] = f[k].data();
+        header.blockSize[BLOCK_F0 + k] = cells * sizeof(float);
+    }
+    blocks[BLOCK_BARRIERS] = barriers.data();
+    header.blockSize[BLOCK_BARRIERS] = cells;
+    blocks[BLOCK_POROSITY] = porosity.data();
+    header.blockSize[BLOCK_POROSITY] = cells * sizeof(float);
+    blocks[BLOCK_DYE] = dye.data();
+    header.blockSize[BLOCK_DYE] = cells * sizeof(float);
+    blocks[BLOCK_TEMPERATURE] = temperature.data();
+    blocks[BLOCK_RHO] = rho.data();
+    blocks[BLOCK_UX] = ux.data();
+    blocks[BLOCK_UY] = uy.data();
+    blocks[BLOCK_FORCE_X] = forceX.data();
+    blocks[BLOCK_FORCE_Y] = forceY.data();
+    for (int b = BLOCK_TEMPERATURE; b < BLOCK_COUNT; ++b) header.blockSize[b] = cells * sizeof(float);
+
+    std::vector<uint8_t> encoded[BLOCK_COUNT];
+    if (checkpointCodec != COMPRESS_NONE) {
+        for (int b = 0; b < BLOCK_COUNT; ++b) {
+            if (b == BLOCK_BARRIERS) continue;
+            encodeField((const float*)blocks[b], w, h, checkpointCodec, 0.0f, encoded[b], true);
+            blocks[b] = encoded[b].data();
+            header.blockSize[b] = encoded[b].size();
+            header.blockCodec[b] = checkpointCodec;
+        }
+    }
+
+    uint64_t offset = alignCheckpoint(sizeof(CheckpointHeader));
+    for (int b = 0; b < BLOCK_COUNT; ++b) {
+        header.blockOffset[b] = offset;
+        offset = alignCheckpoint(offset + header.blockSize[b]);
+    }
+
+    out.assign(offset, 0);
+    std::memcpy(out.data(), &header, sizeof(header));
+    for (int b = 0; b < BLOCK_COUNT; ++b) {
+        std::memcpy(out.data() + header.blockOffset[b], blocks[b], header.blockSize[b]);
+    }
+}
+
+// Checks everything a load trusts before any state changes (header, block layout, parameter values
+// and boundary codes), then decodes the compressed blocks into `decoded`, BLOCK_COUNT entries; raw
+// blocks stay empty and are read in place. The barrier block is always raw at one byte per cell,
+// so it bounds the cell count by the blob size before anything is allocated.
+bool FluidEngine::decodeCheckpoint(const uint8_t* data, size_t size, std::vector<float>* decoded, bool parallel) {
+    if (size < sizeof(CheckpointHeader)) return false;
+    CheckpointHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION) return false;
+    if (header.headerSize != sizeof(CheckpointHeader) || header.width <= 0 || header.height <= 0) return false;
+
+    uint64_t srcCells = (uint64_t)header.width * (uint64_t)header.height;
+    if (header.blockCodec[BLOCK_BARRIERS] != COMPRESS_NONE || header.blockSize[BLOCK_BARRIERS] != srcCells) return false;
+    for (int b = 0; b < BLOCK_COUNT; ++b) {
+        if (header.blockOffset[b] % CHECKPOINT_ALIGN != 0) return false;
+        if (header.blockOffset[b] > size || header.blockSize[b] > size - header.blockOffset[b]) return false;
+        if (header.blockCodec[b] == COMPRESS_NONE) {
+            uint64_t expected = (b == BLOCK_BARRIERS) ? srcCells : srcCells * sizeof(float);
+            if (header.blockSize[b] != expected) return false;
+        }
+    }
+
+    float* params[CHECKPOINT_MAX_PARAMS];
+    int count = checkpointParams(params);
+    for (int i = 0; i < count && i < (int)header.paramCount; ++i) {
+        float v = header.params[i];
+        if (!finiteBits(v)) return false;
+        if (params[i] == &omega && !(v > 0.0f && v < 2.0f)) return false;
+    }
+    // Boundary types run from periodic (0) to outflow (5).
+    for (int side = 0; side < 4; ++side) {
+        if (header.boundary[side] < 0 || header.boundary[side] > 5) return false;
+    }
+    if (header.spongeWidth < 0) return false;
+
+    for (int b = 0; b < BLOCK_COUNT; ++b) {
+        if (header.blockCodec[b] == COMPRESS_NONE) continue;
+        decoded[b].resize((size_t)srcCells);
+        if (!decodeField(data + header.blockOffset[b], header.blockSize[b], header.width, header.height,
+                         decoded[b].data(), parallel)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FluidEngine::readCheckpoint(const uint8_t* data, size_t size) {
+    if (asyncActive && std::this_thread::get_id() != asyncThreadId) {
+        // Validated here so the caller learns the outcome; the worker pool belongs to the
+        // simulation thread, so compressed blocks decode serially.
+        std::vector<float> decoded[BLOCK_COUNT];
+        if (!decodeCheckpoint(data, size, decoded, false)) return false;
+        QueuedCommand cmd;
+        cmd.op = OP_LOAD_CHECKPOINT;
+        cmd.size = 0;
+        cmd.checkpoint = new std::vector<uint8_t>(data, data + size);
+        pushCommand(cmd);
+        return true;
+    }
+    std::vector<float> decoded[BLOCK_COUNT];
+    if (!decodeCheckpoint(data, size, decoded, true)) return false;
+    CheckpointHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    int sw = header.width;
+    int sh = header.height;
+    size_t srcCells = (size_t)sw * sh;
+
+    // Journaled only once valid, so a replay never stops at a load the live session rejected.
+    if (journalActive) {
+        record(stepCount, OP_LOAD_CHECKPOINT, (unsigned int)size);
+        journal.insert(journal.end(), data, data + size);
+    }
+
+    bool sameSize = (sw == w && sh == h);
+    auto block = [&](int b) {
+        return decoded[b].empty() ? (const float*)(data + header.blockOffset[b]) : decoded[b].data();
+    };
+
+    auto loadScalar = [&](int b, std::vector<float>& dst) {
+        if (sameSize) std::memcpy(dst.data(), block(b), srcCells * sizeof(float));
+        else resampleField(block(b), sw, sh, dst.data(), w, h);
+    };
+
+    for (int k = 0; k < 9; ++k) loadScalar(BLOCK_F0 + k, f[k]);
+    loadScalar(BLOCK_POROSITY, porosity);
+    loadScalar(BLOCK_DYE, dye);
+    loadScalar(BLOCK_TEMPERATURE, temperature);
+    loadScalar(BLOCK_RHO, rho);
+    loadScalar(BLOCK_UX, ux);
+    loadScalar(BLOCK_UY, uy);
+    loadScalar(BLOCK_FORCE_X, forceX);
+    loadScalar(BLOCK_FORCE_Y, forceY);
+
+    const uint8_t* srcBarriers = data + header.blockOffset[BLOCK_BARRIERS];
+    if (sameSize) {
+        std::memcpy(barriers.data(), srcBarriers, srcCells);
+    } else {
+        for (int y = 0; y < h; ++y) {
+            int syi = std::min(sh - 1, (int)((y + 0.5f) * sh / h));
+            for (int x = 0; x < w; ++x) {
+                int sxi = std::min(sw - 1, (int)((x + 0.5f) * sw / w));
+                barriers[y * w + x] = srcBarriers[syi * sw + sxi];
+            }
+        }
+    }
+
+    float* params[CHECKPOINT_MAX_PARAMS];
+    int count = checkpointParams(params);
+    for (int i = 0; i < count && i < (int)header.paramCount; ++i) *params[i] = header.params[i];
+
+    boundaryLeft = header.boundary[0];
+    boundaryRight = header.boundary[1];
+    boundaryTop = header.boundary[2];
+    boundaryBottom = header.boundary[3];
+    spongeWidth = header.spongeWidth;
+    spongeLeft = (header.flags & CKPT_SPONGE_LEFT) != 0;
+    spongeRight = (header.flags & CKPT_SPONGE_RIGHT) != 0;
+    spongeTop = (header.flags & CKPT_SPONGE_TOP) != 0;
+    spongeBottom = (header.flags & CKPT_SPONGE_BOTTOM) != 0;
+    useBFECC = (header.flags & CKPT_BFECC) != 0;
+    dyeActive = (header.flags & CKPT_DYE_ACTIVE) != 0;
+    temperatureActive = (header.flags & CKPT_TEMPERATURE_ACTIVE) != 0;
+    stepPhase = std::min((int)((header.flags & CKPT_PHASE_MASK) >> CKPT_PHASE_SHIFT), (int)PHASE_COUNT - 1);
+    collisionModel = std::min((int)((header.flags & CKPT_COLLISION_MASK) >> CKPT_COLLISION_SHIFT), (int)COLLISION_MODEL_COUNT - 1);
+    randomSeed = header.randomSeed;
+    brushSerial = header.brushSerial;
+    stepCount = header.stepCount;
+    setHandlers();
+    labelComponents();
+
+    if (!sameSize) {
+        // Resampling blends fluid and solid cells; put solids back at rest.
+        float feq_rest[9];
+        equilibrium(1.0f, 0.0f, 0.0f, feq_rest);
+        for (int idx = 0; idx < w * h; ++idx) {
+            if (!barriers[idx]) continue;
+            rho[idx] = 1.0f;
+            ux[idx] = 0.0f;
+            uy[idx] = 0.0f;
+            for (int k = 0; k < 9; ++k) f[k][idx] = feq_rest[k];
+        }
+    }
+
+    for (int i = 0; i < FIELD_COUNT; ++i) markFieldDirty(i);
+    markDirtyRect(FIELD_BARRIERS, 0, 0, w, h);
+    markDirtyRect(FIELD_POROSITY, 0, 0, w, h);
+    barriersDirty.store(true);
+    dataVersion++;
+    journalStep = stepCount;
+    return true;
+}
+
+#ifdef __EMSCRIPTEN__
+val FluidEngine::saveCheckpoint() {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    writeCheckpoint(checkpointBuffer);
+    return val(typed_memory_view(checkpointBuffer.size(), checkpointBuffer.data()));
+}
+
+bool FluidEngine::loadCheckpoint(val arrayBuffer) {
+    val bytes = val::global("Uint8Array").new_(arrayBuffer);
+    size_t size = bytes["length"].as<size_t>();
+    checkpointBuffer.resize(size);
+    val(typed_memory_view(size, checkpointBuffer.data())).call<void>("set", bytes);
+    bool ok = readCheckpoint(checkpointBuffer.data(), size);
+    std::vector<uint8_t>().swap(checkpointBuffer);
+    return ok;
+}
+#endif
+
+bool FluidEngine::saveCheckpointFile(const std::string& path) {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    writeCheckpoint(checkpointBuffer);
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(checkpointBuffer.data(), 1, checkpointBuffer.size(), file) == checkpointBuffer.size();
+    ok = (std::fclose(file) == 0) && ok;
+    std::vector<uint8_t>().swap(checkpointBuffer);
+    return ok;
+}
+
+bool FluidEngine::loadCheckpointFile(const std::string& path) {
+#ifndef __EMSCRIPTEN__
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    bool ok = readCheckpoint((const uint8_t*)mapped, size);
+    munmap(mapped, size);
+    return ok;
+#else
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        std::fclose(file);
+        return false;
+    }
+    checkpointBuffer.resize((size_t)size);
+    bool ok = std::fread(checkpointBuffer.data(), 1, checkpointBuffer.size(), file) == checkpointBuffer.size();
+    std::fclose(file);
+    ok = ok && readCheckpoint(checkpointBuffer.data(), checkpointBuffer.size());
+    std::vector<uint8_t>().swap(checkpointBuffer);
+    return ok;
+#endif
+}
+
+// Time-series output: one append-only fields.raw holding each captured frame as consecutive
+// float32 fields, plus an index.json describing the layout. The solver copies into a pooled
+// buffer and hands it to the I/O thread; if no buffer is free the frame is dropped, never waited on.
+namespace {
+const char* const OUTPUT_FIELD_NAMES[] = { "ux", "uy", "rho", "dye", "temperature" };
+const int OUTPUT_FIELD_KINDS = 5;
+}
+
+bool FluidEngine::startFieldOutput(const std::string& directory, int fieldMask, int stride, int bufferCount) {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    closeFieldOutput();
+    fieldMask &= OUTPUT_ALL;
+    if (fieldMask == 0) return false;
+
+    mkdir(directory.c_str(), 0755);
+    outputFile = std::fopen((directory + "/fields.raw").c_str(), "wb");
+    if (!outputFile) return false;
+
+    outputDirectory = directory;
+    outputFieldMask = fieldMask;
+    outputFieldCount = 0;
+    for (int i = 0; i < OUTPUT_FIELD_KINDS; ++i) {
+        if (fieldMask & (1 << i)) outputFieldCount++;
+    }
+    outputStride = std::max(1, stride);
+    outputFrameCounter = 0;
+    outputOffset = 0;
+    outputIndex.clear();
+    outputWritten = 0;
+    outputDropped = 0;
+    outputLate = 0;
+
+    int count = std::max(2, bufferCount);
+    outputPool.assign(count, OutputFrame());
+    outputFree.clear();
+    for (int i = 0; i < count; ++i) {
+        outputPool[i].data.resize((size_t)outputFieldCount * w * h);
+        outputFree.push_back(i);
+    }
+    outputQueue = std::queue<int>();
+    outputStop = false;
+    outputActive = true;
+
+    #ifdef FLUID_THREADS
+        outputThread = std::thread([this] {
+            while (true) {
+                int slot, codec;
+                float errorBound;
+                bool behind;
+                {
+                    std::unique_lock<std::mutex> lock(outputMutex);
+                    outputCv.wait(lock, [this] { return outputStop || !outputQueue.empty(); });
+                    if (outputQueue.empty()) return;
+                    slot = outputQueue.front();
+                    outputQueue.pop();
+                    behind = !outputQueue.empty();
+                    codec = outputCodec;
+                    errorBound = outputErrorBound;
+                }
+                if (behind) outputLate++;
+                writeOutputFrame(outputPool[slot], codec, errorBound);
+                {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    outputFree.push_back(slot);
+                }
+            }
+        });
+    #endif
+    return true;
+}
+
+void FluidEngine::stopFieldOutput() {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    closeFieldOutput();
+}
+
+void FluidEngine::closeFieldOutput() {
+    if (!outputActive) return;
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        outputStop = true;
+    }
+    outputCv.notify_one();
+    if (outputThread.joinable()) outputThread.join();
+
+    writeOutputIndex();
+    std::fclose(outputFile);
+    outputFile = nullptr;
+    outputActive = false;
+    std::vector<OutputFrame>().swap(outputPool);
+    outputFree.clear();
+}
+
+void FluidEngine::captureOutputFrame() {
+    if (outputFrameCounter++ % outputStride != 0) return;
+
+    int slot;
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if (outputFree.empty()) {
+            outputDropped++;
+            return;
+        }
+        slot = outputFree.back();
+        outputFree.pop_back();
+    }
+
+    OutputFrame& frame = outputPool[slot];
+    frame.step = stepCount;
+    frame.frame = outputFrameCounter - 1;
+    const std::vector<float>* sources[OUTPUT_FIELD_KINDS] = { &ux, &uy, &rho, &dye, &temperature };
+    size_t cells = (size_t)w * h;
+    float* dst = frame.data.data();
+    for (int i = 0; i < OUTPUT_FIELD_KINDS; ++i) {
+        if (!(outputFieldMask & (1 << i))) continue;
+        const float* src = sources[i]->data();
+        parallel_for(0, h, [&](int startY, int endY) {
+            std::memcpy(dst + (size_t)startY * w, src + (size_t)startY * w, (size_t)(endY - startY) * w * sizeof(float));
+        });
+        dst += cells;
+    }
+
+    #ifdef FLUID_THREADS
+        {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            outputQueue.push(slot);
+        }
+        outputCv.notify_one();
+    #else
+        writeOutputFrame(frame, outputCodec, outputErrorBound);
+        outputFree.push_back(slot);
+    #endif
+}
+
+void FluidEngine::writeOutputFrame(const OutputFrame& frame, int codec, float errorBound) {
+    size_t cells = (size_t)w * h;
+    std::string sizes;
+    size_t bytes = 0;
+    if (codec == COMPRESS_NONE) {
+        bytes = frame.data.size() * sizeof(float);
+        if (std::fwrite(frame.data.data(), 1, bytes, outputFile) != bytes) {
+            outputDropped++;
+            return;
+        }
+    } else {
+        // Runs on the I/O thread, so the bands are coded serially rather than on the solver's pool.
+        for (int i = 0; i < outputFieldCount; ++i) {
+            encodeField(frame.data.data() + i * cells, w, h, codec, errorBound, outputCodecBuffer, false);
+            if (std::fwrite(outputCodecBuffer.data(), 1, outputCodecBuffer.size(), outputFile) != outputCodecBuffer.size()) {
+                outputDropped++;
+                return;
+            }
+            sizes += (i ? ", " : "") + std::to_string(outputCodecBuffer.size());
+            bytes += outputCodecBuffer.size();
+        }
+    }
+
+    char entry[128];
+    std::snprintf(entry, sizeof(entry), "%s    {\"frame\": %llu, \"step\": %llu, \"offset\": %llu",
+                  outputIndex.empty() ? "" : ",\n",
+                  (unsigned long long)frame.frame, (unsigned long long)frame.step,
+                  (unsigned long long)outputOffset);
+    outputIndex += entry;
+    if (codec != COMPRESS_NONE) outputIndex += ", \"codec\": " + std::to_string(codec) + ", \"sizes\": [" + sizes + "]";
+    outputIndex += "}";
+    outputOffset += bytes;
+
+    // Keep the index usable if the run is killed part way through.
+    if (++outputWritten % 64 == 0) {
+        std::fflush(outputFile);
+        writeOutputIndex();
+    }
+}
+
+void FluidEngine::writeOutputIndex() {
+    FILE* file = std::fopen((outputDirectory + "/index.json").c_str(), "w");
+    if (!file) return;
+    size_t cells = (size_t)w * h;
+    std::fprintf(file, "{\n  \"format\": \"%s\",\n", outputCodec == COMPRESS_NONE ? "raw" : "lbcz");
+    std::fprintf(file, "  \"errorBound\": %g,\n", outputCodec == COMPRESS_LOSSY ? outputErrorBound : 0.0f);
+    std::fprintf(file, "  \"dtype\": \"float32\",\n  \"endian\": \"little\",\n");
+    std::fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n  \"stride\": %d,\n", w, h, outputStride);
+    std::fprintf(file, "  \"frameBytes\": %llu,\n  \"fields\": [",
+                 (unsigned long long)(outputFieldCount * cells * sizeof(float)));
+    int n = 0;
+    for (int i = 0; i < OUTPUT_FIELD_KINDS; ++i) {
+        if (!(outputFieldMask & (1 << i))) continue;
+        std::fprintf(file, "%s{\"name\": \"%s\", \"offset\": %llu}", n ? ", " : "",
+                     OUTPUT_FIELD_NAMES[i], (unsigned long long)(n * cells * sizeof(float)));
+        n++;
+    }
+    std::fprintf(file, "],\n  \"dropped\": %u,\n  \"late\": %u,\n  \"frames\": [\n%s\n  ]\n}\n",
+                 outputDropped.load(), outputLate.load(), outputIndex.c_str());
+    std::fclose(file);
+}
+
+unsigned int FluidEngine::getOutputFramesWritten() {
+    return outputWritten;
+}
+
+unsigned int FluidEngine::getOutputFramesDropped() {
+    return outputDropped;
+}
+
+unsigned int FluidEngine::getOutputFramesLate() {
+    return outputLate;
+}
+
+void FluidEngine::startJournal() {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    journalActive = false;
+    std::vector<uint8_t> start;
+    writeCheckpoint(start);
+
+    JournalHeader header;
+    header.magic = JOURNAL_MAGIC;
+    header.version = JOURNAL_VERSION;
+    header.width = w;
+    header.height = h;
+    header.threadCount = threadCount;
+    header.checkpointSize = (uint32_t)start.size();
+    header.startStep = stepCount;
+
+    journal.clear();
+    const uint8_t* raw = (const uint8_t*)&header;
+    journal.insert(journal.end(), raw, raw + sizeof(header));
+    journal.insert(journal.end(), start.begin(), start.end());
+    journalStep = stepCount;
+    journalActive = true;
+}
+
+void FluidEngine::stopJournal() {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    journalActive = false;
+}
+
+#ifdef __EMSCRIPTEN__
+val FluidEngine::getJournalView() {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    return val(typed_memory_view(journal.size(), journal.data()));
+}
+#endif
+
+bool FluidEngine::saveJournalFile(const std::string& path) {
+    std::unique_lock<std::mutex> simulationLock = lockSimulation();
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(journal.data(), 1, journal.size(), file) == journal.size();
+    return (std::fclose(file) == 0) && ok;
+}
+
+bool FluidEngine::readJournalHeader(const uint8_t* data, size_t size, int& width, int& height, int& threads,
+                                    uint64_t& startStep) {
+    if (size < sizeof(JournalHeader)) return false;
+    JournalHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION) return false;
+    if (header.checkpointSize > size - sizeof(header)) return false;
+    width = header.width;
+    height = header.height;
+    threads = header.threadCount;
+    startStep = header.startStep;
+    return true;
+}
+
+bool FluidEngine::replayJournal(const uint8_t* data, size_t size, int threadOverride) {
+    int width, height, threads;
+    uint64_t startStep;
+    if (!readJournalHeader(data, size, width, height, threads, startStep)) return false;
+    if (width != w || height != h) return false;
+    journalActive = false;
+
+    JournalHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    setThreadCount(threadOverride > 0 ? threadOverride : threads);
+    if (!readCheckpoint(data + sizeof(header), header.checkpointSize)) return false;
+
+    JournalReader reader = { data + sizeof(header) + header.checkpointSize, data + size, true };
+    uint64_t expectedStep = stepCount;
+    while (reader.p < reader.end) {
+        uint8_t op;
+        reader.read(&op, 1);
+        expectedStep += reader.readVarint();
+        // A step mismatch means the replay has diverged from the recording.
+        if (!reader.ok || stepCount != expectedStep) return false;
+        if (!dispatchCommand(op, reader.p, reader.end, threadOverride)) return false;
+        if (op == OP_LOAD_CHECKPOINT) expectedStep = stepCount;
+    }
+    return true;
+}
+
+bool FluidEngine::dispatchCommand(int op, const uint8_t*& p, const uint8_t* end, int threadOverride) {
+    JournalReader reader = { p, end, true };
+    switch (op) {
+        case OP_LOAD_CHECKPOINT: {
+            unsigned int bytes = reader.readUnsigned();
+            if (!reader.ok || (size_t)(reader.end - reader.p) < bytes) return false;
+            const uint8_t* checkpoint = reader.p;
+            p = reader.p + bytes;
+            return readCheckpoint(checkpoint, bytes);
+        }
+        case OP_STEP: {
+            int iterations = reader.readInt();
+            if (!reader.ok) return false;
+            step(iterations);
+            break;
+        }
+        case OP_ADD_FORCE: {
+            int x = reader.readInt();
+            int y = reader.readInt();
+            float fx = reader.readFloat();
+            float fy = reader.readFloat();
+            if (!reader.ok) return false;
+            addForce(x, y, fx, fy);
+            break;
+        }
+        case OP_SET_VISCOSITY: {
+            float viscosity = reader.readFloat();
+            if (!reader.ok) return false;
+            setViscosity(viscosity);
+            break;
+        }
+        case OP_SET_DECAY: {
+            float newDecay = reader.readFloat();
+            if (!reader.ok) return false;
+            setDecay(newDecay);
+            break;
+        }
+        case OP_SET_GLOBAL_DRAG: {
+            float drag = reader.readFloat();
+            if (!reader.ok) return false;
+            setGlobalDrag(drag);
+            break;
+        }
+        case OP_SET_BOUNDARY_CONDITIONS: {
+            int left = reader.readInt();
+            int right = reader.readInt();
+            int top = reader.readInt();
+            int bottom = reader.readInt();
+            if (!reader.ok) return false;
+            setBoundaryConditions(left, right, top, bottom);
+            break;
+        }
+        case OP_SET_INFLOW_PROPERTIES: {
+            float vx = reader.readFloat();
+            float vy = reader.readFloat();
+            float rho = reader.readFloat();
+            if (!reader.ok) return false;
+            setInflowProperties(vx, vy, rho);
+            break;
+        }
+        case OP_SET_MOVING_WALL_VELOCITY: {
+            int side = reader.readInt();
+            float vx = reader.readFloat();
+            float vy = reader.readFloat();
+            if (!reader.ok) return false;
+            setMovingWallVelocity(side, vx, vy);
+            break;
+        }
+        case OP_SET_DT: {
+            float newDt = reader.readFloat();
+            if (!reader.ok) return false;
+            setDt(newDt);
+            break;
+        }
+        case OP_SET_GRAVITY: {
+            float gx = reader.readFloat();
+            float gy = reader.readFloat();
+            if (!reader.ok) return false;
+            setGravity(gx, gy);
+            break;
+        }
+        case OP_SET_THERMAL_PROPERTIES: {
+            float expansion = reader.readFloat();
+            float refTemp = reader.readFloat();
+            if (!reader.ok) return false;
+            setThermalProperties(expansion, refTemp);
+            break;
+        }
+        case OP_SET_THERMAL_DIFFUSIVITY: {
+            float td = reader.readFloat();
+            if (!reader.ok) return false;
+            setThermalDiffusivity(td);
+            break;
+        }
+        case OP_SET_VORTICITY_CONFINEMENT: {
+            float vc = reader.readFloat();
+            if (!reader.ok) return false;
+            setVorticityConfinement(vc);
+            break;
+        }
+        case OP_SET_MAX_VELOCITY: {
+            float mv = reader.readFloat();
+            if (!reader.ok) return false;
+            setMaxVelocity(mv);
+            break;
+        }
+        case OP_SET_SMAGORINSKY_CONSTANT: {
+            float c = reader.readFloat();
+            if (!reader.ok) return false;
+            setSmagorinskyConstant(c);
+            break;
+        }
+        case OP_SET_TEMPERATURE_VISCOSITY: {
+            float v = reader.readFloat();
+            if (!reader.ok) return false;
+            setTemperatureViscosity(v);
+            break;
+        }
+        case OP_SET_COLLISION_MODEL: {
+            int model = reader.readInt();
+            if (!reader.ok) return false;
+            setCollisionModel(model);
+            break;
+        }
+        case OP_SET_FLOW_BEHAVIOR_INDEX: {
+            float n = reader.readFloat();
+            if (!reader.ok) return false;
+            setFlowBehaviorIndex(n);
+            break;
+        }
+        case OP_SET_CONSISTENCY_INDEX: {
+            float k = reader.readFloat();
+            if (!reader.ok) return false;
+            setConsistencyIndex(k);
+            break;
+        }
+        case OP_SET_POROSITY_DRAG: {
+            float drag = reader.readFloat();
+            if (!reader.ok) return false;
+            setPorosityDrag(drag);
+            break;
+        }
+        case OP_SET_SPONGE_PROPERTIES: {
+            float strength = reader.readFloat();
+            int width = reader.readInt();
+            if (!reader.ok) return false;
+            setSpongeProperties(strength, width);
+            break;
+        }
+        case OP_SET_SPONGE_BOUNDARIES: {
+            bool left = reader.readBool();
+            bool right = reader.readBool();
+            bool top = reader.readBool();
+            bool bottom = reader.readBool();
+            if (!reader.ok) return false;
+            setSpongeBoundaries(left, right, top, bottom);
+            break;
+        }
+        case OP_SET_SURFACE_TENSION: {
+            float st = reader.readFloat();
+            if (!reader.ok) return false;
+            setSurfaceTension(st);
+            break;
+        }
+        case OP_SET_G_COHESION: {
+            float g = reader.readFloat();
+            if (!reader.ok) return false;
+            setGCohesion(g);
+            break;
+        }
+        case OP_SET_THREAD_COUNT: {
+            int count = reader.readInt();
+            if (!reader.ok) return false;
+            if (threadOverride <= 0) setThreadCount(count);
+            break;
+        }
+        case OP_SET_BFECC: {
+            bool enable = reader.readBool();
+            if (!reader.ok) return false;
+            setBFECC(enable);
+            break;
+        }
+        case OP_SET_RANDOM_SEED: {
+            unsigned int seed = reader.readUnsigned();
+            if (!reader.ok) return false;
+            setRandomSeed(seed);
+            break;
+        }
+        case OP_SET_INFLOW_TURBULENCE: {
+            float intensity = reader.readFloat();
+            float lengthScale = reader.readFloat();
+            if (!reader.ok) return false;
+            setInflowTurbulence(intensity, lengthScale);
+            break;
+        }
+        case OP_RESET: {
+            if (!reader.ok) return false;
+            reset();
+            break;
+        }
+        case OP_ADD_DENSITY: {
+            int x = reader.readInt();
+            int y = reader.readInt();
+            float amount = reader.readFloat();
+            if (!reader.ok) return false;
+            addDensity(x, y, amount);
+            break;
+        }
+        case OP_ADD_TEMPERATURE: {
+            int x = reader.readInt();
+            int y = reader.readInt();
+            float amount = reader.readFloat();
+            if (!reader.ok) return false;
+            addTemperature(x, y, amount);
+            break;
+        }
+        case OP_CLEAR_REGION: {
+            int x = reader.readInt();
+            int y = reader.readInt();
+            int radius = reader.readInt();
+            if (!reader.ok) return false;
+            clearRegion(x, y, radius);
+            break;
+        }
+        case OP_ADD_OBSTACLE: {
+            int x = reader.readInt();
+            int y = reader.readInt();
+            int radius = reader.readInt();
+            bool remove = reader.readBool();
+            float angle = reader.readFloat();
+            float aspectRatio = reader.readFloat();
+            int shape = reader.readInt();
+            if (!reader.ok) return false;
+            addObstacle(x, y, radius, remove, angle, aspectRatio, shape);
+            break;
+        }
+        case OP_APPLY_DIMENSIONAL_BRUSH: {
+            int x = reader.readInt();
+            int y = reader.readInt();
+            int radius = reader.readInt();
+            int mode = reader.readInt();
+            float strength = reader.readFloat();
+            float falloffParam = reader.readFloat();
+            float angle = reader.readFloat();
+            float aspectRatio = reader.readFloat();
+            int shape = reader.readInt();
+            int falloffMode = reader.readInt();
+            if (!reader.ok) return false;
+            applyDimensionalBrush(x, y, radius, mode, strength, falloffParam, angle, aspectRatio, shape, falloffMode);
+            break;
+        }
+        case OP_APPLY_GENERIC_BRUSH: {
+            int x = reader.readInt();
+            int y = reader.readInt();
+            int radius = reader.readInt();
+            float fx = reader.readFloat();
+            float fy = reader.readFloat();
+            float densityAmt = reader.readFloat();
+            float tempAmt = reader.readFloat();
+            float falloffParam = reader.readFloat();
+            float angle = reader.readFloat();
+            float aspectRatio = reader.readFloat();
+            int shape = reader.readInt();
+            int falloffMode = reader.readInt();
+            if (!reader.ok) return false;
+            applyGenericBrush(x, y, radius, fx, fy, densityAmt, tempAmt, falloffParam, angle, aspectRatio, shape, falloffMode);
+            break;
+        }
+        case OP_STEP_PHASES: {
+            int phases = reader.readInt();
+            if (!reader.ok) return false;
+            stepPhases(phases);
+            break;
+        }
+        case OP_SET_OBSTACLE_ID: {
+            int id = reader.readInt();
+            if (!reader.ok) return false;
+            setObstacleId(id);
+            break;
+        }
+        case OP_LABEL_OBSTACLES: {
+            labelObstacles();
+            break;
+        }
+        case OP_SET_ROW_OFFSET: {
+            int offset = reader.readInt();
+            int period = reader.readInt();
+            if (!reader.ok) return false;
+            setRowOffset(offset, period);
+            break;
+        }
+        case OP_APPLY_POROSITY_BRUSH: {
+            int x = reader.readInt();
+            int y = reader.readInt();
+            int radius = reader.readInt();
+            float strength = reader.readFloat();
+            bool add = reader.readBool();
+            float falloffParam = reader.readFloat();
+            float angle = reader.readFloat();
+            float aspectRatio = reader.readFloat();
+            int shape = reader.readInt();
+            int falloffMode = reader.readInt();
+            if (!reader.ok) return false;
+            applyPorosityBrush(x, y, radius, strength, add, falloffParam, angle, aspectRatio, shape, falloffMode);
+            break;
+        }
+        default:
+            return false;
+    }
+    p = reader.p;
+    return true;
+}
+
+// Async mode: a dedicated thread drains queued calls, steps and publishes a snapshot each tick.
+// Snapshots are triple buffered: the simulation thread fills the back slot and swaps it with the
+// shared slot, the front end swaps the shared slot into front, so front views stay valid meanwhile.
+namespace {
+const int SNAPSHOT_FRESH = 4;
+const int SNAPSHOT_SOURCE_FIELD[SNAPSHOT_COUNT] = {
+    FIELD_VELOCITY, FIELD_VELOCITY, FIELD_DENSITY, FIELD_DYE, FIELD_TEMPERATURE, FIELD_POROSITY, FIELD_BARRIERS
+};
+}
+
+std::unique_lock<std::mutex> FluidEngine::lockSimulation() {
+    if (asyncActive && std::this_thread::get_id() != asyncThreadId) {
+        return std::unique_lock<std::mutex>(asyncTickMutex);
+    }
+    return std::unique_lock<std::mutex>();
+}
+
+bool FluidEngine::startAsync(float tickRate, int iterationsPerTick) {
+    #ifdef FLUID_THREADS
+        if (asyncActive) {
+            setAsyncRate(tickRate, iterationsPerTick);
+            return true;
+        }
+        setAsyncRate(tickRate, iterationsPerTick);
+        asyncStop = false;
+        commandsDropped = 0;
+
+        size_t cells = (size_t)w * h;
+        for (Snapshot& snap : snapshots) {
+            for (int i = 0; i < SNAPSHOT_BARRIERS; ++i) snap.fields[i].assign(cells, 0.0f);
+            snap.barriers.assign(cells, 0);
+            for (int i = 0; i < FIELD_COUNT; ++i) snap.version[i] = ~0u;
+            snap.step = 0;
+        }
+        snapshotBack = 0;
+        snapshotShared = 1;
+        snapshotFront = 2;
+        publishSnapshot();
+        acquireSnapshot();
+
+        // Hold the tick lock until asyncThreadId is set; the loop takes it before touching any state.
+        std::lock_guard<std::mutex> lock(asyncTickMutex);
+        asyncActive = true;
+        asyncThread = std::thread([this] {
+            while (true) {
+                auto tickStart = std::chrono::steady_clock::now();
+                int iterations;
+                {
+                    std::lock_guard<std::mutex> tickLock(asyncTickMutex);
+                    if (asyncStop) return;
+                    drainCommands();
+                    iterations = asyncIterations;
+                    if (iterations > 0 && frameBudgetMs > 0.0f) iterations = budgetIterations;
+                    auto stepStart = std::chrono::steady_clock::now();
+                    // Stop at the first iteration boundary with commands waiting so they land as
+                    // soon as possible; each chunk is journaled with the count it actually ran.
+                    int remaining = iterations;
+                    while (remaining > 0) {
+                        uint64_t chunkStart = stepCount;
+                        int done = advance(remaining, true);
+                        if (journalActive) record(chunkStart, OP_STEP, done);
+                        remaining -= done;
+                        drainCommands();
+                    }
+                    if (iterations > 0 && frameBudgetMs > 0.0f) {
+                        auto stepEnd = std::chrono::steady_clock::now();
+                        updateFrameBudget(iterations, std::chrono::duration<float, std::milli>(stepEnd - stepStart).count());
                     }
+                    publishSnapshot();
+                }
+                auto tickEnd = std::chrono::steady_clock::now();
+                asyncTickMs = std::chrono::duration<float, std::milli>(tickEnd - tickStart).count();
+
+                // A tick that overruns its period starts the next one immediately; the front end
+                // keeps drawing the latest published snapshot either way.
+                float rate = asyncTickRate;
+                if (rate > 0.0f) {
+                    std::this_thread::sleep_until(tickStart + std::chrono::microseconds((int64_t)(1e6f / rate)));
+                } else if (iterations <= 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(4));
+                }
+            }
+        });
+        asyncThreadId = asyncThread.get_id();
+        return true;
+    #else
+        (void)tickRate;
+        (void)iterationsPerTick;
+        return false;
+    #endif
+}
+
+void FluidEngine::stopAsync() {
+    if (!asyncActive) return;
+    {
+        std::lock_guard<std::mutex> lock(asyncTickMutex);
+        asyncStop = true;
+    }
+    if (asyncThread.joinable()) asyncThread.join();
+    asyncActive = false;
+    drainCommands();
+    for (Snapshot& snap : snapshots) {
+        for (int i = 0; i < SNAPSHOT_BARRIERS; ++i) std::vector<float>().swap(snap.fields[i]);
+        std::vector<unsigned char>().swap(snap.barriers);
+    }
+}
+
+void FluidEngine::setAsyncRate(float tickRate, int iterationsPerTick) {
+    asyncTickRate = tickRate;
+    asyncIterations = std::max(0, iterationsPerTick);
+}
+
+float FluidEngine::getAsyncTickMs() {
+    return asyncTickMs;
+}
+
+// Frame budget: iterations per frame follow targetMs / (smoothed cost of one iteration), so
+// simulated time per wall second stays as high as the budget allows. Growth is capped per frame
+// to ride out one-off spikes; shrinking is immediate so a slow machine recovers at once.
+void FluidEngine::setFrameBudget(float targetMs, int minIterations, int maxIterations) {
+    budgetMinIterations = std::max(1, minIterations);
+    budgetMaxIterations = std::max((int)budgetMinIterations, maxIterations);
+    budgetIterations = std::max((int)budgetMinIterations, std::min((int)budgetMaxIterations, (int)budgetIterations));
+    frameBudgetMs = std::max(0.0f, targetMs);
+}
+
+int FluidEngine::stepFrame() {
+    int iterations = budgetIterations;
+    auto start = std::chrono::steady_clock::now();
+    step(iterations);
+    auto end = std::chrono::steady_clock::now();
+    if (frameBudgetMs > 0.0f) updateFrameBudget(iterations, std::chrono::duration<float, std::milli>(end - start).count());
+    return iterations;
+}
+
+int FluidEngine::getFrameBudgetIterations() {
+    return budgetIterations;
+}
+
+float FluidEngine::getIterationCostMs() {
+    return iterationCostMs;
+}
+
+void FluidEngine::updateFrameBudget(int iterations, float elapsedMs) {
+    if (iterations <= 0) return;
+    float sample = elapsedMs / iterations;
+    float cost = iterationCostMs;
+    cost = (cost > 0.0f) ? cost * 0.8f + sample * 0.2f : sample;
+    iterationCostMs = cost;
+
+    int current = budgetIterations;
+    int target = (int)(frameBudgetMs / std::max(cost, 1e-4f));
+    if (target > current) target = std::min(target, current + std::max(1, current / 2));
+    budgetIterations = std::max((int)budgetMinIterations, std::min((int)budgetMaxIterations, target));
+}
+
+// Bits for the features that change the per-cell cost of a step; calibration results are only
+// reused for the same grid and the same bits.
+unsigned int FluidEngine::featureMask() const {
+    unsigned int mask = 0;
+    if (dyeActive) mask |= 1u << 0;
+    if (temperatureActive) mask |= 1u << 1;
+    if (useBFECC) mask |= 1u << 2;
+    if (smagorinskyConstant > 0.0f) mask |= 1u << 3;
+    if (temperatureViscosity > 0.0f) mask |= 1u << 4;
+    if (consistencyIndex > 0.0f) mask |= 1u << 5;
+    if (surfaceTension > 0.0f && gCohesion > 0.0f) mask |= 1u << 6;
+    if (vorticityConfinement > 0.0f) mask |= 1u << 7;
+    if (spongeStrength > 0.0f && spongeWidth > 0) mask |= 1u << 8;
+    if (thermalExpansion != 0.0f) mask |= 1u << 9;
+    if (collisionModel != COLLISION_BGK) mask |= 1u << 10;
+    return mask;
+}
+
+namespace {
+struct Calibration {
+    int width;
+    int height;
+    unsigned int features;
+    int threads;
+    float costMs;
+};
+std::mutex calibrationMutex;
+std::vector<Calibration> calibrationCache;
+}
+
+// Times a few iterations at each candidate thread count on a scratch engine loaded from the current
+// state, and keeps the fastest (fewer threads win within 5%). The live engine never steps, so its
+// statistics, probes, force and diagnostics histories and obstacle IDs are untouched; the chosen
+// thread count is applied like any other setter.
+int FluidEngine::calibrate(int maxThreads, int trialIterations) {
+    if (asyncActive) return threadCount;
+    if (maxThreads <= 0) maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    trialIterations = std::max(1, trialIterations);
+    unsigned int features = featureMask();
+    {
+        std::lock_guard<std::mutex> lock(calibrationMutex);
+        for (const Calibration& c : calibrationCache) {
+            if (c.width == w && c.height == h && c.features == features && c.threads <= maxThreads) {
+                iterationCostMs = c.costMs;
+                setThreadCount(c.threads);
+                return c.threads;
+            }
+        }
+    }
+
+    std::vector<uint8_t> saved;
+    writeCheckpoint(saved);
+    FluidEngine trial(w, h);
+    if (!trial.readCheckpoint(saved.data(), saved.size())) return threadCount;
+    trial.setNumaPlacement(numaPlacement);
+
+    const int candidates[] = { 1, 2, 3, 4, 6, 8, 12, 16, 24, 32 };
+    int best = 1;
+    float bestCost = 0.0f;
+    int worse = 0;
+    for (int t : candidates) {
+        if (t > maxThreads) break;
+        trial.setThreadCount(t);
+        trial.advance(1, false);
+        auto start = std::chrono::steady_clock::now();
+        trial.advance(trialIterations, false);
+        auto end = std::chrono::steady_clock::now();
+        float cost = std::chrono::duration<float, std::milli>(end - start).count() / trialIterations;
+        if (bestCost == 0.0f || cost < bestCost * 0.95f) {
+            best = t;
+            bestCost = cost;
+            worse = 0;
+        } else if (++worse == 2) {
+            break;
+        }
+    }
+
+    iterationCostMs = bestCost;
+    setThreadCount(best);
+
+    std::lock_guard<std::mutex> lock(calibrationMutex);
+    calibrationCache.push_back({ w, h, features, best, bestCost });
+    return best;
+}
+
+// Setters only overwrite their own parameters, so within a run of setters uninterrupted by any
+// other command only the last update per parameter needs applying. Brushes, resets and loads
+// break the run, since they may read what came before them.
+void FluidEngine::drainCommands() {
+    uint32_t tail = commandTail.load(std::memory_order_relaxed);
+    uint32_t head = commandHead.load(std::memory_order_acquire);
+    bool overflow = commandOverflowPending.load(std::memory_order_acquire);
+    if (tail == head && !overflow) return;
+    commandBatch.clear();
+    for (uint32_t i = tail; i != head; ++i) commandBatch.push_back(commandRing[i & (COMMAND_RING_SIZE - 1)]);
+    commandTail.store(head, std::memory_order_release);
+    if (overflow) {
+        // The producer stops using the ring once the overflow list is pending, so whatever is left
+        // in the ring predates the list.
+        std::lock_guard<std::mutex> lock(commandOverflowMutex);
+        tail = head;
+        head = commandHead.load(std::memory_order_acquire);
+        for (uint32_t i = tail; i != head; ++i) commandBatch.push_back(commandRing[i & (COMMAND_RING_SIZE - 1)]);
+        commandTail.store(head, std::memory_order_release);
+        commandBatch.insert(commandBatch.end(), commandOverflow.begin(), commandOverflow.end());
+        commandOverflow.clear();
+        commandOverflowPending.store(false, std::memory_order_release);
+    }
+
+    int n = (int)commandBatch.size();
+    std::vector<char> skip(n, 0);
+    bool seen[OP_COUNT + 4] = {};
+    for (int i = n - 1; i >= 0; --i) {
+        int key = setterKey(commandBatch[i].op, commandBatch[i].args);
+        if (key < 0) {
+            std::fill(seen, seen + OP_COUNT + 4, false);
+            continue;
+        }
+        if (seen[key]) skip[i] = 1;
+        seen[key] = true;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        QueuedCommand& cmd = commandBatch[i];
+        if (cmd.op == OP_LOAD_CHECKPOINT) {
+            // Validated before it was queued.
+            readCheckpoint(cmd.checkpoint->data(), cmd.checkpoint->size());
+            delete cmd.checkpoint;
+            continue;
+        }
+        if (skip[i]) continue;
+        const uint8_t* p = cmd.args;
+        dispatchCommand(cmd.op, p, cmd.args + cmd.size, 0);
+    }
+}
+
+void FluidEngine::publishSnapshot() {
+    Snapshot& snap = snapshots[snapshotBack];
+    unsigned int current[FIELD_COUNT];
+    for (int i = 0; i < FIELD_COUNT; ++i) current[i] = fieldVersion[i];
+
+    const std::vector<float>* sources[SNAPSHOT_BARRIERS] = { &ux, &uy, &rho, &dye, &temperature, &porosity };
+    for (int i = 0; i < SNAPSHOT_BARRIERS; ++i) {
+        if (snap.version[SNAPSHOT_SOURCE_FIELD[i]] == current[SNAPSHOT_SOURCE_FIELD[i]]) continue;
+        const float* src = sources[i]->data();
+        float* dst = snap.fields[i].data();
+        parallel_for(0, h, [&](int startY, int endY) {
+            std::memcpy(dst + (size_t)startY * w, src + (size_t)startY * w, (size_t)(endY - startY) * w * sizeof(float));
+        });
+    }
+    if (snap.version[FIELD_BARRIERS] != current[FIELD_BARRIERS]) {
+        std::memcpy(snap.barriers.data(), barriers.data(), barriers.size());
+    }
+    for (int i = 0; i < FIELD_COUNT; ++i) snap.version[i] = current[i];
+    snap.step = stepCount;
+    std::memcpy(snap.diagnostics, diagnosticsLatest.data(), sizeof(snap.diagnostics));
+    std::memcpy(snap.forces, forceLatest.data(), sizeof(snap.forces));
+    snapshotBack = snapshotShared.exchange(snapshotBack | SNAPSHOT_FRESH) & 3;
+}
+
+bool FluidEngine::acquireSnapshot() {
+    if (!(snapshotShared.load() & SNAPSHOT_FRESH)) return false;
+    snapshotFront = snapshotShared.exchange(snapshotFront) & 3;
+    return true;
+}
+
+#ifdef __EMSCRIPTEN__
+val FluidEngine::getSnapshotView(int field) {
+    Snapshot& snap = snapshots[snapshotFront];
+    if (field == SNAPSHOT_BARRIERS) return val(typed_memory_view(snap.barriers.size(), snap.barriers.data()));
+    if (field < 0 || field >= SNAPSHOT_BARRIERS) return val::null();
+    return val(typed_memory_view(snap.fields[field].size(), snap.fields[field].data()));
+}
+#endif
+
+unsigned int FluidEngine::getSnapshotVersion(int field) {
+    if (field < 0 || field >= FIELD_COUNT) return 0;
+    return snapshots[snapshotFront].version[field];
+}
+
+void FluidEngine::clearRegion(int x, int y, int radius) {
+    if (intercept(OP_CLEAR_REGION, x, y, radius)) return;
+    for (int dy = -radius; dy <= radius; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+            if (dx * dx + dy * dy <= radius * radius) {
+                int nx = x + dx;
+                int ny = y + dy;
+                if (nx >= 0 && nx < w && ny >= 0 && ny < h) {
+                    int idx = ny * w + nx;
+                    barriers[idx] = 0; 
+                    obstacleIds[idx] = 0;
+                    rho[idx] = 1.0f;
+                    ux[idx] = 0.0f;
+                    uy[idx] = 0.0f;
+                    dye[idx] = 0.0f;
+                    temperature[idx] = 0.0f;
+
+                    float feq[9];
+                    equilibrium(1.0f, 0.0f, 0.0f, feq);
+                    for (int k = 0; k < 9; ++k) f[k][idx] = feq[k];
+                }
+            }
+        }
+    }
+    markFieldDirty(FIELD_BARRIERS, y - radius, y + radius + 1);
+    markDirtyRect(FIELD_BARRIERS, x - radius, y - radius, x + radius + 1, y + radius + 1);
+    markFieldDirty(FIELD_VELOCITY, y - radius, y + radius + 1);
+    markFieldDirty(FIELD_DENSITY, y - radius, y + radius + 1);
+    markFieldDirty(FIELD_DYE, y - radius, y + radius + 1);
+    markFieldDirty(FIELD_TEMPERATURE, y - radius, y + radius + 1);
+    barriersDirty.store(true);
+    dataVersion++;
+}
+
+void FluidEngine::step(int iterations) {
+    if (intercept(OP_STEP, iterations)) return;
+    advance(iterations, false);
+}
+
+int FluidEngine::advance(int iterations, bool yieldToCommands) {
+    int done = 0;
+    for(; done<iterations; ++done) {
+        if (yieldToCommands && done > 0 && commandsPending()) break;
+        diagnosticsDue = (done == iterations - 1);
+        while (!runPhase()) {}
+    }
+    diagnosticsDue = true;
+    finishStep(done > 0);
+    return done;
+}
+
+// One phase of the iteration sequence, resuming wherever the last call stopped. Between phases
+// all state lives in the fields a checkpoint stores, so a partial iteration survives save/load.
+bool FluidEngine::runPhase() {
+    switch (stepPhase) {
+        case PHASE_MACRO_BOUNDARIES: applyMacroscopicBoundaries(); break;
+        case PHASE_SURFACE_TENSION: applySurfaceTension(); break;
+        case PHASE_COLLIDE_STREAM:
+            diagnosticsPass = diagnosticsEnabled && diagnosticsDue;
+            if (diagnosticsPass) {
+                diagnosticsBands.assign(h, DiagnosticsPartial());
+                diagnosticsBandEnd.assign(h, 0);
+            }
+            collideAndStream();
+            break;
+        case PHASE_POST_STREAM: applyPostStreamBoundaries(); break;
+        case PHASE_DYE: if (dyeActive) advectDye(); break;
+        case PHASE_TEMPERATURE: if (temperatureActive) advectTemperature(); break;
+    }
+    if (++stepPhase < PHASE_COUNT) return false;
+    stepPhase = 0;
+    stepCount++;
+    if (diagnosticsPass) {
+        publishDiagnostics();
+        diagnosticsPass = false;
+    }
+    return true;
+}
+
+void FluidEngine::setDiagnostics(bool enabled, int historyLength) {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    diagnosticsEnabled = enabled;
+    diagnosticsHistory.assign((size_t)std::max(1, historyLength) * DIAG_COUNT, 0.0);
+    diagnosticsCount = 0;
+}
+
+// Bands of one parallel_for start on distinct rows, so each writes only its own slot. Empty
+// bands (more workers than rows) contribute nothing and are skipped.
+void FluidEngine::mergeDiagnostics(int startY, const DiagnosticsPartial& band) {
+    DiagnosticsPartial& slot = diagnosticsBands[startY];
+    slot.mass += band.mass;
+    slot.kinetic += band.kinetic;
+    slot.enstrophy += band.enstrophy;
+    slot.dye += band.dye;
+    slot.heat += band.heat;
+    slot.maxSpeedSq = std::max(slot.maxSpeedSq, band.maxSpeedSq);
+    slot.clampedCells += band.clampedCells;
+    slot.fluidCells += band.fluidCells;
+}
+
+// 0.5 * omega^2 over the fluid cells of row y, with omega = curl / 2 and curl the undivided
+// central difference, as the vorticity-confinement pass computes it.
+double FluidEngine::enstrophyRow(int y) const {
+    double sum = 0.0;
+    if (y < 1 || y >= h - 1) return sum;
+    for (int x = 1; x < w - 1; ++x) {
+        int idx = y * w + x;
+        if (barriers[idx]) continue;
+        float c = uy[idx + 1] - uy[idx - 1] - (ux[idx + w] - ux[idx - w]);
+        sum += 0.125 * c * c;
+    }
+    return sum;
+}
+
+// Kinetic energy is 0.5 * rho * |u|^2 summed over fluid cells. The band partials are reduced in
+// row order, so a run gives the same totals for a given thread count however the workers finish.
+void FluidEngine::publishDiagnostics() {
+    DiagnosticsPartial sum;
+    for (int y = 0; y < h; ++y) {
+        const DiagnosticsPartial& band = diagnosticsBands[y];
+        sum.mass += band.mass;
+        sum.kinetic += band.kinetic;
+        sum.enstrophy += band.enstrophy;
+        sum.dye += band.dye;
+        sum.heat += band.heat;
+        sum.maxSpeedSq = std::max(sum.maxSpeedSq, band.maxSpeedSq);
+        sum.clampedCells += band.clampedCells;
+        sum.fluidCells += band.fluidCells;
+    }
+    double* out = diagnosticsLatest.data();
+    out[DIAG_STEP] = (double)stepCount;
+    out[DIAG_MASS] = sum.mass;
+    out[DIAG_KINETIC_ENERGY] = 0.5 * sum.kinetic;
+    out[DIAG_ENSTROPHY] = sum.enstrophy;
+    out[DIAG_MAX_SPEED_RATIO] = maxVelocity > 0.0f ? std::sqrt((double)sum.maxSpeedSq) / maxVelocity : 0.0;
+    out[DIAG_CLAMPED_FRACTION] = sum.fluidCells ? (double)sum.clampedCells / sum.fluidCells : 0.0;
+    out[DIAG_DYE] = sum.dye;
+    out[DIAG_HEAT] = sum.heat;
+
+    size_t length = diagnosticsHistory.size() / DIAG_COUNT;
+    if (length > 0) {
+        std::memcpy(&diagnosticsHistory[(diagnosticsCount % length) * DIAG_COUNT], out, DIAG_COUNT * sizeof(double));
+    }
+    diagnosticsCount++;
+}
+
+#ifdef __EMSCRIPTEN__
+// In async mode the latest record travels with the snapshot; the history ring is only stable
+// to read while the engine is stepped from the caller's thread.
+val FluidEngine::getDiagnosticsView() {
+    if (asyncActive) return val(typed_memory_view(DIAG_COUNT, snapshots[snapshotFront].diagnostics));
+    return val(typed_memory_view(diagnosticsLatest.size(), diagnosticsLatest.data()));
+}
+
+val FluidEngine::getDiagnosticsHistoryView() {
+    return val(typed_memory_view(diagnosticsHistory.size(), diagnosticsHistory.data()));
+}
+#endif
+
+unsigned int FluidEngine::getDiagnosticsCount() {
+    return diagnosticsCount;
+}
+
+// Obstacle IDs only route forces; they never change the flow. Cells painted by addObstacle take
+// the current brush ID, and labelObstacles() renumbers every 8-connected solid body from 1.
+void FluidEngine::setObstacleId(int id) {
+    if (intercept(OP_SET_OBSTACLE_ID, id)) return;
+    obstacleIdBrush = std::max(0, std::min(OBSTACLE_ID_COUNT - 1, id));
+}
+
+int FluidEngine::labelObstacles() {
+    if (intercept(OP_LABEL_OBSTACLES)) return 0;
+    return labelComponents();
+}
+
+int FluidEngine::labelComponents() {
+    std::fill(obstacleIds.begin(), obstacleIds.end(), 0);
+    std::vector<int> stack;
+    int next = 0;
+    for (int start = 0; start < w * h; ++start) {
+        if (!barriers[start] || obstacleIds[start]) continue;
+        unsigned char id = (unsigned char)std::min(next + 1, OBSTACLE_ID_COUNT - 1);
+        next = id;
+        obstacleIds[start] = id;
+        stack.push_back(start);
+        while (!stack.empty()) {
+            int idx = stack.back();
+            stack.pop_back();
+            int x = idx % w;
+            int y = idx / w;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int nx = x + dx;
+                    int ny = y + dy;
+                    if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+                    int n = ny * w + nx;
+                    if (!barriers[n] || obstacleIds[n]) continue;
+                    obstacleIds[n] = id;
+                    stack.push_back(n);
+                }
+            }
+        }
+    }
+    return next;
+}
 
-                    wasm_v128_store(&ux[idx], v_u_eq);
-                    wasm_v128_store(&uy[idx], v_v_eq);
+void FluidEngine::setForceTracking(bool enabled, int historyLength) {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    forceTracking = enabled;
+    forceHistory.assign((size_t)std::max(1, historyLength) * FORCE_RECORD_SIZE, 0.0);
+    std::fill(forceSum.begin(), forceSum.end(), 0.0);
+    forceIterations = 0;
+    forceCount = 0;
+}
 
-                    v128_t v_omega = wasm_f32x4_splat(omega);
-                    v128_t v_feq[9];
+// One record per step() call: [step, fx0, fy0, fx1, fy1, ...], the mean force per iteration on
+// each obstacle ID in lattice units. ID 0 collects solids that were never given an ID.
+void FluidEngine::publishForces() {
+    double* out = forceLatest.data();
+    out[0] = (double)stepCount;
+    for (int i = 0; i < 2 * OBSTACLE_ID_COUNT; ++i) out[1 + i] = forceSum[i] / forceIterations;
+    std::fill(forceSum.begin(), forceSum.end(), 0.0);
+    forceIterations = 0;
+
+    size_t length = forceHistory.size() / FORCE_RECORD_SIZE;
+    if (length > 0) {
+        std::memcpy(&forceHistory[(forceCount % length) * FORCE_RECORD_SIZE], out, FORCE_RECORD_SIZE * sizeof(double));
+    }
+    forceCount++;
+}
 
-                    v128_t v_u2 = wasm_f32x4_add(wasm_f32x4_mul(v_u_eq, v_u_eq), wasm_f32x4_mul(v_v_eq, v_v_eq));
-                    v128_t v_u2_term = wasm_f32x4_mul(v_one_point_five, v_u2);
+#ifdef __EMSCRIPTEN__
+val FluidEngine::getObstacleForcesView() {
+    if (asyncActive) return val(typed_memory_view(FORCE_RECORD_SIZE, snapshots[snapshotFront].forces));
+    return val(typed_memory_view(forceLatest.size(), forceLatest.data()));
+}
 
-                    for(int k=0; k<9; ++k) {
-                         v128_t v_eu = wasm_f32x4_add(wasm_f32x4_mul(v_cx[k], v_u_eq), wasm_f32x4_mul(v_cy[k], v_v_eq));
-                         v128_t v_t1 = wasm_f32x4_add(v_one, wasm_f32x4_mul(v_three, v_eu));
-                         v128_t v_t2 = wasm_f32x4_sub(wasm_f32x4_mul(v_four_point_five, wasm_f32x4_mul(v_eu, v_eu)), v_u2_term);
-                         v_feq[k] = wasm_f32x4_mul(v_weights[k], wasm_f32x4_mul(v_rho, wasm_f32x4_add(v_t1, v_t2)));
-                    }
+val FluidEngine::getForceHistoryView() {
+    return val(typed_memory_view(forceHistory.size(), forceHistory.data()));
+}
+#endif
 
-                    if (useTempVisc || useSmagorinsky) {
-                        v128_t v_tau = wasm_f32x4_div(v_one, v_omega);
-                        v128_t v_nu = wasm_f32x4_div(wasm_f32x4_sub(v_tau, v_half), v_three);
-                        
-                        if (useTempVisc) {
-                             v128_t v_T = wasm_v128_load(&temperature[idx]);
-                             v128_t v_tvisc = wasm_f32x4_splat(temperatureViscosity);
-                             v128_t v_factor = wasm_f32x4_div(v_one, wasm_f32x4_add(v_one, wasm_f32x4_mul(v_tvisc, v_T)));
-                             v_nu = wasm_f32x4_mul(v_nu, v_factor);
-                        }
+unsigned int FluidEngine::getForceCount() {
+    return forceCount;
+}
 
-                        if (useSmagorinsky) {
-                            v128_t v_Qxx = v_zero;
-                            v128_t v_Qxy = v_zero;
-                            v128_t v_Qyy = v_zero;
-                            
-                            for(int k=0; k<9; ++k) {
-                                v128_t v_fneq = wasm_f32x4_sub(v_f[k], v_feq[k]);
-                                v_Qxx = wasm_f32x4_add(v_Qxx, wasm_f32x4_mul(wasm_f32x4_mul(v_cx[k], v_cx[k]), v_fneq));
-                                v_Qxy = wasm_f32x4_add(v_Qxy, wasm_f32x4_mul(wasm_f32x4_mul(v_cx[k], v_cy[k]), v_fneq));
-                                v_Qyy = wasm_f32x4_add(v_Qyy, wasm_f32x4_mul(wasm_f32x4_mul(v_cy[k], v_cy[k]), v_fneq));
-                            }
-                            
-                            v128_t v_magS_sq = wasm_f32x4_add(wasm_f32x4_mul(v_Qxx, v_Qxx), 
-                                                wasm_f32x4_add(wasm_f32x4_mul(v_two, wasm_f32x4_mul(v_Qxy, v_Qxy)), 
-                                                               wasm_f32x4_mul(v_Qyy, v_Qyy)));
-                            v128_t v_magS = wasm_f32x4_sqrt(v_magS_sq);
-
-                            v128_t v_smag = wasm_f32x4_splat(smagorinskyConstant);
-                            v128_t v_eddy = wasm_f32x4_mul(wasm_f32x4_mul(v_smag, v_smag), v_magS);
-                            v_nu = wasm_f32x4_add(v_nu, v_eddy);
-                        }
-                        
-                        v128_t v_tau_eff = wasm_f32x4_add(wasm_f32x4_mul(v_three, v_nu), v_half);
-                        v_omega = wasm_f32x4_div(v_one, v_tau_eff);
-                        v_omega = wasm_f32x4_max(v_omega, wasm_f32x4_splat(0.05f));
-                        v_omega = wasm_f32x4_min(v_omega, wasm_f32x4_splat(1.95f));
-                    }
+// Probes sample every iteration right after collision, when rho/ux/uy are fresh. Registering
+// or clearing probes changes the record layout, so it empties the ring.
+int FluidEngine::addProbe(float x, float y) {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    float px = std::max(0.0f, std::min(x, (float)(w - 1)));
+    float py = std::max(0.0f, std::min(y, (float)(h - 1)));
+    int ix = std::min((int)px, std::max(0, w - 2));
+    int iy = std::min((int)py, std::max(0, h - 2));
+    float fx = (w > 1) ? px - ix : 0.0f;
+    float fy = (h > 1) ? py - iy : 0.0f;
+    Probe probe;
+    probe.idx = iy * w + ix;
+    probe.w00 = (1.0f - fx) * (1.0f - fy);
+    probe.w10 = fx * (1.0f - fy);
+    probe.w01 = (1.0f - fx) * fy;
+    probe.w11 = fx * fy;
+    probes.push_back(probe);
+    resetProbeRing();
+    return (int)probes.size() - 1;
+}
 
-                    v128_t v_one_minus_omega = wasm_f32x4_sub(v_one, v_omega);
-                    
-                    for (int k = 0; k < 9; ++k) {
-                        v128_t v_out = wasm_f32x4_add(wasm_f32x4_mul(v_f[k], v_one_minus_omega), 
-                                                      wasm_f32x4_mul(v_feq[k], v_omega));
-                        
-                        float out_vals[4];
-                        wasm_v128_store(out_vals, v_out);
-                        
-                        int dest_base = idx + cx[k] + cy[k] * w;
-                        
-                        int n_idx_0 = dest_base;
-                        if (!barriers[n_idx_0]) f_new[k][n_idx_0] = out_vals[0];
-                        else f_new[opp[k]][idx] = out_vals[0];
+int FluidEngine::addLineProbe(float x0, float y0, float x1, float y1, int count) {
+    count = std::max(1, count);
+    int first = (int)probes.size();
+    for (int i = 0; i < count; ++i) {
+        float t = (count > 1) ? (float)i / (count - 1) : 0.0f;
+        addProbe(x0 + (x1 - x0) * t, y0 + (y1 - y0) * t);
+    }
+    return first;
+}
 
-                        int n_idx_1 = dest_base + 1;
-                        if (!barriers[n_idx_1]) f_new[k][n_idx_1] = out_vals[1];
-                        else f_new[opp[k]][idx + 1] = out_vals[1];
+void FluidEngine::clearProbes() {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    probes.clear();
+    resetProbeRing();
+}
 
-                        int n_idx_2 = dest_base + 2;
-                        if (!barriers[n_idx_2]) f_new[k][n_idx_2] = out_vals[2];
-                        else f_new[opp[k]][idx + 2] = out_vals[2];
+void FluidEngine::setProbeCapacity(int records) {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    probeCapacity = std::max(1, records);
+    resetProbeRing();
+}
 
-                        int n_idx_3 = dest_base + 3;
-                        if (!barriers[n_idx_3]) f_new[k][n_idx_3] = out_vals[3];
-                        else f_new[opp[k]][idx + 3] = out_vals[3];
-                    }
-                    
-                    x += 3;
-                    continue;
-                }
+int FluidEngine::getProbeCount() {
+    return (int)probes.size();
+}
 
-                int idx = y * w + x;
-                if (barriers[idx]) {
-                    rho[idx] = 1.0f;
-                    ux[idx] = 0.0f;
-                    uy[idx] = 0.0f;
-                    for(int k=0; k<9; ++k) f_new[k][idx] = feq_rest[k];
-                    continue;
-                }
+void FluidEngine::resetProbeRing() {
+    probeRecordSize = 1 + (int)probes.size() * PROBE_CHANNEL_COUNT;
+    probeRing.assign(probes.empty() ? 0 : (size_t)probeCapacity * probeRecordSize, 0.0f);
+    probeHead = 0;
+    probeTail = 0;
+    probeDropped = 0;
+}
 
-                float r = 0.0f, u_val = 0.0f, v_val = 0.0f;
-                for (int k = 0; k < 9; ++k) {
-                    float f_val = f[k][idx];
-                    r += f_val;
-                    u_val += f_val * cx[k];
-                    v_val += f_val * cy[k];
-                }
-                if (r > 0) { u_val /= r; v_val /= r; }
-                rho[idx] = r;
+// Record layout: [step as uint32 bits][ux, uy, p, dye, T per probe]. The stepping thread is the
+// only producer and never waits: a full ring drops the record and counts it.
+void FluidEngine::sampleProbes() {
+    uint32_t head = probeHead.load(std::memory_order_relaxed);
+    if (head - probeTail.load(std::memory_order_acquire) >= (uint32_t)probeCapacity) {
+        probeDropped++;
+        return;
+    }
+    float* out = &probeRing[(size_t)(head % probeCapacity) * probeRecordSize];
+    uint32_t step = (uint32_t)(stepCount + 1);
+    std::memcpy(out, &step, 4);
+    out++;
+    for (const Probe& p : probes) {
+        int i00 = p.idx;
+        int i10 = std::min(i00 + 1, w * h - 1);
+        int i01 = std::min(i00 + w, w * h - 1);
+        int i11 = std::min(i01 + 1, w * h - 1);
+        auto sample = [&](const std::vector<float>& field) {
+            return p.w00 * field[i00] + p.w10 * field[i10] + p.w01 * field[i01] + p.w11 * field[i11];
+        };
+        out[PROBE_UX] = sample(ux);
+        out[PROBE_UY] = sample(uy);
+        out[PROBE_PRESSURE] = sample(rho) * (1.0f / 3.0f);
+        out[PROBE_DYE] = sample(dye);
+        out[PROBE_TEMPERATURE] = sample(temperature);
+        out += PROBE_CHANNEL_COUNT;
+    }
+    probeHead.store(head + 1, std::memory_order_release);
+}
 
-                float fx = gravityX + forceX[idx];
-                float fy = gravityY + forceY[idx];
-                
-                if (thermalExpansion != 0.0f) {
-                    fy += gravityY * thermalExpansion * (temperature[idx] - referenceTemperature);
-                }
+// Consumer side; call from one thread at a time. Copies every pending record into the drain
+// buffer in order and frees their slots.
+int FluidEngine::drainProbes() {
+    uint32_t tail = probeTail.load(std::memory_order_relaxed);
+    uint32_t head = probeHead.load(std::memory_order_acquire);
+    int count = (int)(head - tail);
+    probeDrain.resize((size_t)count * probeRecordSize);
+    for (int i = 0; i < count; ++i) {
+        std::memcpy(&probeDrain[(size_t)i * probeRecordSize],
+                    &probeRing[(size_t)((tail + i) % probeCapacity) * probeRecordSize],
+                    probeRecordSize * sizeof(float));
+    }
+    probeTail.store(head, std::memory_order_release);
+    return count;
+}
 
-                float u_eq = u_val + fx * dt;
-                float v_eq = v_val + fy * dt;
-                
-                float total_drag = globalDrag + porosityDrag * (1.0f - porosity[idx]);
-                if (total_drag > 0.0f) {
-                    float damp = 1.0f - total_drag;
-                    if (damp < 0.0f) damp = 0.0f;
-                    u_eq *= damp;
-                    v_eq *= damp;
+#ifdef __EMSCRIPTEN__
+val FluidEngine::getProbeDrainView() {
+    return val(typed_memory_view(probeDrain.size(), probeDrain.data()));
+}
+#endif
+
+unsigned int FluidEngine::getProbeDropped() {
+    return probeDropped;
+}
+
+// Running statistics sample every collision while active. Solid cells are skipped, so their
+// entries hold whatever they had when the cell became solid.
+void FluidEngine::startStatistics() {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    if (statMeanU.empty()) clearStatistics();
+    statisticsActive = true;
+}
+
+void FluidEngine::stopStatistics() {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    statisticsActive = false;
+}
+
+void FluidEngine::resetStatistics() {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    clearStatistics();
+}
+
+void FluidEngine::clearStatistics() {
+    size_t cells = (size_t)w * h;
+    std::vector<float>* accumulators[] = { &statMeanU, &statMeanV, &statM2U, &statM2V, &statCUV, &statMeanDye, &statMeanT };
+    for (std::vector<float>* acc : accumulators) acc->assign(cells, 0.0f);
+    statisticsSamples = 0;
+}
+
+unsigned int FluidEngine::getStatisticsSamples() {
+    return statisticsSamples;
+}
+
+#ifdef __EMSCRIPTEN__
+// Means are views of the live accumulators. Second moments are divided by the sample count into
+// a per-field buffer on each call, so a view stays valid until that field is requested again.
+val FluidEngine::getStatisticsView(int field) {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    if (statMeanU.empty()) return val::null();
+    switch (field) {
+        case STAT_MEAN_UX: return val(typed_memory_view(statMeanU.size(), statMeanU.data()));
+        case STAT_MEAN_UY: return val(typed_memory_view(statMeanV.size(), statMeanV.data()));
+        case STAT_MEAN_DYE: return val(typed_memory_view(statMeanDye.size(), statMeanDye.data()));
+        case STAT_MEAN_TEMPERATURE: return val(typed_memory_view(statMeanT.size(), statMeanT.data()));
+        case STAT_VAR_UX:
+        case STAT_VAR_UY:
+        case STAT_COV_UV: {
+            const std::vector<float>& src = (field == STAT_VAR_UX) ? statM2U : (field == STAT_VAR_UY) ? statM2V : statCUV;
+            std::vector<float>& dst = statMoments[field - STAT_VAR_UX];
+            dst.resize(src.size());
+            float inv = statisticsSamples ? 1.0f / (float)statisticsSamples : 0.0f;
+            parallel_for(0, h, [&](int startY, int endY) {
+                for (size_t i = (size_t)startY * w; i < (size_t)endY * w; ++i) dst[i] = src[i] * inv;
+            });
+            return val(typed_memory_view(dst.size(), dst.data()));
+        }
+    }
+    return val::null();
+}
+#endif
+
+// Energy spectrum. ux + i*uy is transformed as one complex field Z: for real u and v,
+// |U(k)|^2 + |V(k)|^2 = (|Z(k)|^2 + |Z(-k)|^2) / 2, and radial bins hold k and -k together, so
+// binning |Z|^2 gives E(k) for both components from a single 2D transform. Each 1D pass runs
+// four columns at a time as SIMD lanes; lengths that are not powers of two use Bluestein.
+const FluidEngine::FftPlan& FluidEngine::fftPlan(int n) {
+    for (const FftPlan& plan : fftPlans) {
+        if (plan.n == n) return plan;
+    }
+    FftPlan plan;
+    plan.n = n;
+    bool pow2 = (n & (n - 1)) == 0;
+    plan.m = 1;
+    while (plan.m < (pow2 ? n : 2 * n - 1)) plan.m <<= 1;
+    int m = plan.m;
+    int bits = 0;
+    while ((1 << bits) < m) ++bits;
+    plan.bitrev.resize(m);
+    for (int i = 0; i < m; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+        plan.bitrev[i] = r;
+    }
+    plan.cosTable.resize(std::max(1, m / 2));
+    plan.sinTable.resize(std::max(1, m / 2));
+    for (int t = 0; t < m / 2; ++t) {
+        double angle = 2.0 * 3.14159265358979323846 * t / m;
+        plan.cosTable[t] = (float)std::cos(angle);
+        plan.sinTable[t] = (float)std::sin(angle);
+    }
+    if (!pow2) {
+        // Chirp w_j = exp(-i pi j^2 / n); j^2 is reduced mod 2n so large j keep their precision.
+        plan.chirpRe.resize(n);
+        plan.chirpIm.resize(n);
+        for (int j = 0; j < n; ++j) {
+            double angle = 3.14159265358979323846 * (double)(((long long)j * j) % (2LL * n)) / n;
+            plan.chirpRe[j] = (float)std::cos(angle);
+            plan.chirpIm[j] = (float)-std::sin(angle);
+        }
+        std::vector<float> kr((size_t)m * 4, 0.0f), ki((size_t)m * 4, 0.0f);
+        for (int j = 0; j < n; ++j) {
+            for (int l = 0; l < 4; ++l) {
+                kr[(size_t)j * 4 + l] = plan.chirpRe[j];
+                ki[(size_t)j * 4 + l] = -plan.chirpIm[j];
+                if (j > 0) {
+                    kr[(size_t)(m - j) * 4 + l] = plan.chirpRe[j];
+                    ki[(size_t)(m - j) * 4 + l] = -plan.chirpIm[j];
                 }
+            }
+        }
+        fftLanes(kr.data(), ki.data(), plan);
+        plan.kernelRe.resize(m);
+        plan.kernelIm.resize(m);
+        for (int k = 0; k < m; ++k) {
+            plan.kernelRe[k] = kr[(size_t)k * 4];
+            plan.kernelIm[k] = ki[(size_t)k * 4];
+        }
+    }
+    fftPlans.push_back(plan);
+    return fftPlans.back();
+}
 
-                if (spongeWidth > 0 && spongeStrength > 0.0f) {
-                    float damping = 0.0f;
-                    float dist = -1.0f;
-                    
-                    if(spongeLeft && x < spongeWidth) dist = x;
-                    else if(spongeRight && x >= w - spongeWidth) dist = w - 1 - x;
-                    else if(spongeBottom && y < spongeWidth) dist = y;
-                    else if(spongeTop && y >= h - spongeWidth) dist = h - 1 - y;
-
-                    if (dist >= 0.0f) {
-                        float ramp = 1.0f - dist / (float)spongeWidth;
-                        damping = spongeStrength * ramp * ramp;
-                    }
-                    
-                    if (damping > 0.0f) {
-                        if (damping > 1.0f) damping = 1.0f;
-                        u_eq *= (1.0f - damping);
-                        v_eq *= (1.0f - damping);
-                    }
+// In-place forward radix-2 transform of length plan.m; element j of each array is four lanes
+// at [4j, 4j + 4). Passing (im, re) instead computes the unscaled inverse.
+void FluidEngine::fftLanes(float* re, float* im, const FftPlan& plan) {
+    int m = plan.m;
+    for (int i = 0; i < m; ++i) {
+        int j = plan.bitrev[i];
+        if (i < j) {
+            simd::Vec<4> t = simd::load<4>(re + 4 * i);
+            simd::store<4>(re + 4 * i, simd::load<4>(re + 4 * j));
+            simd::store<4>(re + 4 * j, t);
+            t = simd::load<4>(im + 4 * i);
+            simd::store<4>(im + 4 * i, simd::load<4>(im + 4 * j));
+            simd::store<4>(im + 4 * j, t);
+        }
+    }
+    for (int len = 2; len <= m; len <<= 1) {
+        int half = len >> 1;
+        int stride = m / len;
+        for (int j = 0; j < half; ++j) {
+            simd::Vec<4> wr = simd::splat<4>(plan.cosTable[j * stride]);
+            simd::Vec<4> wi = simd::splat<4>(-plan.sinTable[j * stride]);
+            for (int i = j; i < m; i += len) {
+                float* ar = re + 4 * i;
+                float* ai = im + 4 * i;
+                float* br = re + 4 * (i + half);
+                float* bi = im + 4 * (i + half);
+                simd::Vec<4> xr = simd::load<4>(br);
+                simd::Vec<4> xi = simd::load<4>(bi);
+                simd::Vec<4> tr = simd::sub(simd::mul(xr, wr), simd::mul(xi, wi));
+                simd::Vec<4> ti = simd::add(simd::mul(xr, wi), simd::mul(xi, wr));
+                simd::Vec<4> yr = simd::load<4>(ar);
+                simd::Vec<4> yi = simd::load<4>(ai);
+                simd::store<4>(br, simd::sub(yr, tr));
+                simd::store<4>(bi, simd::sub(yi, ti));
+                simd::store<4>(ar, simd::add(yr, tr));
+                simd::store<4>(ai, simd::add(yi, ti));
+            }
+        }
+    }
+}
+
+// Transforms every column of a row-major width x height complex field along y.
+void FluidEngine::fftColumns(float* re, float* im, int width, int height) {
+    const FftPlan& plan = fftPlan(height);
+    int groups = (width + 3) / 4;
+    parallel_for(0, groups, [&](int startG, int endG) {
+        int m = plan.m;
+        std::vector<float> lr((size_t)m * 4), li((size_t)m * 4);
+        for (int g = startG; g < endG; ++g) {
+            int x0 = g * 4;
+            int lanes = std::min(4, width - x0);
+            std::fill(lr.begin(), lr.end(), 0.0f);
+            std::fill(li.begin(), li.end(), 0.0f);
+            for (int y = 0; y < height; ++y) {
+                for (int l = 0; l < lanes; ++l) {
+                    lr[(size_t)y * 4 + l] = re[(size_t)y * width + x0 + l];
+                    li[(size_t)y * 4 + l] = im[(size_t)y * width + x0 + l];
+                }
+            }
+            if (plan.m == plan.n) {
+                fftLanes(lr.data(), li.data(), plan);
+            } else {
+                for (int j = 0; j < height; ++j) {
+                    simd::Vec<4> cr = simd::splat<4>(plan.chirpRe[j]);
+                    simd::Vec<4> ci = simd::splat<4>(plan.chirpIm[j]);
+                    simd::Vec<4> xr = simd::load<4>(&lr[(size_t)j * 4]);
+                    simd::Vec<4> xi = simd::load<4>(&li[(size_t)j * 4]);
+                    simd::store<4>(&lr[(size_t)j * 4], simd::sub(simd::mul(xr, cr), simd::mul(xi, ci)));
+                    simd::store<4>(&li[(size_t)j * 4], simd::add(simd::mul(xr, ci), simd::mul(xi, cr)));
+                }
+                fftLanes(lr.data(), li.data(), plan);
+                for (int k = 0; k < m; ++k) {
+                    simd::Vec<4> kr = simd::splat<4>(plan.kernelRe[k]);
+                    simd::Vec<4> ki = simd::splat<4>(plan.kernelIm[k]);
+                    simd::Vec<4> xr = simd::load<4>(&lr[(size_t)k * 4]);
+                    simd::Vec<4> xi = simd::load<4>(&li[(size_t)k * 4]);
+                    simd::store<4>(&lr[(size_t)k * 4], simd::sub(simd::mul(xr, kr), simd::mul(xi, ki)));
+                    simd::store<4>(&li[(size_t)k * 4], simd::add(simd::mul(xr, ki), simd::mul(xi, kr)));
+                }
+                fftLanes(li.data(), lr.data(), plan);
+                simd::Vec<4> scale = simd::splat<4>(1.0f / m);
+                for (int k = 0; k < height; ++k) {
+                    simd::Vec<4> cr = simd::splat<4>(plan.chirpRe[k]);
+                    simd::Vec<4> ci = simd::splat<4>(plan.chirpIm[k]);
+                    simd::Vec<4> xr = simd::mul(simd::load<4>(&lr[(size_t)k * 4]), scale);
+                    simd::Vec<4> xi = simd::mul(simd::load<4>(&li[(size_t)k * 4]), scale);
+                    simd::store<4>(&lr[(size_t)k * 4], simd::sub(simd::mul(xr, cr), simd::mul(xi, ci)));
+                    simd::store<4>(&li[(size_t)k * 4], simd::add(simd::mul(xr, ci), simd::mul(xi, cr)));
+                }
+            }
+            for (int y = 0; y < height; ++y) {
+                for (int l = 0; l < lanes; ++l) {
+                    re[(size_t)y * width + x0 + l] = lr[(size_t)y * 4 + l];
+                    im[(size_t)y * width + x0 + l] = li[(size_t)y * 4 + l];
                 }
+            }
+        }
+    });
+}
 
-                limitVelocity(u_eq, v_eq);
-                ux[idx] = u_eq;
-                uy[idx] = v_eq;
+// window 0 suits periodic domains; 1 applies a separable Hann window for walled ones and
+// divides by its mean square so the total energy stays comparable. E(k) is binned on
+// k = |(kx / w, ky / h)| * max(w, h), so bin k has wavelength max(w, h) / k cells, and
+// sum E(k) = 0.5 * mean(u^2 + v^2) up to the bins past max(w, h) / 2 that are dropped.
+int FluidEngine::spectrumNow(int window) {
+    size_t cells = (size_t)w * h;
+    spectrumRe.resize(cells);
+    spectrumIm.resize(cells);
+    spectrumTRe.resize(cells);
+    spectrumTIm.resize(cells);
+    auto hann = [](int i, int n) {
+        return 0.5f - 0.5f * std::cos(2.0f * 3.14159265f * (i + 0.5f) / n);
+    };
+    parallel_for(0, h, [&](int startY, int endY) {
+        for (int y = startY; y < endY; ++y) {
+            float wy = window ? hann(y, h) : 1.0f;
+            for (int x = 0; x < w; ++x) {
+                int idx = y * w + x;
+                float wgt = window ? wy * hann(x, w) : 1.0f;
+                spectrumRe[idx] = barriers[idx] ? 0.0f : ux[idx] * wgt;
+                spectrumIm[idx] = barriers[idx] ? 0.0f : uy[idx] * wgt;
+            }
+        }
+    });
+    fftColumns(spectrumRe.data(), spectrumIm.data(), w, h);
+    parallel_for(0, w, [&](int startX, int endX) {
+        for (int x = startX; x < endX; ++x) {
+            for (int y = 0; y < h; ++y) {
+                spectrumTRe[(size_t)x * h + y] = spectrumRe[(size_t)y * w + x];
+                spectrumTIm[(size_t)x * h + y] = spectrumIm[(size_t)y * w + x];
+            }
+        }
+    });
+    fftColumns(spectrumTRe.data(), spectrumTIm.data(), h, w);
+
+    int length = std::max(w, h);
+    int bins = length / 2 + 1;
+    double norm = 0.5 / ((double)cells * (double)cells);
+    if (window) norm /= 0.375 * 0.375;
+    std::vector<double> total(bins, 0.0);
+    parallel_for(0, w, [&](int startX, int endX) {
+        std::vector<double> local(bins, 0.0);
+        for (int kx = startX; kx < endX; ++kx) {
+            float fx = (float)(kx <= w / 2 ? kx : kx - w) / w;
+            for (int ky = 0; ky < h; ++ky) {
+                float fy = (float)(ky <= h / 2 ? ky : ky - h) / h;
+                int bin = (int)(std::sqrt(fx * fx + fy * fy) * length + 0.5f);
+                if (bin >= bins) continue;
+                size_t i = (size_t)kx * h + ky;
+                local[bin] += (double)spectrumTRe[i] * spectrumTRe[i] + (double)spectrumTIm[i] * spectrumTIm[i];
+            }
+        }
+        std::lock_guard<std::mutex> lock(diagnosticsMutex);
+        for (int b = 0; b < bins; ++b) total[b] += local[b];
+    });
+    spectrum.resize(bins);
+    for (int b = 0; b < bins; ++b) spectrum[b] = (float)(total[b] * norm);
+    spectrumStep = stepCount;
+    return bins;
+}
 
-                float feq[9];
-                equilibrium(r, u_eq, v_eq, feq);
+int FluidEngine::computeSpectrum(int window) {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    return spectrumNow(window);
+}
 
-                float local_omega = omega;
-                if (useTempVisc || useSmagorinsky || useNonNewtonian) {
-                    float current_tau = 1.0f / omega;
-                    float nu = (current_tau - 0.5f) / 3.0f;
+void FluidEngine::setSpectrumInterval(int steps, int window) {
+    std::unique_lock<std::mutex> lock = lockSimulation();
+    spectrumInterval = std::max(0, steps);
+    spectrumWindow = window;
+    spectrumStep = stepCount;
+}
 
-                    if (useTempVisc) {
-                        float T = temperature[idx];
-                        nu = nu * (1.0f / (1.0f + temperatureViscosity * T));
-                    }
-                    
-                    float magS = 0.0f;
-                    if (useSmagorinsky || useNonNewtonian) {
-                        float Qxx = 0.0f, Qxy = 0.0f, Qyy = 0.0f;
-                        for(int k=0; k<9; ++k) {
-                            float f_neq = f[k][idx] - feq[k];
-                            Qxx += cx[k] * cx[k] * f_neq;
-                            Qxy += cx[k] * cy[k] * f_neq;
-                            Qyy += cy[k] * cy[k] * f_neq;
-                        }
-                        magS = std::sqrt(Qxx*Qxx + 2.0f*Qxy*Qxy + Qyy*Qyy);
-                    }
+#ifdef __EMSCRIPTEN__
+val FluidEngine::getSpectrumView() {
+    return val(typed_memory_view(spectrum.size(), spectrum.data()));
+}
+#endif
 
-                    if (useNonNewtonian) {
-                        float strainMag = magS * 1.5f * omega; 
-                        float viscosityFactor = 1.0f + k_idx_val * std::pow(strainMag, n_idx_val - 1.0f);
-                        nu *= viscosityFactor;
-                    }
+double FluidEngine::getSpectrumStep() {
+    return (double)spectrumStep;
+}
 
-                    if (useSmagorinsky) {
-                        float eddy_nu = (smagorinskyConstant * smagorinskyConstant) * magS;
-                        nu += eddy_nu;
-                    }
+void FluidEngine::finishStep(bool completed) {
+    markFieldDirty(FIELD_VELOCITY);
+    markFieldDirty(FIELD_DENSITY);
+    if (dyeActive) markFieldDirty(FIELD_DYE);
+    if (temperatureActive) markFieldDirty(FIELD_TEMPERATURE);
+    if (completed) {
+        if (forceTracking && forceIterations > 0) publishForces();
+        if (spectrumInterval > 0 && stepCount >= spectrumStep + (uint64_t)spectrumInterval) spectrumNow(spectrumWindow);
+        if (packedFormat != PACKED_OFF) writePackedOutput();
+        if (outputActive) captureOutputFrame();
+    }
+    dataVersion++;
+}
 
-                    float tau_eff = 3.0f * nu + 0.5f;
-                    local_omega = 1.0f / tau_eff;
-                    if(local_omega < 0.05f) local_omega = 0.05f;
-                    if(local_omega > 1.95f) local_omega = 1.95f;
-                }
+// Runs phases until the next one is predicted to overrun the budget (at least one always runs).
+// Phase costs are smoothed per phase, so a slow collision does not hide a cheap boundary pass.
+int FluidEngine::stepFor(int budgetUs) {
+    if (asyncActive && std::this_thread::get_id() != asyncThreadId) return 0;
+    uint64_t startStep = stepCount;
+    auto start = std::chrono::steady_clock::now();
+    int phases = 0;
+    int completed = 0;
+    while (true) {
+        float elapsed = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (phases > 0 && elapsed + phaseCostUs[stepPhase] > budgetUs) break;
+        int phase = stepPhase;
+        auto phaseStart = std::chrono::steady_clock::now();
+        if (runPhase()) completed++;
+        phases++;
+        float cost = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - phaseStart).count();
+        phaseCostUs[phase] = phaseCostUs[phase] > 0.0f ? phaseCostUs[phase] * 0.8f + cost * 0.2f : cost;
+    }
+    if (journalActive) record(startStep, OP_STEP_PHASES, phases);
+    finishStep(completed > 0);
+    return completed;
+}
 
-                for (int k = 0; k < 9; ++k) {
-                    float f_out = f[k][idx] * (1.0f - local_omega) + feq[k] * local_omega;
-                    int nx = x + cx[k];
-                    int ny = y + cy[k];
-
-                    if (nx >= 0 && nx < w && ny >= 0 && ny < h) {
-                        int n_idx = ny * w + nx;
-                        if (barriers[n_idx]) {
-                            f_new[opp[k]][idx] = f_out;
-                        } else {
-                            f_new[k][n_idx] = f_out;
-                        }
-                    } else {
-                        bool periodic_x = false;
-                        bool periodic_y = false;
-                        int final_nx = nx;
-                        int final_ny = ny;
-                        
-                        if (nx < 0 && boundaryLeft == 0) { periodic_x = true; final_nx = w - 1; }
-                        else if (nx >= w && boundaryRight == 0) { periodic_x = true; final_nx = 0; }
-                        
-                        if (ny < 0 && boundaryBottom == 0) { periodic_y = true; final_ny = h - 1; }
-                        else if (ny >= h && boundaryTop == 0) { periodic_y = true; final_ny = 0; }
+int FluidEngine::stepPhases(int phases) {
+    if (journalActive) record(stepCount, OP_STEP_PHASES, phases);
+    int completed = 0;
+    for (int i = 0; i < phases; ++i) {
+        if (runPhase()) completed++;
+    }
+    if (phases > 0) finishStep(completed > 0);
+    return completed;
+}
 
-                        if (periodic_x || periodic_y) {
-                            f_new[k][final_ny * w + final_nx] = f_out;
-                            continue;
-                        }
+int FluidEngine::getStepPhase() {
+    return stepPhase;
+}
 
-                        int dest_k = opp[k];
-                        float f_bounce = f_out;
-                        
-                        if (nx < 0)         (this->*leftHandler)(dest_k, f_bounce, k, idx);
-                        else if (nx >= w)   (this->*rightHandler)(dest_k, f_bounce, k, idx);
-                        else if (ny < 0)    (this->*bottomHandler)(dest_k, f_bounce, k, idx);
-                        else if (ny >= h)   (this->*topHandler)(dest_k, f_bounce, k, idx);
+void FluidEngine::exchangeMomentum(CollideBand& band, int n_idx, int k, float f_out) {
+    int id = obstacleIds[n_idx];
+    band.force[2 * id] += 2.0f * f_out * cx[k];
+    band.force[2 * id + 1] += 2.0f * f_out * cy[k];
+}
+
+// Per-cell collision and streaming for cells the vector kernels skip: lattice edges, cells next
+// to solids or inside sponges, and power-law fluids.
+void FluidEngine::collideCell(int x, int y, CollideBand& band) {
+    int idx = y * w + x;
+    if (barriers[idx]) {
+        rho[idx] = 1.0f;
+        ux[idx] = 0.0f;
+        uy[idx] = 0.0f;
+        for(int k=0; k<9; ++k) f_new[k][idx] = band.feqRest[k];
+        return;
+    }
 
-                        bool slip_corner = ( ( (nx < 0 && boundaryLeft == 2) || (nx >= w && boundaryRight == 2) ) &&
-                                             ( (ny < 0 && boundaryBottom == 2) || (ny >= h && boundaryTop == 2) ) );
-                        if (slip_corner) dest_k = opp[k];
+    float r = 0.0f, u_val = 0.0f, v_val = 0.0f;
+    for (int k = 0; k < 9; ++k) {
+        float f_val = f[k][idx];
+        r += f_val;
+        u_val += f_val * cx[k];
+        v_val += f_val * cy[k];
+    }
+    if (r > 0) { u_val /= r; v_val /= r; }
+    rho[idx] = r;
 
-                        f_new[dest_k][idx] = f_bounce;
-                    }
-                }
+    float fx = gravityX + forceX[idx];
+    float fy = gravityY + forceY[idx];
+    
+    if (thermalExpansion != 0.0f) {
+        fy += gravityY * thermalExpansion * (temperature[idx] - referenceTemperature);
+    }
+
+    float u_eq = u_val + fx * dt;
+    float v_eq = v_val + fy * dt;
+    
+    float total_drag = globalDrag + porosityDrag * (1.0f - porosity[idx]);
+    if (total_drag > 0.0f) {
+        float damp = 1.0f - total_drag;
+        if (damp < 0.0f) damp = 0.0f;
+        u_eq *= damp;
+        v_eq *= damp;
+    }
+
+    if (spongeWidth > 0 && spongeStrength > 0.0f) {
+        float damping = 0.0f;
+        float dist = -1.0f;
+        
+        if(spongeLeft && x < spongeWidth) dist = x;
+        else if(spongeRight && x >= w - spongeWidth) dist = w - 1 - x;
+        else if(spongeBottom && y < spongeWidth) dist = y;
+        else if(spongeTop && y >= h - spongeWidth) dist = h - 1 - y;
+
+        if (dist >= 0.0f) {
+            float ramp = 1.0f - dist / (float)spongeWidth;
+            damping = spongeStrength * ramp * ramp;
+        }
+        
+        if (damping > 0.0f) {
+            if (damping > 1.0f) damping = 1.0f;
+            u_eq *= (1.0f - damping);
+            v_eq *= (1.0f - damping);
+        }
+    }
+
+    if (band.diagnostics) {
+        float speedSq = u_eq * u_eq + v_eq * v_eq;
+        band.diag.maxSpeedSq = std::max(band.diag.maxSpeedSq, speedSq);
+        if (speedSq > maxVelocity * maxVelocity) band.diag.clampedCells++;
+    }
+    limitVelocity(u_eq, v_eq);
+    ux[idx] = u_eq;
+    uy[idx] = v_eq;
+    if (band.stats) {
+        float du = u_eq - statMeanU[idx];
+        float dv = v_eq - statMeanV[idx];
+        statMeanU[idx] += du * band.invSamples;
+        statMeanV[idx] += dv * band.invSamples;
+        float dv2 = v_eq - statMeanV[idx];
+        statM2U[idx] += du * (u_eq - statMeanU[idx]);
+        statM2V[idx] += dv * dv2;
+        statCUV[idx] += du * dv2;
+        statMeanDye[idx] += (dye[idx] - statMeanDye[idx]) * band.invSamples;
+        statMeanT[idx] += (temperature[idx] - statMeanT[idx]) * band.invSamples;
+    }
+    if (band.diagnostics) {
+        band.diag.mass += r;
+        band.diag.kinetic += r * (u_eq * u_eq + v_eq * v_eq);
+        if (dyeActive) band.diag.dye += dye[idx];
+        if (temperatureActive) band.diag.heat += temperature[idx];
+        band.diag.fluidCells++;
+    }
+
+    float feq[9];
+    equilibrium(r, u_eq, v_eq, feq);
+
+    float Qxx = 0.0f, Qxy = 0.0f, Qyy = 0.0f;
+    if (band.useSmagorinsky || band.useNonNewtonian || band.collision == COLLISION_REGULARIZED) {
+        for(int k=0; k<9; ++k) {
+            float f_neq = f[k][idx] - feq[k];
+            Qxx += cx[k] * cx[k] * f_neq;
+            Qxy += cx[k] * cy[k] * f_neq;
+            Qyy += cy[k] * cy[k] * f_neq;
+        }
+    }
+
+    float local_omega = omega;
+    if (band.useTempVisc || band.useSmagorinsky || band.useNonNewtonian) {
+        float current_tau = 1.0f / omega;
+        float nu = (current_tau - 0.5f) / 3.0f;
+
+        if (band.useTempVisc) {
+            float T = temperature[idx];
+            nu = nu * (1.0f / (1.0f + temperatureViscosity * T));
+        }
+        
+        float magS = 0.0f;
+        if (band.useSmagorinsky || band.useNonNewtonian) {
+            magS = std::sqrt(Qxx*Qxx + 2.0f*Qxy*Qxy + Qyy*Qyy);
+        }
+
+        if (band.useNonNewtonian) {
+            float strainMag = magS * 1.5f * omega; 
+            float viscosityFactor = 1.0f + consistencyIndex * std::pow(strainMag, flowBehaviorIndex - 1.0f);
+            nu *= viscosityFactor;
+        }
+
+        if (band.useSmagorinsky) {
+            float eddy_nu = (smagorinskyConstant * smagorinskyConstant) * magS;
+            nu += eddy_nu;
+        }
+
+        float tau_eff = 3.0f * nu + 0.5f;
+        local_omega = 1.0f / tau_eff;
+        if(local_omega < 0.05f) local_omega = 0.05f;
+        if(local_omega > 1.95f) local_omega = 1.95f;
+    }
+
+    // Recursive regularized BGK relaxes only the Hermite projection of the non-equilibrium part:
+    // first order from the velocity shift (r u_eq - j), second from Qxx, Qxy and Qyy, third built
+    // from those and u_eq. The higher moments that plain BGK lets grow as omega approaches 2 are
+    // dropped, while mass, momentum and stress come out as under BGK, so forces, drag and the
+    // velocity limit act as before.
+    float f_post[9];
+    if (band.collision == COLLISION_BGK) {
+        for (int k = 0; k < 9; ++k) f_post[k] = f[k][idx] * (1.0f - local_omega) + feq[k] * local_omega;
+    } else {
+        float dx = r * (u_eq - u_val);
+        float dy = r * (v_eq - v_val);
+        float Axxy = 2.0f * u_eq * Qxy + v_eq * Qxx;
+        float Axyy = 2.0f * v_eq * Qxy + u_eq * Qyy;
+        for (int k = 0; k < 9; ++k) {
+            float hxx = cx[k] * cx[k] - 1.0f / 3.0f;
+            float hyy = cy[k] * cy[k] - 1.0f / 3.0f;
+            float neq = -3.0f * (cx[k] * dx + cy[k] * dy) +
+                        4.5f * (hxx * Qxx + 2.0f * cx[k] * cy[k] * Qxy + hyy * Qyy) +
+                        13.5f * (cy[k] * hxx * Axxy + cx[k] * hyy * Axyy);
+            f_post[k] = feq[k] + (1.0f - local_omega) * weights[k] * neq;
+        }
+    }
+
+    for (int k = 0; k < 9; ++k) {
+        float f_out = f_post[k];
+        int nx = x + cx[k];
+        int ny = y + cy[k];
+
+        if (nx >= 0 && nx < w && ny >= 0 && ny < h) {
+            int n_idx = ny * w + nx;
+            if (barriers[n_idx]) {
+                f_new[opp[k]][idx] = f_out;
+                if (band.forces) exchangeMomentum(band, n_idx, k, f_out);
+            } else {
+                f_new[k][n_idx] = f_out;
+            }
+        } else {
+            bool periodic_x = false;
+            bool periodic_y = false;
+            int final_nx = nx;
+            int final_ny = ny;
+            
+            if (nx < 0 && boundaryLeft == 0) { periodic_x = true; final_nx = w - 1; }
+            else if (nx >= w && boundaryRight == 0) { periodic_x = true; final_nx = 0; }
+            
+            if (ny < 0 && boundaryBottom == 0) { periodic_y = true; final_ny = h - 1; }
+            else if (ny >= h && boundaryTop == 0) { periodic_y = true; final_ny = 0; }
+
+            // A corner link leaving through a periodic edge and a wall edge at once
+            // takes the wall treatment.
+            bool inside_x = periodic_x || (nx >= 0 && nx < w);
+            bool inside_y = periodic_y || (ny >= 0 && ny < h);
+            if (inside_x && inside_y) {
+                f_new[k][final_ny * w + final_nx] = f_out;
+                continue;
+            }
+
+            int dest_k = opp[k];
+            float f_bounce = f_out;
+            
+            if (nx < 0 && !periodic_x)         (this->*leftHandler)(dest_k, f_bounce, k, idx);
+            else if (nx >= w && !periodic_x)   (this->*rightHandler)(dest_k, f_bounce, k, idx);
+            else if (ny < 0)    (this->*bottomHandler)(dest_k, f_bounce, k, idx);
+            else if (ny >= h)   (this->*topHandler)(dest_k, f_bounce, k, idx);
+
+            bool slip_corner = ( ( (nx < 0 && boundaryLeft == 2) || (nx >= w && boundaryRight == 2) ) &&
+                                 ( (ny < 0 && boundaryBottom == 2) || (ny >= h && boundaryTop == 2) ) );
+            if (slip_corner) dest_k = opp[k];
+
+            f_new[dest_k][idx] = f_bounce;
+        }
+    }
+}
+
+void FluidEngine::collideAndStream() {
+    const bool stats = statisticsActive;
+    if (stats) statisticsSamples++;
+    const float invSamples = stats ? 1.0f / (float)statisticsSamples : 0.0f;
+    parallel_for(0, h, [&](int startY, int endY) {
+        CollideBand band;
+        equilibrium(1.0f, 0.0f, 0.0f, band.feqRest);
+        band.useSmagorinsky = (smagorinskyConstant > 0.0f);
+        band.useTempVisc = (temperatureViscosity > 0.0f);
+        band.useNonNewtonian = (consistencyIndex > 0.0f);
+        band.collision = collisionModel;
+        band.stats = stats;
+        band.invSamples = invSamples;
+
+        // Diagnostics ride along on the collision sweep: SIMD partials per row, doubles per band.
+        band.diagnostics = diagnosticsPass;
+
+        // Momentum exchange: a population bounced back off a solid link hands the obstacle 2 f c_k.
+        band.forces = forceTracking;
+        if (band.forces) std::fill(band.force, band.force + 2 * OBSTACLE_ID_COUNT, 0.0);
+
+        // Without vorticity confinement the enstrophy rides along too: row y - 1 has all three of
+        // its curl rows once row y is done. A band's first and last rows need the neighbouring
+        // bands' velocity and are summed after the sweep.
+        if (band.diagnostics && vorticityConfinement <= 0.0f) {
+            for (int y = startY; y < endY; ++y) {
+                (this->*collideKernel)(y, y + 1, band);
+                if (y - 1 > startY) band.diag.enstrophy += enstrophyRow(y - 1);
             }
+        } else {
+            (this->*collideKernel)(startY, endY, band);
+        }
+
+        if (band.diagnostics && startY < endY) {
+            mergeDiagnostics(startY, band.diag);
+            diagnosticsBandEnd[startY] = endY;
+        }
+        if (band.forces) {
+            std::lock_guard<std::mutex> lock(diagnosticsMutex);
+            for (int i = 0; i < 2 * OBSTACLE_ID_COUNT; ++i) forceSum[i] += band.force[i];
         }
     });
+    if (forceTracking) forceIterations++;
+    if (diagnosticsPass && vorticityConfinement <= 0.0f) {
+        for (int y = 0; y < h; ++y) {
+            int end = diagnosticsBandEnd[y];
+            if (end <= y) continue;
+            diagnosticsBands[y].enstrophy += enstrophyRow(y);
+            if (end - 1 > y) diagnosticsBands[y].enstrophy += enstrophyRow(end - 1);
+        }
+    }
 
     for (int k = 0; k < 9; ++k) {
         std::swap(f[k], f_new[k]);
     }
 
+    if (!probes.empty()) sampleProbes();
+
     if (vorticityConfinement > 0.0f) {
         std::fill(curl.begin(), curl.end(), 0.0f);
+        const bool diag = diagnosticsPass;
         parallel_for(1, h - 1, [&](int startY, int endY) {
+            DiagnosticsPartial band;
             for (int y = startY; y < endY; ++y) {
                 for (int x = 1; x < w - 1; ++x) {
                     int idx = y * w + x;
                     if (barriers[idx]) continue;
                     curl[idx] = uy[idx + 1] - uy[idx - 1] - (ux[idx + w] - ux[idx - w]);
+                    if (diag) band.enstrophy += 0.125 * curl[idx] * curl[idx];
                 }
             }
+            if (diag && startY < endY) mergeDiagnostics(startY, band);
         });
         
         parallel_for(1, h - 1, [&](int startY, int endY) {
@@ -1278,9 +4581,11 @@ void FluidEngine::collideAndStream() {
     }
 }
 
+#ifdef __EMSCRIPTEN__
 val FluidEngine::getDyeView() {
     return val(typed_memory_view(w * h, dye.data()));
 }
+#endif
 
 void FluidEngine::advectDye() {
     if (!useBFECC) {
@@ -1330,10 +4635,192 @@ void FluidEngine::advectTemperature() {
     temperature.swap(temperature_new);
 }
 
+#ifdef __EMSCRIPTEN__
 val FluidEngine::getTemperatureView() {
     return val(typed_memory_view(w * h, temperature.data()));
 }
+#endif
+
+void FluidEngine::setPackedOutput(int format, int r, int g, int b, int a) {
+    packedFormat = (format >= PACKED_RGBA32F && format <= PACKED_RGBA16) ? format : PACKED_OFF;
+    packedChannels[0] = r;
+    packedChannels[1] = g;
+    packedChannels[2] = b;
+    packedChannels[3] = a;
+    resizePackedOutput();
+}
+
+void FluidEngine::setPackedLevel(int factor) {
+    packedFactor = (factor >= 4) ? 4 : (factor >= 2 ? 2 : 1);
+    resizePackedOutput();
+}
+
+void FluidEngine::resizePackedOutput() {
+    packedW = (w + packedFactor - 1) / packedFactor;
+    packedH = (h + packedFactor - 1) / packedFactor;
+    size_t texels = (size_t)packedW * packedH * 4;
+
+    bool needs32 = packedFormat == PACKED_RGBA32F || packedFormat == PACKED_RGBA8 || packedFormat == PACKED_RGBA16;
+    bool needs16 = packedFormat == PACKED_RGBA16F || packedFormat == PACKED_RGBA16;
+    bool needs8 = packedFormat == PACKED_RGBA8;
+    if (needs32) packed32.assign(texels, 0.0f); else std::vector<float>().swap(packed32);
+    if (needs16) packed16.assign(texels, 0); else std::vector<uint16_t>().swap(packed16);
+    if (needs8) packed8.assign(texels, 0); else std::vector<uint8_t>().swap(packed8);
+    packedStamp = packedSourceStamp() - 1;
+}
+
+unsigned int FluidEngine::packedSourceStamp() const {
+    return fieldVersion[FIELD_VELOCITY].load() + fieldVersion[FIELD_DENSITY].load() +
+           fieldVersion[FIELD_DYE].load() + fieldVersion[FIELD_TEMPERATURE].load();
+}
+
+// Box-filters the selected sources into interleaved RGBA texels (one 4-lane vector per texel) and, for the
+// quantized formats, reduces the per-channel min/max in the same sweep before encoding.
+void FluidEngine::writePackedOutput() {
+    unsigned int stamp = packedSourceStamp();
+    if (packedFormat == PACKED_OFF || stamp == packedStamp) return;
+    packedStamp = stamp;
+
+    const float* sources[4];
+    bool wantVorticity = false;
+    for (int c = 0; c < 4; ++c) {
+        switch (packedChannels[c]) {
+            case PACK_VELOCITY_X: sources[c] = ux.data(); break;
+            case PACK_VELOCITY_Y: sources[c] = uy.data(); break;
+            case PACK_DYE: sources[c] = dye.data(); break;
+            case PACK_TEMPERATURE: sources[c] = temperature.data(); break;
+            case PACK_DENSITY: sources[c] = rho.data(); break;
+            case PACK_VORTICITY: sources[c] = nullptr; wantVorticity = true; break;
+            default: sources[c] = nullptr; break;
+        }
+    }
+
+    const bool quantized = (packedFormat == PACKED_RGBA8 || packedFormat == PACKED_RGBA16);
+    const int factor = packedFactor;
+    std::mutex rangeMutex;
+    simd::Vec<4> v_min = simd::splat<4>(INFINITY);
+    simd::Vec<4> v_max = simd::splat<4>(-INFINITY);
+
+    parallel_for(0, packedH, [&](int startY, int endY) {
+        simd::Vec<4> local_min = simd::splat<4>(INFINITY);
+        simd::Vec<4> local_max = simd::splat<4>(-INFINITY);
+
+        for (int oy = startY; oy < endY; ++oy) {
+            for (int ox = 0; ox < packedW; ++ox) {
+                simd::Vec<4> v_acc = simd::splat<4>(0.0f);
+                int count = 0;
+
+                for (int y = oy * factor; y < std::min(h, (oy + 1) * factor); ++y) {
+                    for (int x = ox * factor; x < std::min(w, (ox + 1) * factor); ++x) {
+                        int idx = y * w + x;
+
+                        float vort = 0.0f;
+                        if (wantVorticity && x > 0 && x < w - 1 && y > 0 && y < h - 1 && !barriers[idx]) {
+                            vort = 2.0f * ((uy[idx + 1] - uy[idx - 1]) - (ux[idx + w] - ux[idx - w]));
+                        }
+
+                        float texel[4];
+                        for (int c = 0; c < 4; ++c) {
+                            if (sources[c]) texel[c] = sources[c][idx];
+                            else texel[c] = (packedChannels[c] == PACK_VORTICITY) ? vort : 0.0f;
+                        }
+                        v_acc = simd::add(v_acc, simd::load<4>(texel));
+                        count++;
+                    }
+                }
+
+                v_acc = simd::mul(v_acc, simd::splat<4>(1.0f / (float)count));
+                int o = (oy * packedW + ox) * 4;
+
+                if (packedFormat == PACKED_RGBA16F) {
+                    float texel[4];
+                    simd::store<4>(texel, v_acc);
+                    for (int c = 0; c < 4; ++c) packed16[o + c] = floatToHalf(texel[c]);
+                } else {
+                    simd::store<4>(&packed32[o], v_acc);
+                    if (quantized) {
+                        local_min = simd::min(local_min, v_acc);
+                        local_max = simd::max(local_max, v_acc);
+                    }
+                }
+            }
+        }
+
+        if (quantized) {
+            std::lock_guard<std::mutex> lock(rangeMutex);
+            v_min = simd::min(v_min, local_min);
+            v_max = simd::max(v_max, local_max);
+        }
+    });
+
+    if (quantized) {
+        simd::store<4>(packedMin, v_min);
+        simd::store<4>(packedMax, v_max);
+
+        const float levels = (packedFormat == PACKED_RGBA8) ? 255.0f : 65535.0f;
+        float scale[4];
+        for (int c = 0; c < 4; ++c) {
+            float range = packedMax[c] - packedMin[c];
+            scale[c] = (range > 0.0f) ? levels / range : 0.0f;
+        }
+        const simd::Vec<4> v_scale = simd::load<4>(scale);
+        const simd::Vec<4> v_half = simd::splat<4>(0.5f);
+
+        parallel_for(0, packedH, [&](int startY, int endY) {
+            for (int o = startY * packedW * 4; o < endY * packedW * 4; o += 4) {
+                simd::Vec<4> v_q = simd::add(simd::mul(simd::sub(simd::load<4>(&packed32[o]), v_min), v_scale), v_half);
+                float q[4];
+                simd::store<4>(q, v_q);
+                if (packedFormat == PACKED_RGBA8) {
+                    for (int c = 0; c < 4; ++c) packed8[o + c] = (uint8_t)q[c];
+                } else {
+                    for (int c = 0; c < 4; ++c) packed16[o + c] = (uint16_t)q[c];
+                }
+            }
+        });
+    } else {
+        for (int c = 0; c < 4; ++c) {
+            packedMin[c] = 0.0f;
+            packedMax[c] = 1.0f;
+        }
+    }
+    packedVersion++;
+}
+
+#ifdef __EMSCRIPTEN__
+val FluidEngine::getPackedView() {
+    writePackedOutput();
+    switch (packedFormat) {
+        case PACKED_RGBA32F: return val(typed_memory_view(packed32.size(), packed32.data()));
+        case PACKED_RGBA16F:
+        case PACKED_RGBA16: return val(typed_memory_view(packed16.size(), packed16.data()));
+        case PACKED_RGBA8: return val(typed_memory_view(packed8.size(), packed8.data()));
+        default: return val::null();
+    }
+}
+#endif
+
+unsigned int FluidEngine::getPackedVersion() {
+    return packedVersion.load();
+}
+
+int FluidEngine::getPackedWidth() {
+    return packedW;
+}
+
+int FluidEngine::getPackedHeight() {
+    return packedH;
+}
+
+float FluidEngine::getPackedMin(int channel) {
+    return (channel >= 0 && channel < 4) ? packedMin[channel] : 0.0f;
+}
+
+float FluidEngine::getPackedMax(int channel) {
+    return (channel >= 0 && channel < 4) ? packedMax[channel] : 0.0f;
+}
 
+#ifdef __EMSCRIPTEN__
 val FluidEngine::getDensityView() {
     return val(typed_memory_view(w * h, rho.data()));
 }
@@ -1349,7 +4836,9 @@ val FluidEngine::getVelocityYView() {
 val FluidEngine::getBarrierView() {
     return val(typed_memory_view(w * h, barriers.data()));
 }
+#endif
 
+#ifdef __EMSCRIPTEN__
 EMSCRIPTEN_BINDINGS(fluid_module) {
     class_<FluidEngine>("FluidEngine")
         .constructor<int, int>()
@@ -1373,6 +4862,8 @@ EMSCRIPTEN_BINDINGS(fluid_module) {
         .function("setVorticityConfinement", &FluidEngine::setVorticityConfinement)
         .function("setMaxVelocity", &FluidEngine::setMaxVelocity)
         .function("setSmagorinskyConstant", &FluidEngine::setSmagorinskyConstant)
+        .function("setCollisionModel", &FluidEngine::setCollisionModel)
+        .function("getCollisionModel", &FluidEngine::getCollisionModel)
         .function("setTemperatureViscosity", &FluidEngine::setTemperatureViscosity)
         .function("setPorosityDrag", &FluidEngine::setPorosityDrag)
         .function("setSpongeProperties", &FluidEngine::setSpongeProperties)
@@ -1380,13 +4871,70 @@ EMSCRIPTEN_BINDINGS(fluid_module) {
         .function("setSurfaceTension", &FluidEngine::setSurfaceTension)
         .function("setGCohesion", &FluidEngine::setGCohesion)
         .function("setBFECC", &FluidEngine::setBFECC)
+        .function("setRandomSeed", &FluidEngine::setRandomSeed)
+        .function("setInflowTurbulence", &FluidEngine::setInflowTurbulence)
         .function("reset", &FluidEngine::reset)
+        .function("saveCheckpoint", &FluidEngine::saveCheckpoint)
+        .function("loadCheckpoint", &FluidEngine::loadCheckpoint)
+        .function("compressField", &FluidEngine::compressField)
+        .function("decompressField", &FluidEngine::decompressField)
+        .function("getCompressionRatio", &FluidEngine::getCompressionRatio)
+        .function("setCheckpointCompression", &FluidEngine::setCheckpointCompression)
+        .function("startJournal", &FluidEngine::startJournal)
+        .function("stopJournal", &FluidEngine::stopJournal)
+        .function("getJournalView", &FluidEngine::getJournalView)
+        .function("startAsync", &FluidEngine::startAsync)
+        .function("stopAsync", &FluidEngine::stopAsync)
+        .function("setAsyncRate", &FluidEngine::setAsyncRate)
+        .function("getAsyncTickMs", &FluidEngine::getAsyncTickMs)
+        .function("stepFor", &FluidEngine::stepFor)
+        .function("getStepPhase", &FluidEngine::getStepPhase)
+        .function("setDiagnostics", &FluidEngine::setDiagnostics)
+        .function("getDiagnosticsView", &FluidEngine::getDiagnosticsView)
+        .function("getDiagnosticsHistoryView", &FluidEngine::getDiagnosticsHistoryView)
+        .function("getDiagnosticsCount", &FluidEngine::getDiagnosticsCount)
+        .function("setObstacleId", &FluidEngine::setObstacleId)
+        .function("labelObstacles", &FluidEngine::labelObstacles)
+        .function("setForceTracking", &FluidEngine::setForceTracking)
+        .function("getObstacleForcesView", &FluidEngine::getObstacleForcesView)
+        .function("getForceHistoryView", &FluidEngine::getForceHistoryView)
+        .function("getForceCount", &FluidEngine::getForceCount)
+        .function("addProbe", &FluidEngine::addProbe)
+        .function("addLineProbe", &FluidEngine::addLineProbe)
+        .function("clearProbes", &FluidEngine::clearProbes)
+        .function("setProbeCapacity", &FluidEngine::setProbeCapacity)
+        .function("getProbeCount", &FluidEngine::getProbeCount)
+        .function("drainProbes", &FluidEngine::drainProbes)
+        .function("getProbeDrainView", &FluidEngine::getProbeDrainView)
+        .function("getProbeDropped", &FluidEngine::getProbeDropped)
+        .function("getCommandsDropped", &FluidEngine::getCommandsDropped)
+        .function("startStatistics", &FluidEngine::startStatistics)
+        .function("stopStatistics", &FluidEngine::stopStatistics)
+        .function("resetStatistics", &FluidEngine::resetStatistics)
+        .function("getStatisticsSamples", &FluidEngine::getStatisticsSamples)
+        .function("getStatisticsView", &FluidEngine::getStatisticsView)
+        .function("computeSpectrum", &FluidEngine::computeSpectrum)
+        .function("setSpectrumInterval", &FluidEngine::setSpectrumInterval)
+        .function("getSpectrumView", &FluidEngine::getSpectrumView)
+        .function("getSpectrumStep", &FluidEngine::getSpectrumStep)
+        .function("setFrameBudget", &FluidEngine::setFrameBudget)
+        .function("stepFrame", &FluidEngine::stepFrame)
+        .function("getFrameBudgetIterations", &FluidEngine::getFrameBudgetIterations)
+        .function("getIterationCostMs", &FluidEngine::getIterationCostMs)
+        .function("calibrate", &FluidEngine::calibrate)
+        .function("acquireSnapshot", &FluidEngine::acquireSnapshot)
+        .function("getSnapshotView", &FluidEngine::getSnapshotView)
+        .function("getSnapshotVersion", &FluidEngine::getSnapshotVersion)
         .function("clearRegion", &FluidEngine::clearRegion)
         .function("addObstacle", emscripten::select_overload<void(int, int, int, bool, float, float, int)>(&FluidEngine::addObstacle))
         .function("applyDimensionalBrush", &FluidEngine::applyDimensionalBrush)
         .function("applyGenericBrush", &FluidEngine::applyGenericBrush)
         .function("applyPorosityBrush", &FluidEngine::applyPorosityBrush)
         .function("getDataVersion", &FluidEngine::getDataVersion)
+        .function("getFieldVersion", &FluidEngine::getFieldVersion)
+        .function("getDirtyRowStart", &FluidEngine::getDirtyRowStart)
+        .function("getDirtyRowEnd", &FluidEngine::getDirtyRowEnd)
+        .function("clearFieldDirty", &FluidEngine::clearFieldDirty)
         .function("getDensityView", &FluidEngine::getDensityView)
         .function("getVelocityXView", &FluidEngine::getVelocityXView)
         .function("getVelocityYView", &FluidEngine::getVelocityYView)
@@ -1394,5 +4942,17 @@ EMSCRIPTEN_BINDINGS(fluid_module) {
         .function("getDyeView", &FluidEngine::getDyeView)
         .function("getTemperatureView", &FluidEngine::getTemperatureView)
         .function("getPorosityView", &FluidEngine::getPorosityView)
-        .function("checkBarrierDirty", &FluidEngine::checkBarrierDirty);
-}
\ No newline at end of file
+        .function("setPackedOutput", &FluidEngine::setPackedOutput)
+        .function("getPackedView", &FluidEngine::getPackedView)
+        .function("getPackedVersion", &FluidEngine::getPackedVersion)
+        .function("setPackedLevel", &FluidEngine::setPackedLevel)
+        .function("getPackedWidth", &FluidEngine::getPackedWidth)
+        .function("getPackedHeight", &FluidEngine::getPackedHeight)
+        .function("getPackedMin", &FluidEngine::getPackedMin)
+        .function("getPackedMax", &FluidEngine::getPackedMax)
+        .function("checkBarrierDirty", &FluidEngine::checkBarrierDirty)
+        .function("getDirtyRects", &FluidEngine::getDirtyRects)
+        .function("getDirtyRectCount", &FluidEngine::getDirtyRectCount)
+        .function("clearDirtyRects", &FluidEngine::clearDirtyRects);
+}
+#endif
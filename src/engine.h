@@ -2,12 +2,130 @@
 #include <vector>
 #include <thread>
 #include <functional>
+#ifdef __EMSCRIPTEN__
 #include <emscripten/bind.h>
+#endif
 #include <mutex>
 #include <condition_variable>
 #include <queue>
 #include <atomic>
 #include <future>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+
+enum FieldId {
+    FIELD_VELOCITY = 0,
+    FIELD_DENSITY,
+    FIELD_DYE,
+    FIELD_TEMPERATURE,
+    FIELD_POROSITY,
+    FIELD_BARRIERS,
+    FIELD_COUNT
+};
+
+enum PackedSource {
+    PACK_NONE = 0,
+    PACK_VELOCITY_X,
+    PACK_VELOCITY_Y,
+    PACK_DYE,
+    PACK_TEMPERATURE,
+    PACK_DENSITY,
+    PACK_VORTICITY
+};
+
+enum OutputField {
+    OUTPUT_UX = 1 << 0,
+    OUTPUT_UY = 1 << 1,
+    OUTPUT_RHO = 1 << 2,
+    OUTPUT_DYE = 1 << 3,
+    OUTPUT_TEMPERATURE = 1 << 4,
+    OUTPUT_ALL = (1 << 5) - 1
+};
+
+enum SnapshotField {
+    SNAPSHOT_UX = 0,
+    SNAPSHOT_UY,
+    SNAPSHOT_DENSITY,
+    SNAPSHOT_DYE,
+    SNAPSHOT_TEMPERATURE,
+    SNAPSHOT_POROSITY,
+    SNAPSHOT_BARRIERS,
+    SNAPSHOT_COUNT
+};
+
+enum StepPhase {
+    PHASE_MACRO_BOUNDARIES = 0,
+    PHASE_SURFACE_TENSION,
+    PHASE_COLLIDE_STREAM,
+    PHASE_POST_STREAM,
+    PHASE_DYE,
+    PHASE_TEMPERATURE,
+    PHASE_COUNT
+};
+
+enum DiagnosticField {
+    DIAG_STEP = 0,
+    DIAG_MASS,
+    DIAG_KINETIC_ENERGY,
+    DIAG_ENSTROPHY,
+    DIAG_MAX_SPEED_RATIO,
+    DIAG_CLAMPED_FRACTION,
+    DIAG_DYE,
+    DIAG_HEAT,
+    DIAG_COUNT
+};
+
+enum ProbeChannel {
+    PROBE_UX = 0,
+    PROBE_UY,
+    PROBE_PRESSURE,
+    PROBE_DYE,
+    PROBE_TEMPERATURE,
+    PROBE_CHANNEL_COUNT
+};
+
+enum StatisticsField {
+    STAT_MEAN_UX = 0,
+    STAT_MEAN_UY,
+    STAT_VAR_UX,
+    STAT_VAR_UY,
+    STAT_COV_UV,
+    STAT_MEAN_DYE,
+    STAT_MEAN_TEMPERATURE,
+    STAT_COUNT
+};
+
+enum CollisionModel {
+    COLLISION_BGK = 0,
+    COLLISION_REGULARIZED,
+    COLLISION_MODEL_COUNT
+};
+
+enum CompressionMode {
+    COMPRESS_NONE = 0,
+    COMPRESS_LOSSLESS,
+    COMPRESS_LOSSY
+};
+
+enum CodecField {
+    CODEC_F0 = 0,
+    CODEC_UX = 9,
+    CODEC_UY,
+    CODEC_RHO,
+    CODEC_DYE,
+    CODEC_TEMPERATURE,
+    CODEC_POROSITY,
+    CODEC_FIELD_COUNT
+};
+
+enum PackedFormat {
+    PACKED_OFF = 0,
+    PACKED_RGBA32F,
+    PACKED_RGBA16F,
+    PACKED_RGBA8,
+    PACKED_RGBA16
+};
 
 class FluidEngine {
 public:
@@ -31,6 +149,8 @@ public:
     
     void setSmagorinskyConstant(float c);
     void setTemperatureViscosity(float v);
+    void setCollisionModel(int model);
+    int getCollisionModel();
     
     void setFlowBehaviorIndex(float n);
     void setConsistencyIndex(float k);
@@ -43,10 +163,23 @@ public:
     void setGCohesion(float g);
 
     void setThreadCount(int count);
+    bool setNumaPlacement(bool enabled);
+    std::vector<double> measureNodeBandwidth(int passes);
+    int getSimdWidth();
+    void setSimdWidth(int width);
     void setBFECC(bool enable);
+    void setRandomSeed(unsigned int seed);
+    void setInflowTurbulence(float intensity, float lengthScale);
+    void setRowOffset(int offset, int period);
     
     unsigned int getDataVersion();
+    uint64_t getStepCount() const;
+    unsigned int getFieldVersion(int field);
+    int getDirtyRowStart(int field);
+    int getDirtyRowEnd(int field);
+    void clearFieldDirty(int field);
 
+#ifdef __EMSCRIPTEN__
     emscripten::val getDensityView();
     emscripten::val getVelocityXView();
     emscripten::val getVelocityYView();
@@ -54,8 +187,108 @@ public:
     emscripten::val getDyeView();
     emscripten::val getTemperatureView();
     emscripten::val getPorosityView();
+#endif
+
+    void setPackedOutput(int format, int r, int g, int b, int a);
+    void setPackedLevel(int factor);
+#ifdef __EMSCRIPTEN__
+    emscripten::val getPackedView();
+#endif
+    unsigned int getPackedVersion();
+    int getPackedWidth();
+    int getPackedHeight();
+    float getPackedMin(int channel);
+    float getPackedMax(int channel);
 
     void reset();
+#ifdef __EMSCRIPTEN__
+    emscripten::val saveCheckpoint();
+    bool loadCheckpoint(emscripten::val arrayBuffer);
+#endif
+    bool saveCheckpointFile(const std::string& path);
+    bool loadCheckpointFile(const std::string& path);
+    bool startFieldOutput(const std::string& directory, int fieldMask, int stride, int bufferCount);
+    void stopFieldOutput();
+    unsigned int getOutputFramesWritten();
+    unsigned int getOutputFramesDropped();
+    unsigned int getOutputFramesLate();
+#ifdef __EMSCRIPTEN__
+    emscripten::val compressField(int field, int mode, float errorBound);
+    emscripten::val decompressField(emscripten::val buffer);
+#endif
+    float getCompressionRatio();
+    size_t compressFieldTo(int field, int mode, float errorBound, std::vector<uint8_t>& out);
+    bool decompressFieldTo(const uint8_t* data, size_t size, std::vector<float>& out);
+    const std::vector<float>* codecSource(int field) const;
+    int getHaloRowSize() const;
+    int getHaloRowsNeeded() const;
+    void exportRows(int y, int rows, float* dst) const;
+    void importRows(int y, int rows, const float* src);
+    void setCheckpointCompression(int mode);
+    void setOutputCompression(int mode, float errorBound);
+    void startJournal();
+    void stopJournal();
+#ifdef __EMSCRIPTEN__
+    emscripten::val getJournalView();
+#endif
+    bool saveJournalFile(const std::string& path);
+    static bool readJournalHeader(const uint8_t* data, size_t size, int& width, int& height, int& threads,
+                                  uint64_t& startStep);
+    bool replayJournal(const uint8_t* data, size_t size, int threadOverride);
+    bool startAsync(float tickRate, int iterationsPerTick);
+    void stopAsync();
+    void setAsyncRate(float tickRate, int iterationsPerTick);
+    float getAsyncTickMs();
+    unsigned int getCommandsDropped();
+    void setFrameBudget(float targetMs, int minIterations, int maxIterations);
+    int stepFrame();
+    int getFrameBudgetIterations();
+    float getIterationCostMs();
+    int calibrate(int maxThreads, int trialIterations);
+    int stepFor(int budgetUs);
+    int getStepPhase();
+    void setDiagnostics(bool enabled, int historyLength);
+#ifdef __EMSCRIPTEN__
+    emscripten::val getDiagnosticsView();
+    emscripten::val getDiagnosticsHistoryView();
+#endif
+    unsigned int getDiagnosticsCount();
+    void setObstacleId(int id);
+    int labelObstacles();
+    void setForceTracking(bool enabled, int historyLength);
+#ifdef __EMSCRIPTEN__
+    emscripten::val getObstacleForcesView();
+    emscripten::val getForceHistoryView();
+#endif
+    unsigned int getForceCount();
+    int addProbe(float x, float y);
+    int addLineProbe(float x0, float y0, float x1, float y1, int count);
+    void clearProbes();
+    void setProbeCapacity(int records);
+    int getProbeCount();
+    int drainProbes();
+#ifdef __EMSCRIPTEN__
+    emscripten::val getProbeDrainView();
+#endif
+    unsigned int getProbeDropped();
+    void startStatistics();
+    void stopStatistics();
+    void resetStatistics();
+    unsigned int getStatisticsSamples();
+#ifdef __EMSCRIPTEN__
+    emscripten::val getStatisticsView(int field);
+#endif
+    int computeSpectrum(int window);
+    void setSpectrumInterval(int steps, int window);
+#ifdef __EMSCRIPTEN__
+    emscripten::val getSpectrumView();
+#endif
+    double getSpectrumStep();
+    bool acquireSnapshot();
+#ifdef __EMSCRIPTEN__
+    emscripten::val getSnapshotView(int field);
+#endif
+    unsigned int getSnapshotVersion(int field);
     void addDensity(int x, int y, float amount);
     void addTemperature(int x, int y, float amount);
     void clearRegion(int x, int y, int radius);
@@ -65,6 +298,11 @@ public:
     void applyPorosityBrush(int x, int y, int radius, float strength, bool add, float falloff, float angle, float aspectRatio, int shape, int falloffMode);
     
     bool checkBarrierDirty();
+#ifdef __EMSCRIPTEN__
+    emscripten::val getDirtyRects(int field);
+#endif
+    int getDirtyRectCount(int field);
+    void clearDirtyRects(int field);
 
 private:
     int w, h;
@@ -90,6 +328,7 @@ private:
     float maxVelocity;
     
     float smagorinskyConstant;
+    int collisionModel;
     float temperatureViscosity;
     float flowBehaviorIndex;
     float consistencyIndex;
@@ -100,9 +339,23 @@ private:
     bool spongeLeft, spongeRight, spongeTop, spongeBottom;
     
     int threadCount;
+    bool numaPlacement;
+    int simdWidth;
     bool useBFECC;
+
+    uint32_t randomSeed;
+    uint64_t stepCount;
+    uint32_t brushSerial;
+    float inflowTurbulenceIntensity;
+    float inflowTurbulenceScale;
+    int rowOffset, rowPeriod;
     
     std::atomic<unsigned int> dataVersion;
+    std::atomic<unsigned int> fieldVersion[FIELD_COUNT];
+    int dirtyRowStart[FIELD_COUNT];
+    int dirtyRowEnd[FIELD_COUNT];
+    bool dyeActive;
+    bool temperatureActive;
 
     std::vector<float> f[9];     
     std::vector<float> f_new[9]; 
@@ -123,6 +376,18 @@ private:
     std::vector<float> forceY;
     std::vector<float> curl;
 
+    int packedFormat;
+    int packedChannels[4];
+    int packedFactor;
+    int packedW, packedH;
+    std::vector<float> packed32;
+    std::vector<uint16_t> packed16;
+    std::vector<uint8_t> packed8;
+    float packedMin[4];
+    float packedMax[4];
+    unsigned int packedStamp;
+    std::atomic<unsigned int> packedVersion;
+
     std::vector<std::thread> workers;
     std::mutex worker_mutex;
     std::condition_variable worker_cv;
@@ -136,6 +401,170 @@ private:
     int task_end;
     
     std::atomic<bool> barriersDirty;
+    std::vector<int> barrierRects;
+    std::vector<int> porosityRects;
+    std::vector<int> barrierRowCount;
+
+    std::vector<uint8_t> checkpointBuffer;
+
+    struct OutputFrame {
+        uint64_t step;
+        uint64_t frame;
+        std::vector<float> data;
+    };
+    bool outputActive;
+    bool outputStop;
+    int outputFieldMask;
+    int outputFieldCount;
+    int outputStride;
+    uint64_t outputFrameCounter;
+    uint64_t outputOffset;
+    std::string outputDirectory;
+    FILE* outputFile;
+    std::string outputIndex;
+    std::vector<OutputFrame> outputPool;
+    std::vector<int> outputFree;
+    std::queue<int> outputQueue;
+    std::thread outputThread;
+    std::mutex outputMutex;
+    std::condition_variable outputCv;
+    std::atomic<unsigned int> outputWritten;
+    std::atomic<unsigned int> outputDropped;
+    std::atomic<unsigned int> outputLate;
+    int outputCodec;
+    float outputErrorBound;
+    std::vector<uint8_t> outputCodecBuffer;
+
+    int checkpointCodec;
+    float compressionRatio;
+    std::vector<uint8_t> codecBuffer;
+    std::vector<float> codecFloats;
+
+    bool journalActive;
+    uint64_t journalStep;
+    std::vector<uint8_t> journal;
+
+    static const int OBSTACLE_ID_COUNT = 64;
+    static const int FORCE_RECORD_SIZE = 1 + 2 * OBSTACLE_ID_COUNT;
+    struct Snapshot {
+        std::vector<float> fields[SNAPSHOT_BARRIERS];
+        std::vector<unsigned char> barriers;
+        unsigned int version[FIELD_COUNT];
+        uint64_t step;
+        double diagnostics[DIAG_COUNT];
+        double forces[FORCE_RECORD_SIZE];
+    };
+    std::atomic<bool> asyncActive;
+    bool asyncStop;
+    std::atomic<float> asyncTickRate;
+    std::atomic<int> asyncIterations;
+    std::atomic<float> asyncTickMs;
+    std::thread asyncThread;
+    std::thread::id asyncThreadId;
+    std::mutex asyncTickMutex;
+    std::atomic<float> frameBudgetMs;
+    std::atomic<int> budgetMinIterations;
+    std::atomic<int> budgetMaxIterations;
+    std::atomic<int> budgetIterations;
+    std::atomic<float> iterationCostMs;
+    int stepPhase;
+    float phaseCostUs[PHASE_COUNT];
+
+    struct DiagnosticsPartial {
+        double mass = 0.0;
+        double kinetic = 0.0;
+        double enstrophy = 0.0;
+        double dye = 0.0;
+        double heat = 0.0;
+        float maxSpeedSq = 0.0f;
+        uint64_t clampedCells = 0;
+        uint64_t fluidCells = 0;
+    };
+    bool diagnosticsEnabled;
+    bool diagnosticsDue;
+    bool diagnosticsPass;
+    // Partials of one diagnostics pass, in the slot of the first row of the band that produced
+    // them, so the reduction runs in row order whatever order the workers finish in.
+    std::vector<DiagnosticsPartial> diagnosticsBands;
+    std::vector<int> diagnosticsBandEnd;
+    // Per-band state of one collision sweep, shared by the vector kernels and the per-cell path.
+    struct CollideBand {
+        DiagnosticsPartial diag;
+        double force[2 * OBSTACLE_ID_COUNT];
+        float feqRest[9];
+        bool diagnostics, forces, stats;
+        bool useSmagorinsky, useTempVisc, useNonNewtonian;
+        int collision;
+        float invSamples;
+    };
+    std::mutex diagnosticsMutex;
+    std::vector<double> diagnosticsLatest;
+    std::vector<double> diagnosticsHistory;
+    unsigned int diagnosticsCount;
+
+    std::vector<unsigned char> obstacleIds;
+    int obstacleIdBrush;
+    bool forceTracking;
+    int forceIterations;
+    std::vector<double> forceLatest;
+    std::vector<double> forceSum;
+    std::vector<double> forceHistory;
+    unsigned int forceCount;
+
+    struct Probe {
+        int idx;
+        float w00, w10, w01, w11;
+    };
+    std::vector<Probe> probes;
+    int probeRecordSize;
+    int probeCapacity;
+    std::vector<float> probeRing;
+    std::atomic<uint32_t> probeHead;
+    std::atomic<uint32_t> probeTail;
+    std::atomic<unsigned int> probeDropped;
+    std::vector<float> probeDrain;
+
+    bool statisticsActive;
+    unsigned int statisticsSamples;
+    std::vector<float> statMeanU, statMeanV;
+    std::vector<float> statM2U, statM2V, statCUV;
+    std::vector<float> statMeanDye, statMeanT;
+    std::vector<float> statMoments[3];
+
+    struct FftPlan {
+        int n;
+        int m;
+        std::vector<int> bitrev;
+        std::vector<float> cosTable, sinTable;
+        std::vector<float> chirpRe, chirpIm;
+        std::vector<float> kernelRe, kernelIm;
+    };
+    std::vector<FftPlan> fftPlans;
+    std::vector<float> spectrumRe, spectrumIm;
+    std::vector<float> spectrumTRe, spectrumTIm;
+    std::vector<float> spectrum;
+    int spectrumInterval;
+    int spectrumWindow;
+    uint64_t spectrumStep;
+
+    struct QueuedCommand {
+        int op;
+        int size;
+        uint8_t args[48];
+        std::vector<uint8_t>* checkpoint;
+    };
+    std::vector<QueuedCommand> commandRing;
+    std::atomic<uint32_t> commandHead;
+    std::atomic<uint32_t> commandTail;
+    std::atomic<unsigned int> commandsDropped;
+    std::mutex commandOverflowMutex;
+    std::vector<QueuedCommand> commandOverflow;
+    std::atomic<bool> commandOverflowPending;
+    std::vector<QueuedCommand> commandBatch;
+    Snapshot snapshots[3];
+    std::atomic<int> snapshotShared;
+    int snapshotBack;
+    int snapshotFront;
 
     using WallHandler = void (FluidEngine::*)(int& dest_k, float& f_bounce, int k, int idx) const;
     WallHandler leftHandler;
@@ -144,6 +573,11 @@ private:
     WallHandler bottomHandler;
 
     void setHandlers();
+
+    using CollideKernel = void (FluidEngine::*)(int startY, int endY, CollideBand& band);
+    CollideKernel collideKernel;
+    void setCollideKernel();
+    template <int W, int H> static CollideKernel collideKernelFor(int width);
     void handlerNoSlip(int& dest_k, float& f_bounce, int k, int idx) const;
     void handlerSlipV(int& dest_k, float& f_bounce, int k, int idx) const;
     void handlerSlipH(int& dest_k, float& f_bounce, int k, int idx) const;
@@ -153,15 +587,71 @@ private:
     void handlerMovingBottom(int& dest_k, float& f_bounce, int k, int idx) const;
 
     void initThreadPool(int count);
+    bool applyWorkerAffinity();
+    void rehomeFields();
+    int checkpointParams(float** out);
+    void writeCheckpoint(std::vector<uint8_t>& out);
+    bool decodeCheckpoint(const uint8_t* data, size_t size, std::vector<float>* decoded, bool parallel);
+    bool readCheckpoint(const uint8_t* data, size_t size);
+    void captureOutputFrame();
+    void writeOutputFrame(const OutputFrame& frame, int codec, float errorBound);
+    void encodeField(const float* src, int width, int height, int mode, float errorBound,
+                     std::vector<uint8_t>& out, bool parallel);
+    bool decodeField(const uint8_t* data, size_t size, int width, int height, float* dst, bool parallel);
+    void writeOutputIndex();
+    template <class... Args> void record(uint64_t atStep, int op, Args... args);
+    template <class... Args> bool intercept(int op, Args... args);
+    static void encodeArg(std::vector<uint8_t>& out, int v);
+    static void encodeArg(std::vector<uint8_t>& out, unsigned int v);
+    static void encodeArg(std::vector<uint8_t>& out, float v);
+    static void encodeArg(std::vector<uint8_t>& out, bool v);
+    bool dispatchCommand(int op, const uint8_t*& p, const uint8_t* end, int threadOverride);
+    std::unique_lock<std::mutex> lockSimulation();
+    void updateFrameBudget(int iterations, float elapsedMs);
+    unsigned int featureMask() const;
+    void pushCommand(const QueuedCommand& cmd);
+    bool commandsPending() const;
+    void drainCommands();
+    int advance(int iterations, bool yieldToCommands);
+    bool runPhase();
+    void finishStep(bool completed);
+    int stepPhases(int phases);
+    void mergeDiagnostics(int startY, const DiagnosticsPartial& band);
+    double enstrophyRow(int y) const;
+    void publishDiagnostics();
+    void publishForces();
+    int labelComponents();
+    void resetProbeRing();
+    void sampleProbes();
+    void clearStatistics();
+    const FftPlan& fftPlan(int n);
+    static void fftLanes(float* re, float* im, const FftPlan& plan);
+    void fftColumns(float* re, float* im, int width, int height);
+    int spectrumNow(int window);
+    void publishSnapshot();
+    void closeFieldOutput();
+    void markFieldDirty(int field, int startY, int endY);
+    void markFieldDirty(int field) { markFieldDirty(field, 0, h); }
+    void markDirtyRect(int field, int x0, int y0, int x1, int y1);
+    std::vector<int>* dirtyRectList(int field);
+    bool rowsBarrierFree(int y) const;
 
     void equilibrium(float r, float u, float v, float* feq);
     void applySurfaceTension();
     void collideAndStream();
+    template <int N, int W = 0, int H = 0> void collideRows(int startY, int endY, CollideBand& band);
+    void collideCell(int x, int y, CollideBand& band);
+    void exchangeMomentum(CollideBand& band, int n_idx, int k, float f_out);
     void advectDye();
     void advectTemperature();
     void limitVelocity(float &u, float &v);
     void applyMacroscopicBoundaries();
+    void inflowPerturbation(int side, int s, float& du, float& dv) const;
+    void applyInflowEquilibrium(int side, int idx, int s);
     void applyPostStreamBoundaries();
+    unsigned int packedSourceStamp() const;
+    void resizePackedOutput();
+    void writePackedOutput();
     void performAdvection(const std::vector<float>& src, std::vector<float>& dst, float dt_scale, float decay_rate);
     
     void parallel_for(int start, int end, std::function<void(int, int)> func);
@@ -0,0 +1,384 @@
+#include "ensemble.h"
+#include "lattice.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef __EMSCRIPTEN__
+using namespace emscripten;
+#endif
+
+typedef simd::Vec<ENSEMBLE_LANES> Lanes;
+
+static inline void equilibriumLanes(Lanes r, Lanes u, Lanes v, Lanes* feq) {
+    Lanes usq = simd::madd(u, u, simd::mul(v, v));
+    Lanes base = simd::sub(simd::splat<ENSEMBLE_LANES>(1.0f), simd::mul(simd::splat<ENSEMBLE_LANES>(1.5f), usq));
+    for (int k = 0; k < 9; ++k) {
+        Lanes cu = simd::madd(simd::splat<ENSEMBLE_LANES>((float)cx[k]), u,
+                              simd::mul(simd::splat<ENSEMBLE_LANES>((float)cy[k]), v));
+        Lanes poly = simd::madd(cu, simd::madd(simd::splat<ENSEMBLE_LANES>(4.5f), cu, simd::splat<ENSEMBLE_LANES>(3.0f)), base);
+        feq[k] = simd::mul(simd::mul(simd::splat<ENSEMBLE_LANES>(weights[k]), r), poly);
+    }
+}
+
+EnsembleEngine::EnsembleEngine(int width, int height)
+    : w(width), h(height)
+    , boundaryLeft(0), boundaryRight(0), boundaryTop(0), boundaryBottom(0)
+    , maxVelocity(0.57f)
+    , thermalActive(false)
+{
+    int lanes = w * h * ENSEMBLE_LANES;
+    for (int k = 0; k < 9; ++k) {
+        f[k].resize(lanes);
+        f_new[k].resize(lanes);
+    }
+    rho.resize(lanes);
+    ux.resize(lanes);
+    uy.resize(lanes);
+    temperature.resize(lanes);
+    temperatureNext.resize(lanes);
+    barriers.assign(w * h, 0);
+    interior.assign(w * h, 0);
+    memberScratch.resize(w * h);
+
+    for (int m = 0; m < ENSEMBLE_LANES; ++m) {
+        omega[m] = 1.0f / (3.0f * 0.02f + 0.5f);
+        inflowX[m] = 0.1f;
+        inflowY[m] = 0.0f;
+        gravityX[m] = 0.0f;
+        gravityY[m] = 0.0f;
+        expansion[m] = 0.0f;
+        referenceTemperature[m] = 0.0f;
+        diffusivity[m] = 0.0f;
+    }
+    updateInterior();
+    reset();
+}
+
+int EnsembleEngine::getLaneCount() {
+    return ENSEMBLE_LANES;
+}
+
+void EnsembleEngine::setBoundaryConditions(int left, int right, int top, int bottom) {
+    boundaryLeft = left;
+    boundaryRight = right;
+    boundaryTop = top;
+    boundaryBottom = bottom;
+}
+
+void EnsembleEngine::setMemberViscosity(int member, float viscosity) {
+    if (member < 0 || member >= ENSEMBLE_LANES) return;
+    omega[member] = 1.0f / (3.0f * viscosity + 0.5f);
+}
+
+void EnsembleEngine::setMemberInflow(int member, float vx, float vy) {
+    if (member < 0 || member >= ENSEMBLE_LANES) return;
+    inflowX[member] = vx;
+    inflowY[member] = vy;
+}
+
+void EnsembleEngine::setMemberGravity(int member, float gx, float gy) {
+    if (member < 0 || member >= ENSEMBLE_LANES) return;
+    gravityX[member] = gx;
+    gravityY[member] = gy;
+}
+
+void EnsembleEngine::setMemberThermal(int member, float exp, float refTemp, float diff) {
+    if (member < 0 || member >= ENSEMBLE_LANES) return;
+    expansion[member] = exp;
+    referenceTemperature[member] = refTemp;
+    diffusivity[member] = diff;
+}
+
+void EnsembleEngine::setMaxVelocity(float mv) {
+    maxVelocity = mv;
+}
+
+void EnsembleEngine::addObstacle(int x, int y, int radius) {
+    for (int dy = -radius; dy <= radius; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+            if (dx * dx + dy * dy > radius * radius) continue;
+            int nx = x + dx, ny = y + dy;
+            if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+            int idx = ny * w + nx;
+            barriers[idx] = 1;
+            for (int m = 0; m < ENSEMBLE_LANES; ++m) {
+                ux[idx * ENSEMBLE_LANES + m] = 0.0f;
+                uy[idx * ENSEMBLE_LANES + m] = 0.0f;
+            }
+        }
+    }
+    updateInterior();
+}
+
+void EnsembleEngine::clearObstacles() {
+    std::fill(barriers.begin(), barriers.end(), 0);
+    updateInterior();
+}
+
+// Cells off the lattice edge with no solid among their eight neighbours stream every population
+// straight to its neighbour, with no boundary or bounce-back test.
+void EnsembleEngine::updateInterior() {
+    std::fill(interior.begin(), interior.end(), 0);
+    for (int y = 1; y < h - 1; ++y) {
+        for (int x = 1; x < w - 1; ++x) {
+            int idx = y * w + x;
+            bool open = true;
+            for (int k = 0; k < 9; ++k) open = open && !barriers[idx + cx[k] + cy[k] * w];
+            interior[idx] = open;
+        }
+    }
+}
+
+void EnsembleEngine::addTemperature(int x, int y, int radius, float amount) {
+    for (int dy = -radius; dy <= radius; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+            if (dx * dx + dy * dy > radius * radius) continue;
+            int nx = x + dx, ny = y + dy;
+            if (nx < 0 || nx >= w || ny < 0 || ny >= h) continue;
+            int idx = ny * w + nx;
+            if (barriers[idx]) continue;
+            for (int m = 0; m < ENSEMBLE_LANES; ++m) temperature[idx * ENSEMBLE_LANES + m] += amount;
+        }
+    }
+    thermalActive = true;
+}
+
+void EnsembleEngine::reset() {
+    Lanes feq[9];
+    equilibriumLanes(simd::splat<ENSEMBLE_LANES>(1.0f), simd::splat<ENSEMBLE_LANES>(0.0f), simd::splat<ENSEMBLE_LANES>(0.0f), feq);
+    for (int i = 0; i < w * h; ++i) {
+        int base = i * ENSEMBLE_LANES;
+        for (int k = 0; k < 9; ++k) {
+            simd::store<ENSEMBLE_LANES>(&f[k][base], feq[k]);
+            simd::store<ENSEMBLE_LANES>(&f_new[k][base], feq[k]);
+        }
+    }
+    std::fill(rho.begin(), rho.end(), 1.0f);
+    std::fill(ux.begin(), ux.end(), 0.0f);
+    std::fill(uy.begin(), uy.end(), 0.0f);
+    std::fill(temperature.begin(), temperature.end(), 0.0f);
+    std::fill(temperatureNext.begin(), temperatureNext.end(), 0.0f);
+    thermalActive = false;
+}
+
+void EnsembleEngine::step(int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+        applyInflow();
+        collideAndStream();
+        applyOutflow();
+        if (thermalActive) advectTemperature();
+    }
+}
+
+void EnsembleEngine::applyInflow() {
+    Lanes feq[9];
+    equilibriumLanes(simd::splat<ENSEMBLE_LANES>(1.0f), simd::load<ENSEMBLE_LANES>(inflowX), simd::load<ENSEMBLE_LANES>(inflowY), feq);
+    auto apply = [&](int idx) {
+        if (barriers[idx]) return;
+        for (int k = 0; k < 9; ++k) simd::store<ENSEMBLE_LANES>(&f[k][idx * ENSEMBLE_LANES], feq[k]);
+    };
+    if (boundaryLeft == 4) for (int y = 0; y < h; ++y) apply(y * w);
+    if (boundaryRight == 4) for (int y = 0; y < h; ++y) apply(y * w + w - 1);
+    if (boundaryBottom == 4) for (int x = 0; x < w; ++x) apply(x);
+    if (boundaryTop == 4) for (int x = 0; x < w; ++x) apply((h - 1) * w + x);
+}
+
+void EnsembleEngine::applyOutflow() {
+    auto copy = [&](int idx, int from) {
+        if (barriers[idx]) return;
+        for (int k = 0; k < 9; ++k)
+            simd::store<ENSEMBLE_LANES>(&f[k][idx * ENSEMBLE_LANES], simd::load<ENSEMBLE_LANES>(&f[k][from * ENSEMBLE_LANES]));
+    };
+    if (boundaryLeft == 5) for (int y = 0; y < h; ++y) copy(y * w, y * w + 1);
+    if (boundaryRight == 5) for (int y = 0; y < h; ++y) copy(y * w + w - 1, y * w + w - 2);
+    if (boundaryBottom == 5) for (int x = 0; x < w; ++x) copy(x, w + x);
+    if (boundaryTop == 5) for (int x = 0; x < w; ++x) copy((h - 1) * w + x, (h - 2) * w + x);
+}
+
+void EnsembleEngine::collideAndStream() {
+    const Lanes v_zero = simd::splat<ENSEMBLE_LANES>(0.0f);
+    const Lanes v_one = simd::splat<ENSEMBLE_LANES>(1.0f);
+    const Lanes v_omega = simd::load<ENSEMBLE_LANES>(omega);
+    const Lanes v_gx = simd::load<ENSEMBLE_LANES>(gravityX);
+    const Lanes v_gy = simd::load<ENSEMBLE_LANES>(gravityY);
+    const Lanes v_exp = simd::load<ENSEMBLE_LANES>(expansion);
+    const Lanes v_refT = simd::load<ENSEMBLE_LANES>(referenceTemperature);
+    bool buoyant = false;
+    for (int m = 0; m < ENSEMBLE_LANES; ++m) buoyant = buoyant || expansion[m] != 0.0f;
+    int offset[9];
+    for (int k = 0; k < 9; ++k) offset[k] = (cx[k] + cy[k] * w) * ENSEMBLE_LANES;
+    const Lanes v_maxVel = simd::splat<ENSEMBLE_LANES>(maxVelocity);
+    Lanes restEq[9];
+    equilibriumLanes(v_one, v_zero, v_zero, restEq);
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int idx = y * w + x;
+            int base = idx * ENSEMBLE_LANES;
+
+            if (barriers[idx]) {
+                for (int k = 0; k < 9; ++k) simd::store<ENSEMBLE_LANES>(&f_new[k][base], restEq[k]);
+                continue;
+            }
+
+            Lanes fk[9];
+            Lanes v_rho = v_zero, v_mx = v_zero, v_my = v_zero;
+            for (int k = 0; k < 9; ++k) {
+                fk[k] = simd::load<ENSEMBLE_LANES>(&f[k][base]);
+                v_rho = simd::add(v_rho, fk[k]);
+                if (cx[k]) v_mx = cx[k] > 0 ? simd::add(v_mx, fk[k]) : simd::sub(v_mx, fk[k]);
+                if (cy[k]) v_my = cy[k] > 0 ? simd::add(v_my, fk[k]) : simd::sub(v_my, fk[k]);
+            }
+            v_rho = simd::max(v_rho, simd::splat<ENSEMBLE_LANES>(1e-6f));
+
+            Lanes v_fy = v_gy;
+            if (buoyant) {
+                Lanes v_temp = simd::load<ENSEMBLE_LANES>(&temperature[base]);
+                v_fy = simd::add(v_fy, simd::mul(v_gy, simd::mul(v_exp, simd::sub(v_temp, v_refT))));
+            }
+            Lanes v_u = simd::add(simd::div(v_mx, v_rho), v_gx);
+            Lanes v_v = simd::add(simd::div(v_my, v_rho), v_fy);
+
+            Lanes v_speed = simd::sqrt(simd::add(simd::mul(v_u, v_u), simd::mul(v_v, v_v)));
+            simd::Mask<ENSEMBLE_LANES> v_over = simd::gt(v_speed, v_maxVel);
+            if (simd::anyTrue(v_over)) {
+                Lanes v_ratio = simd::div(v_maxVel, v_speed);
+                v_u = simd::select(v_over, simd::mul(v_u, v_ratio), v_u);
+                v_v = simd::select(v_over, simd::mul(v_v, v_ratio), v_v);
+            }
+
+            simd::store<ENSEMBLE_LANES>(&rho[base], v_rho);
+            simd::store<ENSEMBLE_LANES>(&ux[base], v_u);
+            simd::store<ENSEMBLE_LANES>(&uy[base], v_v);
+
+            Lanes feq[9];
+            equilibriumLanes(v_rho, v_u, v_v, feq);
+
+            if (interior[idx]) {
+                for (int k = 0; k < 9; ++k)
+                    simd::store<ENSEMBLE_LANES>(&f_new[k][base + offset[k]], simd::madd(v_omega, simd::sub(feq[k], fk[k]), fk[k]));
+                continue;
+            }
+            for (int k = 0; k < 9; ++k) {
+                Lanes out = simd::madd(v_omega, simd::sub(feq[k], fk[k]), fk[k]);
+                int nx = x + cx[k];
+                int ny = y + cy[k];
+                bool outX = nx < 0 || nx >= w;
+                bool outY = ny < 0 || ny >= h;
+
+                if (outX || outY) {
+                    int sideX = nx < 0 ? boundaryLeft : boundaryRight;
+                    int sideY = ny < 0 ? boundaryBottom : boundaryTop;
+                    bool wrapX = !outX || sideX == 0;
+                    bool wrapY = !outY || sideY == 0;
+                    if (wrapX && wrapY) {
+                        nx = (nx + w) % w;
+                        ny = (ny + h) % h;
+                    } else {
+                        int dest = opp[k];
+                        if (outX && !outY && sideX == 2) dest = slip_v[k];
+                        else if (outY && !outX && sideY == 2) dest = slip_h[k];
+                        simd::store<ENSEMBLE_LANES>(&f_new[dest][base], out);
+                        continue;
+                    }
+                }
+
+                int nidx = ny * w + nx;
+                if (barriers[nidx]) simd::store<ENSEMBLE_LANES>(&f_new[opp[k]][base], out);
+                else simd::store<ENSEMBLE_LANES>(&f_new[k][nidx * ENSEMBLE_LANES], out);
+            }
+        }
+    }
+
+    for (int k = 0; k < 9; ++k) f[k].swap(f_new[k]);
+}
+
+// FluidEngine::performAdvection for each lane in turn: the departure point depends on the lane's
+// own velocity, so the bilinear gather cannot share one set of weights across the vector.
+void EnsembleEngine::advectTemperature() {
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int idx = y * w + x;
+            int base = idx * ENSEMBLE_LANES;
+            if (barriers[idx]) {
+                for (int m = 0; m < ENSEMBLE_LANES; ++m) temperatureNext[base + m] = 0.0f;
+                continue;
+            }
+            for (int m = 0; m < ENSEMBLE_LANES; ++m) {
+                float x_prev = (float)x - ux[base + m];
+                float y_prev = (float)y - uy[base + m];
+                if (x_prev < 0.5f) x_prev = 0.5f;
+                if (x_prev > w - 1.5f) x_prev = w - 1.5f;
+                if (y_prev < 0.5f) y_prev = 0.5f;
+                if (y_prev > h - 1.5f) y_prev = h - 1.5f;
+
+                int ix = static_cast<int>(x_prev);
+                int iy = static_cast<int>(y_prev);
+                float fx = x_prev - ix;
+                float fy = y_prev - iy;
+                int idx_tl = iy * w + ix;
+                int idx_bl = idx_tl + w;
+
+                float d_tl = barriers[idx_tl] ? 0.0f : temperature[idx_tl * ENSEMBLE_LANES + m];
+                float d_tr = barriers[idx_tl + 1] ? 0.0f : temperature[(idx_tl + 1) * ENSEMBLE_LANES + m];
+                float d_bl = barriers[idx_bl] ? 0.0f : temperature[idx_bl * ENSEMBLE_LANES + m];
+                float d_br = barriers[idx_bl + 1] ? 0.0f : temperature[(idx_bl + 1) * ENSEMBLE_LANES + m];
+
+                float interpolated = (1.0f - fx) * (1.0f - fy) * d_tl +
+                                     fx * (1.0f - fy) * d_tr +
+                                     (1.0f - fx) * fy * d_bl +
+                                     fx * fy * d_br;
+                temperatureNext[base + m] = interpolated * (1.0f - diffusivity[m]);
+            }
+        }
+    }
+    temperature.swap(temperatureNext);
+}
+
+const float* EnsembleEngine::memberField(int member, int field) {
+    const std::vector<float>* src = nullptr;
+    switch (field) {
+        case ENSEMBLE_UX: src = &ux; break;
+        case ENSEMBLE_UY: src = &uy; break;
+        case ENSEMBLE_DENSITY: src = &rho; break;
+        case ENSEMBLE_TEMPERATURE: src = &temperature; break;
+        default: return nullptr;
+    }
+    if (member < 0 || member >= ENSEMBLE_LANES) return nullptr;
+    for (int i = 0; i < w * h; ++i) memberScratch[i] = (*src)[i * ENSEMBLE_LANES + member];
+    return memberScratch.data();
+}
+
+#ifdef __EMSCRIPTEN__
+val EnsembleEngine::getMemberField(int member, int field) {
+    const float* data = memberField(member, field);
+    if (!data) return val::null();
+    return val(typed_memory_view(w * h, data));
+}
+
+val EnsembleEngine::getBarrierView() {
+    return val(typed_memory_view(w * h, barriers.data()));
+}
+#endif
+
+#ifdef __EMSCRIPTEN__
+EMSCRIPTEN_BINDINGS(ensemble_module) {
+    class_<EnsembleEngine>("EnsembleEngine")
+        .constructor<int, int>()
+        .function("getLaneCount", &EnsembleEngine::getLaneCount)
+        .function("setBoundaryConditions", &EnsembleEngine::setBoundaryConditions)
+        .function("setMemberViscosity", &EnsembleEngine::setMemberViscosity)
+        .function("setMemberInflow", &EnsembleEngine::setMemberInflow)
+        .function("setMemberGravity", &EnsembleEngine::setMemberGravity)
+        .function("setMemberThermal", &EnsembleEngine::setMemberThermal)
+        .function("setMaxVelocity", &EnsembleEngine::setMaxVelocity)
+        .function("addObstacle", &EnsembleEngine::addObstacle)
+        .function("clearObstacles", &EnsembleEngine::clearObstacles)
+        .function("addTemperature", &EnsembleEngine::addTemperature)
+        .function("reset", &EnsembleEngine::reset)
+        .function("step", &EnsembleEngine::step)
+        .function("getMemberField", &EnsembleEngine::getMemberField)
+        .function("getBarrierView", &EnsembleEngine::getBarrierView);
+}
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+
+// Lattice sizes (width, height) whose collision kernels are compiled with the dimensions as
+// constants, so row strides fold into the addressing. An engine constructed at one of these sizes
+// runs the specialised kernel and any other size the one that reads them at run time. Builds can
+// supply their own list with -D'FLUID_GRID_SIZES(X)=X(640, 360) ...'.
+#ifndef FLUID_GRID_SIZES
+#define FLUID_GRID_SIZES(X) X(256, 128) X(512, 256) X(1024, 512) X(2048, 1024)
+#endif
@@ -0,0 +1,212 @@
+#include "halo.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Shared file layout: one 64-byte counter line per rank for exchange generations and one for
+// gather phases, then two parities of bottom/top halo slots per rank, then the gather region.
+static const size_t COUNTER_STRIDE = 64;
+static const int WAIT_TIMEOUT_MS = 60000;
+
+static bool writeAll(int fd, const void* data, size_t size, size_t offset) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, (off_t)offset);
+        if (n <= 0) return false;
+        p += n;
+        size -= (size_t)n;
+        offset += (size_t)n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t size, size_t offset) {
+    uint8_t* p = (uint8_t*)data;
+    while (size > 0) {
+        ssize_t n = pread(fd, p, size, (off_t)offset);
+        if (n <= 0) return false;
+        p += n;
+        size -= (size_t)n;
+        offset += (size_t)n;
+    }
+    return true;
+}
+
+Subdomain::Subdomain(int width, int height, int index, int count, int haloRows, bool wrapY)
+    : w(width), h(height)
+    , rank(index), ranks(std::max(1, count))
+    , periodic(wrapY)
+    , fd(-1)
+    , generation(0)
+    , gatherPhase(0)
+{
+    ownedBegin = (int)((int64_t)rank * h / ranks);
+    ownedEnd = (int)((int64_t)(rank + 1) * h / ranks);
+
+    // Ghost rows are copied from the neighbour's owned rows, so the halo must fit in the smallest
+    // band; an unusable subdomain keeps no ghost rows and never exchanges.
+    bool split = ranks > 1;
+    fits = !split || (haloRows >= 2 && haloRows <= h / ranks);
+    halo = split && fits ? haloRows : 0;
+    rankBelow = rank > 0 ? rank - 1 : (periodic && split ? ranks - 1 : -1);
+    rankAbove = rank < ranks - 1 ? rank + 1 : (periodic && split ? 0 : -1);
+    ghostBelow = rankBelow >= 0 ? halo : 0;
+    ghostAbove = rankAbove >= 0 ? halo : 0;
+
+    local.reset(new FluidEngine(w, ownedEnd - ownedBegin + ghostBelow + ghostAbove));
+    local->setRowOffset(ownedBegin - ghostBelow, periodic ? h : 0);
+
+    slotBytes = (size_t)halo * local->getHaloRowSize() * sizeof(float);
+    slotBase = 2 * (size_t)ranks * COUNTER_STRIDE;
+    gatherBase = slotBase + (size_t)ranks * 4 * slotBytes;
+    rowBuffer.resize((size_t)halo * local->getHaloRowSize());
+}
+
+Subdomain::~Subdomain() {
+    close();
+}
+
+bool Subdomain::usable() const {
+    return fits;
+}
+
+// Every rank opens the same path; it must not hold counters from an earlier run.
+bool Subdomain::open(const std::string& path) {
+    close();
+    if (!fits) return false;
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)(gatherBase + (size_t)w * h * sizeof(float))) != 0) {
+        close();
+        return false;
+    }
+    generation = 0;
+    gatherPhase = 0;
+    return true;
+}
+
+void Subdomain::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+FluidEngine& Subdomain::engine() {
+    return *local;
+}
+
+// Interior edges bounce back on the local lattice, which only ever writes into the ghost row it
+// came from; that row is overwritten by the next exchange before it can reach an owned row.
+void Subdomain::setBoundaryConditions(int left, int right, int top, int bottom) {
+    local->setBoundaryConditions(left, right, ghostAbove ? 1 : top, ghostBelow ? 1 : bottom);
+}
+
+size_t Subdomain::slotOffset(int owner, int side, uint32_t parity) const {
+    return slotBase + ((size_t)(owner * 2 + side) * 2 + parity) * slotBytes;
+}
+
+bool Subdomain::writeCounter(int slot, uint32_t value) {
+    return writeAll(fd, &value, sizeof(value), (size_t)slot * COUNTER_STRIDE);
+}
+
+bool Subdomain::waitCounter(int slot, uint32_t value) {
+    auto start = std::chrono::steady_clock::now();
+    for (int spin = 0;; ++spin) {
+        uint32_t current = 0;
+        if (!readAll(fd, &current, sizeof(current), (size_t)slot * COUNTER_STRIDE)) return false;
+        if (current >= value) return true;
+        if (spin < 1000) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        if (std::chrono::steady_clock::now() - start > std::chrono::milliseconds(WAIT_TIMEOUT_MS)) return false;
+    }
+}
+
+// Publish both edge bands for this generation, then pull the neighbours' bands into the ghost
+// rows. Slots alternate by parity: a rank only reuses one after its neighbours have published the
+// following generation, which they do only once they finished reading this one.
+bool Subdomain::exchange() {
+    if (ranks == 1) return true;
+    if (fd < 0 || halo < local->getHaloRowsNeeded()) return false;
+
+    uint32_t parity = generation & 1;
+    int owned = ownedEnd - ownedBegin;
+    int localHeight = owned + ghostBelow + ghostAbove;
+
+    if (ghostBelow) {
+        local->exportRows(ghostBelow, halo, rowBuffer.data());
+        if (!writeAll(fd, rowBuffer.data(), slotBytes, slotOffset(rank, 0, parity))) return false;
+    }
+    if (ghostAbove) {
+        local->exportRows(ghostBelow + owned - halo, halo, rowBuffer.data());
+        if (!writeAll(fd, rowBuffer.data(), slotBytes, slotOffset(rank, 1, parity))) return false;
+    }
+    if (!writeCounter(rank, generation + 1)) return false;
+
+    if (ghostBelow) {
+        if (!waitCounter(rankBelow, generation + 1)) return false;
+        if (!readAll(fd, rowBuffer.data(), slotBytes, slotOffset(rankBelow, 1, parity))) return false;
+        local->importRows(0, halo, rowBuffer.data());
+    }
+    if (ghostAbove) {
+        if (!waitCounter(rankAbove, generation + 1)) return false;
+        if (!readAll(fd, rowBuffer.data(), slotBytes, slotOffset(rankAbove, 0, parity))) return false;
+        local->importRows(localHeight - halo, halo, rowBuffer.data());
+    }
+    generation++;
+    return true;
+}
+
+bool Subdomain::step(int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+        if (!exchange()) return false;
+        local->step(1);
+    }
+    return true;
+}
+
+// Collective: every rank must call it with the same field. Assembles the owned rows of all ranks
+// into `out` (width * height) on every rank.
+bool Subdomain::gather(int codecField, std::vector<float>& out) {
+    const std::vector<float>* src = local->codecSource(codecField);
+    if (!src) return false;
+    out.resize((size_t)w * h);
+    if (fd < 0) {
+        if (ranks != 1) return false;
+        std::copy(src->begin(), src->end(), out.begin());
+        return true;
+    }
+
+    size_t rowBytes = (size_t)w * sizeof(float);
+    if (!writeAll(fd, src->data() + (size_t)ghostBelow * w, (size_t)(ownedEnd - ownedBegin) * rowBytes,
+                  gatherBase + (size_t)ownedBegin * rowBytes)) return false;
+
+    if (!writeCounter(ranks + rank, ++gatherPhase)) return false;
+    for (int r = 0; r < ranks; ++r) {
+        if (!waitCounter(ranks + r, gatherPhase)) return false;
+    }
+    if (!readAll(fd, out.data(), (size_t)h * rowBytes, gatherBase)) return false;
+
+    // Second phase keeps a fast rank from overwriting the region while others still read it.
+    if (!writeCounter(ranks + rank, ++gatherPhase)) return false;
+    for (int r = 0; r < ranks; ++r) {
+        if (!waitCounter(ranks + r, gatherPhase)) return false;
+    }
+    return true;
+}
+
+int Subdomain::getOwnedBegin() const {
+    return ownedBegin;
+}
+
+int Subdomain::getOwnedEnd() const {
+    return ownedEnd;
+}
+
+int Subdomain::localRow(int globalY) const {
+    return globalY - ownedBegin + ghostBelow;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "engine.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// One horizontal band of a lattice split across processes on the same host. Each band owns
+// rows [ownedBegin, ownedEnd) of the global lattice and keeps `halo` ghost rows on every interior
+// edge, refreshed before each iteration from the neighbouring band through a shared file
+// (/dev/shm gives POSIX shared memory on Linux). Plain pread/pwrite keeps the transport usable
+// from Node tools built with NODERAWFS as well as native builds. Two halo rows reproduce the
+// undivided lattice exactly; BFECC and vorticity confinement reach further and need four. A halo
+// that does not fit inside every band makes the subdomain unusable, and exchange() refuses to run
+// with fewer rows than the engine's current settings need (FluidEngine::getHaloRowsNeeded). With a
+// periodic y axis the seam rows take the interior kernel instead of the edge one, so the result
+// agrees only to rounding.
+class Subdomain {
+public:
+    Subdomain(int width, int height, int index, int count, int haloRows, bool wrapY);
+    ~Subdomain();
+
+    bool usable() const;
+    bool open(const std::string& path);
+    void close();
+    FluidEngine& engine();
+
+    void setBoundaryConditions(int left, int right, int top, int bottom);
+    bool exchange();
+    bool step(int iterations);
+    bool gather(int codecField, std::vector<float>& out);
+
+    int getOwnedBegin() const;
+    int getOwnedEnd() const;
+    int localRow(int globalY) const;
+
+private:
+    int w, h;
+    int rank, ranks;
+    int halo;
+    bool periodic;
+    bool fits;
+    int ownedBegin, ownedEnd;
+    int ghostBelow, ghostAbove;
+    int rankBelow, rankAbove;
+    int fd;
+    uint32_t generation;
+    uint32_t gatherPhase;
+    size_t slotBytes;
+    size_t slotBase;
+    size_t gatherBase;
+    std::unique_ptr<FluidEngine> local;
+    std::vector<float> rowBuffer;
+
+    size_t slotOffset(int owner, int side, uint32_t parity) const;
+    bool writeCounter(int slot, uint32_t value);
+    bool waitCounter(int slot, uint32_t value);
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+// D2Q9 lattice: velocity set, opposite and slip-mirror directions, and equilibrium weights.
+const int slip_h[9] = {0, 1, 4, 3, 2, 8, 7, 6, 5};
+const int slip_v[9] = {0, 3, 2, 1, 4, 6, 5, 8, 7};
+const int cx[9] = {0, 1, 0, -1, 0, 1, -1, -1, 1};
+const int cy[9] = {0, 0, 1, 0, -1, 1, 1, -1, -1};
+const int opp[9] = {0, 3, 4, 1, 2, 7, 8, 5, 6};
+const float weights[9] = {4.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f, 1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f};
@@ -0,0 +1,215 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#endif
+// SIMD_AVX2 and SIMD_AVX512 turn on the wide vectors. The compiler's -m flags set them, and so does
+// a unit that raises the instruction set for its own code with #pragma GCC target, which leaves
+// the target macros unset in C++ (collide_avx2.cpp, collide_avx512.cpp).
+#if defined(__AVX2__) && !defined(SIMD_AVX2)
+#define SIMD_AVX2
+#endif
+#if defined(__AVX512F__) && !defined(SIMD_AVX512)
+#define SIMD_AVX512
+#endif
+#if defined(SIMD_AVX2) || defined(SIMD_AVX512)
+#include <immintrin.h>
+#endif
+
+// Fixed-width float vectors for the lattice kernels. Vec<N> holds N floats and Mask<N> the result
+// of a comparison. Four lanes map to WASM SIMD128 or SSE, eight to AVX2 and sixteen to AVX-512
+// when the translation unit is compiled for them; any other width falls back to plain arrays.
+// Everything sits in an unnamed namespace, so units built for different instruction sets each
+// keep their own copy instead of sharing one through the linker.
+namespace simd {
+namespace {
+
+template <int N> struct Vec { float lane[N]; };
+template <int N> struct Mask { uint32_t lane[N]; };
+
+template <int N> inline Vec<N> splat(float s) {
+    Vec<N> r;
+    for (int i = 0; i < N; ++i) r.lane[i] = s;
+    return r;
+}
+
+template <int N> inline Vec<N> load(const float* p) {
+    Vec<N> r;
+    for (int i = 0; i < N; ++i) r.lane[i] = p[i];
+    return r;
+}
+
+template <int N> inline void store(float* p, Vec<N> a) {
+    for (int i = 0; i < N; ++i) p[i] = a.lane[i];
+}
+
+#define SIMD_PORTABLE_BINARY(name, expr)                                   \
+    template <int N> inline Vec<N> name(Vec<N> a, Vec<N> b) {              \
+        Vec<N> r;                                                          \
+        for (int i = 0; i < N; ++i) {                                      \
+            float x = a.lane[i], y = b.lane[i];                            \
+            r.lane[i] = (expr);                                            \
+        }                                                                  \
+        return r;                                                          \
+    }
+SIMD_PORTABLE_BINARY(add, x + y)
+SIMD_PORTABLE_BINARY(sub, x - y)
+SIMD_PORTABLE_BINARY(mul, x * y)
+SIMD_PORTABLE_BINARY(div, x / y)
+SIMD_PORTABLE_BINARY(min, y < x ? y : x)
+SIMD_PORTABLE_BINARY(max, x < y ? y : x)
+#undef SIMD_PORTABLE_BINARY
+
+template <int N> inline Vec<N> sqrt(Vec<N> a) {
+    for (int i = 0; i < N; ++i) a.lane[i] = std::sqrt(a.lane[i]);
+    return a;
+}
+
+template <int N> inline Mask<N> gt(Vec<N> a, Vec<N> b) {
+    Mask<N> m;
+    for (int i = 0; i < N; ++i) m.lane[i] = a.lane[i] > b.lane[i] ? 0xFFFFFFFFu : 0u;
+    return m;
+}
+
+// Lanes of a where the mask is set, lanes of b elsewhere.
+template <int N> inline Vec<N> select(Mask<N> m, Vec<N> a, Vec<N> b) {
+    for (int i = 0; i < N; ++i) {
+        if (m.lane[i]) b.lane[i] = a.lane[i];
+    }
+    return b;
+}
+
+template <int N> inline bool anyTrue(Mask<N> m) {
+    uint32_t any = 0;
+    for (int i = 0; i < N; ++i) any |= m.lane[i];
+    return any != 0;
+}
+
+// 1.0f in every set lane, so masks can be counted with add().
+template <int N> inline Vec<N> ones(Mask<N> m) {
+    Vec<N> r;
+    for (int i = 0; i < N; ++i) r.lane[i] = m.lane[i] ? 1.0f : 0.0f;
+    return r;
+}
+
+#if defined(__wasm_simd128__)
+template <> struct Vec<4> { v128_t v; };
+template <> struct Mask<4> { v128_t v; };
+
+template <> inline Vec<4> splat<4>(float s) { return { wasm_f32x4_splat(s) }; }
+template <> inline Vec<4> load<4>(const float* p) { return { wasm_v128_load(p) }; }
+template <> inline void store<4>(float* p, Vec<4> a) { wasm_v128_store(p, a.v); }
+inline Vec<4> add(Vec<4> a, Vec<4> b) { return { wasm_f32x4_add(a.v, b.v) }; }
+inline Vec<4> sub(Vec<4> a, Vec<4> b) { return { wasm_f32x4_sub(a.v, b.v) }; }
+inline Vec<4> mul(Vec<4> a, Vec<4> b) { return { wasm_f32x4_mul(a.v, b.v) }; }
+inline Vec<4> div(Vec<4> a, Vec<4> b) { return { wasm_f32x4_div(a.v, b.v) }; }
+inline Vec<4> min(Vec<4> a, Vec<4> b) { return { wasm_f32x4_min(a.v, b.v) }; }
+inline Vec<4> max(Vec<4> a, Vec<4> b) { return { wasm_f32x4_max(a.v, b.v) }; }
+inline Vec<4> sqrt(Vec<4> a) { return { wasm_f32x4_sqrt(a.v) }; }
+inline Mask<4> gt(Vec<4> a, Vec<4> b) { return { wasm_f32x4_gt(a.v, b.v) }; }
+#if defined(__wasm_relaxed_simd__)
+inline Vec<4> select(Mask<4> m, Vec<4> a, Vec<4> b) { return { wasm_i32x4_relaxed_laneselect(a.v, b.v, m.v) }; }
+#else
+inline Vec<4> select(Mask<4> m, Vec<4> a, Vec<4> b) { return { wasm_v128_bitselect(a.v, b.v, m.v) }; }
+#endif
+inline bool anyTrue(Mask<4> m) { return wasm_v128_any_true(m.v); }
+inline Vec<4> ones(Mask<4> m) { return { wasm_v128_and(m.v, wasm_f32x4_splat(1.0f)) }; }
+#elif defined(__SSE2__)
+template <> struct Vec<4> { __m128 v; };
+template <> struct Mask<4> { __m128 v; };
+
+template <> inline Vec<4> splat<4>(float s) { return { _mm_set1_ps(s) }; }
+template <> inline Vec<4> load<4>(const float* p) { return { _mm_loadu_ps(p) }; }
+template <> inline void store<4>(float* p, Vec<4> a) { _mm_storeu_ps(p, a.v); }
+inline Vec<4> add(Vec<4> a, Vec<4> b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Vec<4> sub(Vec<4> a, Vec<4> b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Vec<4> mul(Vec<4> a, Vec<4> b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Vec<4> div(Vec<4> a, Vec<4> b) { return { _mm_div_ps(a.v, b.v) }; }
+inline Vec<4> min(Vec<4> a, Vec<4> b) { return { _mm_min_ps(b.v, a.v) }; }
+inline Vec<4> max(Vec<4> a, Vec<4> b) { return { _mm_max_ps(b.v, a.v) }; }
+inline Vec<4> sqrt(Vec<4> a) { return { _mm_sqrt_ps(a.v) }; }
+inline Mask<4> gt(Vec<4> a, Vec<4> b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+#if defined(__SSE4_1__)
+inline Vec<4> select(Mask<4> m, Vec<4> a, Vec<4> b) { return { _mm_blendv_ps(b.v, a.v, m.v) }; }
+#else
+inline Vec<4> select(Mask<4> m, Vec<4> a, Vec<4> b) {
+    return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) };
+}
+#endif
+inline bool anyTrue(Mask<4> m) { return _mm_movemask_ps(m.v) != 0; }
+inline Vec<4> ones(Mask<4> m) { return { _mm_and_ps(m.v, _mm_set1_ps(1.0f)) }; }
+#endif
+
+#if defined(SIMD_AVX2)
+template <> struct Vec<8> { __m256 v; };
+template <> struct Mask<8> { __m256 v; };
+
+template <> inline Vec<8> splat<8>(float s) { return { _mm256_set1_ps(s) }; }
+template <> inline Vec<8> load<8>(const float* p) { return { _mm256_loadu_ps(p) }; }
+template <> inline void store<8>(float* p, Vec<8> a) { _mm256_storeu_ps(p, a.v); }
+inline Vec<8> add(Vec<8> a, Vec<8> b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Vec<8> sub(Vec<8> a, Vec<8> b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Vec<8> mul(Vec<8> a, Vec<8> b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Vec<8> div(Vec<8> a, Vec<8> b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline Vec<8> min(Vec<8> a, Vec<8> b) { return { _mm256_min_ps(b.v, a.v) }; }
+inline Vec<8> max(Vec<8> a, Vec<8> b) { return { _mm256_max_ps(b.v, a.v) }; }
+inline Vec<8> sqrt(Vec<8> a) { return { _mm256_sqrt_ps(a.v) }; }
+inline Mask<8> gt(Vec<8> a, Vec<8> b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline Vec<8> select(Mask<8> m, Vec<8> a, Vec<8> b) { return { _mm256_blendv_ps(b.v, a.v, m.v) }; }
+inline bool anyTrue(Mask<8> m) { return _mm256_movemask_ps(m.v) != 0; }
+inline Vec<8> ones(Mask<8> m) { return { _mm256_and_ps(m.v, _mm256_set1_ps(1.0f)) }; }
+#endif
+
+#if defined(SIMD_AVX512)
+template <> struct Vec<16> { __m512 v; };
+template <> struct Mask<16> { __mmask16 v; };
+
+template <> inline Vec<16> splat<16>(float s) { return { _mm512_set1_ps(s) }; }
+template <> inline Vec<16> load<16>(const float* p) { return { _mm512_loadu_ps(p) }; }
+template <> inline void store<16>(float* p, Vec<16> a) { _mm512_storeu_ps(p, a.v); }
+inline Vec<16> add(Vec<16> a, Vec<16> b) { return { _mm512_add_ps(a.v, b.v) }; }
+inline Vec<16> sub(Vec<16> a, Vec<16> b) { return { _mm512_sub_ps(a.v, b.v) }; }
+inline Vec<16> mul(Vec<16> a, Vec<16> b) { return { _mm512_mul_ps(a.v, b.v) }; }
+inline Vec<16> div(Vec<16> a, Vec<16> b) { return { _mm512_div_ps(a.v, b.v) }; }
+inline Vec<16> min(Vec<16> a, Vec<16> b) { return { _mm512_min_ps(b.v, a.v) }; }
+inline Vec<16> max(Vec<16> a, Vec<16> b) { return { _mm512_max_ps(b.v, a.v) }; }
+inline Vec<16> sqrt(Vec<16> a) { return { _mm512_sqrt_ps(a.v) }; }
+inline Mask<16> gt(Vec<16> a, Vec<16> b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+inline Vec<16> select(Mask<16> m, Vec<16> a, Vec<16> b) { return { _mm512_mask_blend_ps(m.v, b.v, a.v) }; }
+inline bool anyTrue(Mask<16> m) { return m.v != 0; }
+inline Vec<16> ones(Mask<16> m) { return { _mm512_maskz_mov_ps(m.v, _mm512_set1_ps(1.0f)) }; }
+#endif
+
+// a * b + c. Relaxed-SIMD WebAssembly builds may fuse it into one rounding; every other build
+// rounds the product and the sum separately, so native widths keep matching the baseline module.
+template <int N> inline Vec<N> madd(Vec<N> a, Vec<N> b, Vec<N> c) { return add(mul(a, b), c); }
+#if defined(__wasm_relaxed_simd__)
+inline Vec<4> madd(Vec<4> a, Vec<4> b, Vec<4> c) { return { wasm_f32x4_relaxed_madd(a.v, b.v, c.v) }; }
+#endif
+
+// Lane-ordered horizontal reductions; the sum accumulates in double.
+template <int N> inline double sumLanes(Vec<N> a) {
+    float lanes[N];
+    store<N>(lanes, a);
+    double s = lanes[0];
+    for (int i = 1; i < N; ++i) s += lanes[i];
+    return s;
+}
+
+template <int N> inline float maxLanes(Vec<N> a) {
+    float lanes[N];
+    store<N>(lanes, a);
+    float m = lanes[0];
+    for (int i = 1; i < N; ++i) m = std::max(m, lanes[i]);
+    return m;
+}
+
+}
+}
@@ -0,0 +1,119 @@
+// Snapshot codec benchmark: compression ratio, codec throughput and write time against raw fwrite.
+// Build and run with `make bench` (Node, NODERAWFS). Arguments: [width height steps threads outDir]
+#include "../src/engine.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+const char* const FIELD_NAMES[CODEC_FIELD_COUNT] = {
+    "f0", "f1", "f2", "f3", "f4", "f5", "f6", "f7", "f8",
+    "ux", "uy", "rho", "dye", "temperature", "porosity"
+};
+
+struct Mode {
+    const char* name;
+    int mode;
+    float errorBound;
+};
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 512;
+    int height = argc > 2 ? std::atoi(argv[2]) : 256;
+    int steps = argc > 3 ? std::atoi(argv[3]) : 400;
+    int threads = argc > 4 ? std::atoi(argv[4]) : 4;
+    std::string outPath = std::string(argc > 5 ? argv[5] : "/tmp") + "/codec_bench.bin";
+
+    FluidEngine engine(width, height);
+    engine.setThreadCount(threads);
+    engine.setViscosity(0.02f);
+    engine.setBoundaryConditions(4, 5, 1, 1);
+    engine.setInflowProperties(0.1f, 0.0f, 1.0f);
+    engine.setInflowTurbulence(0.05f, 8.0f);
+    engine.setSmagorinskyConstant(0.1f);
+    engine.addObstacle(width / 4, height / 2, height / 10, false, 0, 1, 0);
+    for (int i = 0; i < steps; ++i) {
+        engine.applyGenericBrush(8, height / 2, height / 16, 0, 0, 1.0f, 0.5f, 0.5f, 0, 1, 0, 0);
+        engine.step(1);
+    }
+
+    const Mode modes[] = {
+        { "raw", COMPRESS_NONE, 0.0f },
+        { "lossless", COMPRESS_LOSSLESS, 0.0f },
+        { "lossy 1e-3", COMPRESS_LOSSY, 1e-3f },
+        { "lossy 1e-5", COMPRESS_LOSSY, 1e-5f },
+    };
+
+    size_t rawBytes = (size_t)width * height * sizeof(float);
+    std::vector<uint8_t> encoded;
+    std::vector<float> decoded;
+    std::printf("%dx%d, %d steps, %d threads, %d fields\n", width, height, steps, threads, CODEC_FIELD_COUNT);
+    std::printf("%-12s %8s %12s %12s %12s %12s\n", "mode", "ratio", "encode GB/s", "decode GB/s", "write GB/s", "max error");
+
+    for (const Mode& m : modes) {
+        size_t totalRaw = 0, totalStored = 0;
+        double encodeTime = 0.0, decodeTime = 0.0, writeTime = 0.0, maxError = 0.0;
+        bool exact = true;
+        FILE* file = std::fopen(outPath.c_str(), "wb");
+        if (!file) {
+            std::fprintf(stderr, "cannot open %s\n", outPath.c_str());
+            return 1;
+        }
+        for (int field = 0; field < CODEC_FIELD_COUNT; ++field) {
+            const std::vector<float>& src = *engine.codecSource(field);
+            const void* payload = src.data();
+            size_t payloadBytes = rawBytes;
+
+            if (m.mode != COMPRESS_NONE) {
+                Clock::time_point start = Clock::now();
+                engine.compressFieldTo(field, m.mode, m.errorBound, encoded);
+                encodeTime += seconds(start);
+
+                start = Clock::now();
+                if (!engine.decompressFieldTo(encoded.data(), encoded.size(), decoded)) {
+                    std::fprintf(stderr, "%s: decode failed for %s\n", m.name, FIELD_NAMES[field]);
+                    return 1;
+                }
+                decodeTime += seconds(start);
+
+                for (size_t i = 0; i < src.size(); ++i) {
+                    double err = std::fabs((double)decoded[i] - (double)src[i]);
+                    if (err > maxError) maxError = err;
+                    if (decoded[i] != src[i]) exact = false;
+                }
+                payload = encoded.data();
+                payloadBytes = encoded.size();
+            }
+
+            Clock::time_point start = Clock::now();
+            std::fwrite(payload, 1, payloadBytes, file);
+            std::fflush(file);
+            writeTime += seconds(start);
+            totalRaw += rawBytes;
+            totalStored += payloadBytes;
+        }
+        std::fclose(file);
+
+        double gb = totalRaw / 1e9;
+        std::printf("%-12s %8.2f %12.2f %12.2f %12.2f %12.3g%s\n", m.name,
+                    (double)totalRaw / totalStored,
+                    encodeTime > 0.0 ? gb / encodeTime : 0.0,
+                    decodeTime > 0.0 ? gb / decodeTime : 0.0,
+                    gb / writeTime, maxError,
+                    (m.mode == COMPRESS_LOSSLESS && !exact) ? "  MISMATCH" : "");
+        if (m.mode == COMPRESS_LOSSLESS && !exact) return 1;
+        if (m.mode == COMPRESS_LOSSY && maxError > m.errorBound) return 1;
+    }
+    std::remove(outPath.c_str());
+    return 0;
+}
@@ -0,0 +1,132 @@
+// Coarsest stable lattice per collision model: flow past a cylinder in a channel at a fixed Reynolds
+// number, refined from coarse to fine until a run survives the given number of flow-throughs. Prints
+// the cells, MLUPS and wall time of that run, what each model saves against BGK, and the throughput
+// of every model on one grid for the per-update cost of the collision.
+// Build and run with `make collision-bench`. Arguments: [reynolds flowThroughs threads]
+#include "../src/engine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+const int HEIGHTS[] = {24, 32, 48, 64, 96, 128, 192, 256, 384};
+const int HEIGHT_COUNT = (int)(sizeof(HEIGHTS) / sizeof(HEIGHTS[0]));
+const float INFLOW = 0.1f;
+const int CHECK_INTERVAL = 200;
+const char* const MODEL_NAMES[COLLISION_MODEL_COUNT] = {"bgk", "regularized"};
+
+struct Run {
+    int width;
+    int height;
+    long steps;
+    bool stable;
+    double seconds;
+};
+
+// Fast-math builds may fold NaN comparisons away, so non-finite values are caught by their
+// exponent bits.
+bool bounded(const std::vector<float>& values, float limit) {
+    for (float v : values) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, 4);
+        if ((bits & 0x7F800000u) == 0x7F800000u || std::fabs(v) > limit) return false;
+    }
+    return true;
+}
+
+// A diverging run either overflows or drives the velocity into the engine's limit; both end it.
+Run simulate(int model, int height, float reynolds, float flowThroughs, int threads) {
+    Run run;
+    run.height = height;
+    run.width = 4 * height;
+    run.steps = (long)(flowThroughs * run.width / INFLOW);
+    int radius = height / 10;
+
+    FluidEngine engine(run.width, run.height);
+    engine.setThreadCount(threads);
+    engine.setCollisionModel(model);
+    engine.setViscosity(INFLOW * 2.0f * radius / reynolds);
+    engine.setBoundaryConditions(4, 5, 1, 1);
+    engine.setInflowProperties(INFLOW, 0.0f, 1.0f);
+    engine.addObstacle(run.width / 4, height / 2 + 1, radius, false, 0, 1, 0);
+
+    run.stable = true;
+    auto start = Clock::now();
+    for (long done = 0; done < run.steps && run.stable; done += CHECK_INTERVAL) {
+        engine.step((int)std::min<long>(CHECK_INTERVAL, run.steps - done));
+        run.stable = bounded(*engine.codecSource(CODEC_RHO), 2.0f) &&
+                     bounded(*engine.codecSource(CODEC_UX), 0.5f) &&
+                     bounded(*engine.codecSource(CODEC_UY), 0.5f);
+    }
+    run.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return run;
+}
+
+double throughput(int model, int width, int height, int steps, int threads) {
+    FluidEngine engine(width, height);
+    engine.setThreadCount(threads);
+    engine.setCollisionModel(model);
+    engine.setViscosity(0.02f);
+    engine.setBoundaryConditions(4, 5, 1, 1);
+    engine.setInflowProperties(INFLOW, 0.0f, 1.0f);
+    engine.addObstacle(width / 4, height / 2, height / 10, false, 0, 1, 0);
+    engine.step(10);
+    auto start = Clock::now();
+    engine.step(steps);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return seconds > 0.0 ? (double)steps * width * height / seconds / 1e6 : 0.0;
+}
+}
+
+int main(int argc, char** argv) {
+    float reynolds = argc > 1 ? (float)std::atof(argv[1]) : 1000.0f;
+    float flowThroughs = argc > 2 ? (float)std::atof(argv[2]) : 1.0f;
+    int threads = argc > 3 ? std::atoi(argv[3]) : 1;
+
+    std::printf("cylinder at Re %.0f, %.1f flow-throughs, %d threads\n", reynolds, flowThroughs, threads);
+    Run coarsest[COLLISION_MODEL_COUNT];
+    for (int model = 0; model < COLLISION_MODEL_COUNT; ++model) {
+        coarsest[model].stable = false;
+        for (int i = 0; i < HEIGHT_COUNT && !coarsest[model].stable; ++i) {
+            Run run = simulate(model, HEIGHTS[i], reynolds, flowThroughs, threads);
+            std::printf("%-12s %5dx%-4d tau %.4f  %s\n", MODEL_NAMES[model], run.width, run.height,
+                        3.0f * INFLOW * 2.0f * (run.height / 10) / reynolds + 0.5f,
+                        run.stable ? "stable" : "diverged");
+            coarsest[model] = run;
+        }
+    }
+
+    std::printf("\n%-12s %10s %8s %10s %10s %8s %8s\n", "model", "grid", "cells", "steps", "MLUPS", "seconds",
+                "saved");
+    const Run& bgk = coarsest[COLLISION_BGK];
+    for (int model = 0; model < COLLISION_MODEL_COUNT; ++model) {
+        const Run& run = coarsest[model];
+        char grid[32];
+        std::snprintf(grid, sizeof(grid), "%dx%d", run.width, run.height);
+        if (!run.stable) {
+            std::printf("%-12s %10s  no stable grid up to height %d\n", MODEL_NAMES[model], "-",
+                        HEIGHTS[HEIGHT_COUNT - 1]);
+            continue;
+        }
+        double cells = (double)run.width * run.height;
+        double mlups = run.seconds > 0.0 ? cells * run.steps / run.seconds / 1e6 : 0.0;
+        std::printf("%-12s %10s %8.0f %10ld %10.1f %8.2f", MODEL_NAMES[model], grid, cells, run.steps, mlups,
+                    run.seconds);
+        if (bgk.stable && run.seconds > 0.0) std::printf(" %7.1fx", bgk.seconds / run.seconds);
+        std::printf("\n");
+    }
+
+    double mlups[COLLISION_MODEL_COUNT];
+    for (int model = 0; model < COLLISION_MODEL_COUNT; ++model) mlups[model] = throughput(model, 1024, 256, 200, threads);
+    std::printf("\nsame grid, 1024x256:");
+    for (int model = 0; model < COLLISION_MODEL_COUNT; ++model) std::printf("  %s %.1f MLUPS", MODEL_NAMES[model], mlups[model]);
+    std::printf("\n");
+    return 0;
+}
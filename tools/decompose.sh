@@ -0,0 +1,33 @@
+#!/bin/sh
+# Runs tools/decompose.cpp split across several processes that share a file in /dev/shm and checks
+# the gathered state hash against an undivided run of the same case.
+# Usage: tools/decompose.sh [ranks] [width height steps halo threads]
+# DECOMPOSE_TOOL overrides the command (default: node temp_build/decompose.js).
+TOOL=${DECOMPOSE_TOOL:-"node temp_build/decompose.js"}
+RANKS=${1:-4}
+[ $# -gt 0 ] && shift
+SHM=/dev/shm/fluid-decompose-$$
+
+rm -f "$SHM"
+REFERENCE=$($TOOL "$SHM" 0 1 "$@" | grep "state hash") || exit 1
+
+PIDS=""
+r=0
+while [ $r -lt "$RANKS" ]; do
+    $TOOL "$SHM" $r "$RANKS" "$@" > "$SHM.$r.log" &
+    PIDS="$PIDS $!"
+    r=$((r + 1))
+done
+STATUS=0
+for pid in $PIDS; do
+    wait "$pid" || STATUS=1
+done
+cat "$SHM".*.log | grep -v "state hash"
+SPLIT=$(grep "state hash" "$SHM.0.log")
+rm -f "$SHM" "$SHM".*.log
+[ $STATUS -eq 0 ] || { echo "a rank failed"; exit 1; }
+
+echo "reference $REFERENCE"
+echo "split     $SPLIT"
+[ "$REFERENCE" = "$SPLIT" ] || { echo "mismatch"; exit 1; }
+echo "match"
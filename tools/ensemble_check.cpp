@@ -0,0 +1,135 @@
+// Ensemble lane check: two sweeps run once in an EnsembleEngine, one lane per parameter value, and
+// once per lane in a FluidEngine with the same settings. The viscosity sweep is flow past a cylinder
+// in a channel; the thermal expansion sweep is a warm blob rising in a closed box under gravity.
+// Prints the RMS and peak velocity (and temperature) difference of each lane against its FluidEngine
+// run, and the time of the ensemble step against the lanes stepped one after another, each
+// FluidEngine on one thread like the ensemble.
+// Build and run with `make ensemble-check`. Arguments: [width height steps]
+#include "../src/engine.h"
+#include "../src/ensemble.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+const float INFLOW = 0.1f;
+const float GRAVITY = -1e-4f;
+const float REFERENCE_TEMPERATURE = 0.1f;
+const float DIFFUSIVITY = 1e-3f;
+
+float laneViscosity(int lane) {
+    return 0.02f + 0.01f * lane;
+}
+
+float laneExpansion(int lane) {
+    return 0.5f + 0.25f * lane;
+}
+
+double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Difference {
+    double sum = 0.0, peak = 0.0;
+    void add(double d) {
+        sum += d * d;
+        peak = std::max(peak, d);
+    }
+};
+
+void setupEnsemble(EnsembleEngine& ensemble, bool thermal, int width, int height) {
+    if (!thermal) {
+        ensemble.setBoundaryConditions(4, 5, 1, 1);
+        for (int lane = 0; lane < ENSEMBLE_LANES; ++lane) {
+            ensemble.setMemberViscosity(lane, laneViscosity(lane));
+            ensemble.setMemberInflow(lane, INFLOW, 0.0f);
+        }
+        ensemble.addObstacle(width / 4, height / 2, height / 10);
+        return;
+    }
+    ensemble.setBoundaryConditions(1, 1, 1, 1);
+    for (int lane = 0; lane < ENSEMBLE_LANES; ++lane) {
+        ensemble.setMemberViscosity(lane, laneViscosity(0));
+        ensemble.setMemberGravity(lane, 0.0f, GRAVITY);
+        ensemble.setMemberThermal(lane, laneExpansion(lane), REFERENCE_TEMPERATURE, DIFFUSIVITY);
+    }
+    ensemble.addTemperature(width / 2, height / 4, height / 8, 1.0f);
+}
+
+void setupEngine(FluidEngine& engine, bool thermal, int lane, int width, int height) {
+    if (!thermal) {
+        engine.setViscosity(laneViscosity(lane));
+        engine.setBoundaryConditions(4, 5, 1, 1);
+        engine.setInflowProperties(INFLOW, 0.0f, 1.0f);
+        engine.addObstacle(width / 4, height / 2, height / 10, false, 0, 1, 0);
+        return;
+    }
+    engine.setViscosity(laneViscosity(0));
+    engine.setBoundaryConditions(1, 1, 1, 1);
+    engine.setGravity(0.0f, GRAVITY);
+    engine.setThermalProperties(laneExpansion(lane), REFERENCE_TEMPERATURE);
+    engine.setThermalDiffusivity(DIFFUSIVITY);
+    int radius = height / 8;
+    for (int dy = -radius; dy <= radius; ++dy)
+        for (int dx = -radius; dx <= radius; ++dx)
+            if (dx * dx + dy * dy <= radius * radius) engine.addTemperature(width / 2 + dx, height / 4 + dy, 1.0f);
+}
+
+void sweep(bool thermal, int width, int height, int steps) {
+    size_t cells = (size_t)width * height;
+    EnsembleEngine ensemble(width, height);
+    setupEnsemble(ensemble, thermal, width, height);
+    auto start = Clock::now();
+    ensemble.step(steps);
+    double ensembleSeconds = seconds(start);
+
+    std::printf("%s sweep\n", thermal ? "thermal expansion" : "viscosity");
+    std::printf("%-6s %10s %12s %12s %12s\n", "lane", thermal ? "expansion" : "viscosity", "rms |du|", "max |du|",
+                "max |dT|");
+    double singleSeconds = 0.0;
+    for (int lane = 0; lane < ENSEMBLE_LANES; ++lane) {
+        FluidEngine engine(width, height);
+        engine.setThreadCount(1);
+        setupEngine(engine, thermal, lane, width, height);
+        start = Clock::now();
+        engine.step(steps);
+        singleSeconds += seconds(start);
+
+        const std::vector<float>& ux = *engine.codecSource(CODEC_UX);
+        const std::vector<float>& uy = *engine.codecSource(CODEC_UY);
+        const std::vector<float>& temperature = *engine.codecSource(CODEC_TEMPERATURE);
+        // memberField reuses one buffer, so each field is copied out before the next is read.
+        const float* field = ensemble.memberField(lane, ENSEMBLE_UX);
+        std::vector<float> laneUx(field, field + cells);
+        field = ensemble.memberField(lane, ENSEMBLE_TEMPERATURE);
+        std::vector<float> laneT(field, field + cells);
+        const float* laneUy = ensemble.memberField(lane, ENSEMBLE_UY);
+        Difference velocity, heat;
+        for (size_t i = 0; i < cells; ++i) {
+            velocity.add(std::hypot((double)laneUx[i] - ux[i], (double)laneUy[i] - uy[i]));
+            heat.add(std::fabs((double)laneT[i] - temperature[i]));
+        }
+        std::printf("%-6d %10.3f %12.2e %12.2e %12.2e\n", lane, thermal ? laneExpansion(lane) : laneViscosity(lane),
+                    std::sqrt(velocity.sum / cells), velocity.peak, heat.peak);
+    }
+
+    std::printf("ensemble %.2f s, FluidEngine per lane %.2f s, speedup %.1fx\n\n", ensembleSeconds, singleSeconds,
+                ensembleSeconds > 0.0 ? singleSeconds / ensembleSeconds : 0.0);
+}
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 256;
+    int height = argc > 2 ? std::atoi(argv[2]) : 64;
+    int steps = argc > 3 ? std::atoi(argv[3]) : 2000;
+
+    std::printf("%dx%d, %d steps, %d lanes\n\n", width, height, steps, ENSEMBLE_LANES);
+    sweep(false, width, height, steps);
+    sweep(true, width, height, steps);
+    return 0;
+}
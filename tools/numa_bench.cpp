@@ -0,0 +1,58 @@
+// Thread placement benchmark: MLUPS and per-memory-node read bandwidth of the population arrays
+// with the default placement and with pinned workers plus first-touch field bands. Pinning needs a
+// native Linux build; elsewhere both rows use the default placement.
+// Build and run with `make numa-bench`. Arguments: [width height steps threads]
+#include "../src/engine.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+void setupCase(FluidEngine& engine, int width, int height) {
+    engine.setViscosity(0.02f);
+    engine.setBoundaryConditions(4, 5, 1, 1);
+    engine.setInflowProperties(0.1f, 0.0f, 1.0f);
+    engine.setSmagorinskyConstant(0.1f);
+    engine.addObstacle(width / 4, height / 2, height / 10, false, 0, 1, 0);
+}
+
+void report(const char* label, FluidEngine& engine, int width, int height, int steps) {
+    engine.step(10);
+    auto start = Clock::now();
+    engine.step(steps);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::vector<double> nodes = engine.measureNodeBandwidth(20);
+
+    std::printf("%-8s %8.1f MLUPS ", label, seconds > 0.0 ? (double)steps * width * height / seconds / 1e6 : 0.0);
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        if (nodes[n] > 0.0) std::printf("  node%zu %.2f GB/s", n, nodes[n]);
+    }
+    std::printf("\n");
+}
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 2048;
+    int height = argc > 2 ? std::atoi(argv[2]) : 1024;
+    int steps = argc > 3 ? std::atoi(argv[3]) : 200;
+    int threads = argc > 4 ? std::atoi(argv[4]) : 8;
+
+    std::printf("%dx%d, %d steps, %d threads\n", width, height, steps, threads);
+    {
+        FluidEngine engine(width, height);
+        engine.setThreadCount(threads);
+        setupCase(engine, width, height);
+        report("default", engine, width, height, steps);
+    }
+    {
+        FluidEngine engine(width, height);
+        engine.setThreadCount(threads);
+        bool pinned = engine.setNumaPlacement(true);
+        setupCase(engine, width, height);
+        report(pinned ? "pinned" : "unpinned", engine, width, height, steps);
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+// Collision kernel throughput of this build: MLUPS for a plain BGK channel and for the same
+// channel with Smagorinsky and buoyancy. Build and run both WebAssembly variants with
+// `make simd-bench`. Arguments: [width height steps threads]
+#include "../src/engine.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+#if defined(__wasm_relaxed_simd__)
+const char* const VARIANT = "relaxed-simd";
+#elif defined(__wasm_simd128__)
+const char* const VARIANT = "simd128";
+#else
+const char* const VARIANT = "native";
+#endif
+
+void run(const char* label, bool turbulent, int width, int height, int steps, int threads) {
+    FluidEngine engine(width, height);
+    engine.setThreadCount(threads);
+    engine.setViscosity(0.02f);
+    engine.setBoundaryConditions(4, 5, 1, 1);
+    engine.setInflowProperties(0.1f, 0.0f, 1.0f);
+    engine.addObstacle(width / 4, height / 2, height / 10, false, 0, 1, 0);
+    if (turbulent) {
+        engine.setSmagorinskyConstant(0.1f);
+        engine.setThermalProperties(0.01f, 0.5f);
+        engine.setGravity(0.0f, -0.001f);
+    }
+    engine.step(10);
+    auto start = Clock::now();
+    engine.step(steps);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::printf("%-14s %-12s %8.1f MLUPS\n", VARIANT, label,
+                seconds > 0.0 ? (double)steps * width * height / seconds / 1e6 : 0.0);
+}
+}
+
+int main(int argc, char** argv) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 1024;
+    int height = argc > 2 ? std::atoi(argv[2]) : 512;
+    int steps = argc > 3 ? std::atoi(argv[3]) : 200;
+    int threads = argc > 4 ? std::atoi(argv[4]) : 1;
+
+    std::printf("%dx%d, %d steps, %d threads\n", width, height, steps, threads);
+    run("bgk", false, width, height, steps, threads);
+    run("smagorinsky", true, width, height, steps, threads);
+    return 0;
+}
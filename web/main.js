@@ -1,4 +1,38 @@
-createFluidEngine().then(Module => {
+// Smallest module using a relaxed-SIMD instruction (i8x16.relaxed_swizzle); it validates only
+// where the browser supports relaxed SIMD.
+const RELAXED_SIMD_PROBE = new Uint8Array([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 15, 1, 13, 0,
+    65, 1, 253, 15, 65, 2, 253, 15, 253, 128, 2, 11
+]);
+
+function loadScript(src) {
+    return new Promise((resolve, reject) => {
+        const script = document.createElement('script');
+        script.src = src;
+        script.onload = resolve;
+        script.onerror = () => {
+            script.remove();
+            reject(new Error(`failed to load ${src}`));
+        };
+        document.head.appendChild(script);
+    });
+}
+
+// Picks engine-relaxed.js (fused multiply-add kernels) when relaxed SIMD is available and the
+// baseline SIMD128 engine.js otherwise, including when the relaxed build is missing or fails.
+function loadEngine() {
+    const relaxed = typeof WebAssembly === 'object' && WebAssembly.validate(RELAXED_SIMD_PROBE);
+    const baseline = () => loadScript('engine.js').then(() => createFluidEngine());
+    if (!relaxed) return baseline();
+    return loadScript('engine-relaxed.js')
+        .then(() => createFluidEngine())
+        .catch(err => {
+            console.warn('Relaxed-SIMD engine unavailable, using baseline build:', err);
+            return baseline();
+        });
+}
+
+loadEngine().then(Module => {
     const canvas = document.getElementById('simCanvas');
     let engine = null;
     let renderer = null;
@@ -19,7 +53,15 @@ createFluidEngine().then(Module => {
             iterations: 2,
             paused: false,
             dt: 1.0,
-            threads: navigator.hardwareConcurrency || 4
+            threads: navigator.hardwareConcurrency || 4,
+            packedUpload: 1,
+            outputLevel: 0,
+            recording: false,
+            asyncMode: false,
+            asyncRate: 60,
+            autoBudget: false,
+            timeSliced: false,
+            budgetMs: 10
         },
 
         physics: {
@@ -33,6 +75,8 @@ createFluidEngine().then(Module => {
             inflowVelocityX: 0.1,
             inflowVelocityY: 0.0,
             inflowDensity: 1.0,
+            inflowTurbulence: 0.0,
+            inflowTurbulenceScale: 8,
             movingWallVelocityLeft: 0.0,
             movingWallVelocityRight: 0.0,
             movingWallVelocityTop: 0.1,
@@ -44,6 +88,7 @@ createFluidEngine().then(Module => {
             thermalDiffusivity: 0.001,
             vorticityConfinement: 0.1,
             maxVelocity: 0.57,
+            collisionModel: 0,
             smagorinsky: 0.05,
             tempViscosity: 0.0,
             rheologyIndex: 1.0,
@@ -90,6 +135,31 @@ createFluidEngine().then(Module => {
             color: '#ffffff',
         },
 
+        diagnostics: {
+            enabled: false,
+            mass: 0,
+            kineticEnergy: 0,
+            enstrophy: 0,
+            maxSpeedRatio: 0,
+            clampedFraction: 0,
+            dye: 0,
+            heat: 0,
+            forces: false,
+            obstacleId: 1,
+            drag: 0,
+            lift: 0,
+            labelObstacles: () => engine && engine.labelObstacles(),
+            probeLine: false,
+            downloadProbes: () => downloadProbes(),
+            statistics: false,
+            statisticsSamples: 0,
+            resetStatistics: () => engine && engine.resetStatistics(),
+            downloadStatistics: () => downloadStatistics(),
+            spectrum: false,
+            spectrumEvery: 100,
+            downloadSpectra: () => downloadSpectra(),
+        },
+
         postProcessing: {
             enabled: false,
             mode: 'Gaussian Blur',
@@ -120,6 +190,146 @@ createFluidEngine().then(Module => {
         reset: () => { 
             if(engine) engine.reset(); 
             if(renderer) renderer.initParticles(params.particles.count);
+        },
+
+        saveCheckpoint: () => {
+            if (!engine) return;
+            downloadBytes(engine.saveCheckpoint().slice(), `fluid-${simWidth}x${simHeight}.ckpt`);
+        },
+
+        loadCheckpoint: () => {
+            const input = document.createElement('input');
+            input.type = 'file';
+            input.accept = '.ckpt';
+            input.onchange = () => {
+                const file = input.files[0];
+                if (!file) return;
+                file.arrayBuffer().then(buffer => {
+                    if (!engine || !engine.loadCheckpoint(buffer)) {
+                        console.error('Failed to load checkpoint:', file.name);
+                        return;
+                    }
+                    uploadedVersions = {};
+                    packedConfig = '';
+                });
+            };
+            input.click();
+        }
+    };
+
+    const downloadBytes = (bytes, name) => {
+        const link = document.createElement('a');
+        link.href = URL.createObjectURL(new Blob([bytes], { type: 'application/octet-stream' }));
+        link.download = name;
+        link.click();
+        setTimeout(() => URL.revokeObjectURL(link.href), 0);
+    };
+
+    // Probe line: 16 points across the channel at 3/4 of the width, sampled every iteration and
+    // drained once per frame into chunks for CSV export.
+    let probeChunks = [];
+    const PROBE_LINE_POINTS = 16;
+    const updateProbes = () => {
+        if (!engine) return;
+        engine.clearProbes();
+        probeChunks = [];
+        if (params.diagnostics.probeLine) {
+            engine.setProbeCapacity(4096);
+            engine.addLineProbe(simWidth * 0.75, 1, simWidth * 0.75, simHeight - 2, PROBE_LINE_POINTS);
+        }
+    };
+    const drainProbeLine = () => {
+        if (!params.diagnostics.probeLine || engine.drainProbes() === 0) return;
+        probeChunks.push(engine.getProbeDrainView().slice());
+    };
+    const downloadProbes = () => {
+        const channels = ['ux', 'uy', 'p', 'dye', 'T'];
+        const stride = 1 + PROBE_LINE_POINTS * channels.length;
+        const header = ['step'];
+        for (let i = 0; i < PROBE_LINE_POINTS; ++i) channels.forEach(c => header.push(`${c}${i}`));
+        const lines = [header.join(',')];
+        for (const chunk of probeChunks) {
+            const steps = new Uint32Array(chunk.buffer);
+            for (let r = 0; r + stride <= chunk.length; r += stride) {
+                lines.push([steps[r], ...chunk.subarray(r + 1, r + stride)].join(','));
+            }
+        }
+        downloadBytes(lines.join('\n'), `probes-${simWidth}x${simHeight}.csv`);
+    };
+
+    // Running statistics export as one float32 block per field in StatisticsField order.
+    const STAT_FIELD_COUNT = 7;
+    const downloadStatistics = () => {
+        if (!engine || engine.getStatisticsSamples() === 0) return;
+        const cells = simWidth * simHeight;
+        const out = new Float32Array(cells * STAT_FIELD_COUNT);
+        for (let i = 0; i < STAT_FIELD_COUNT; ++i) out.set(engine.getStatisticsView(i), i * cells);
+        downloadBytes(out, `statistics-${simWidth}x${simHeight}-${engine.getStatisticsSamples()}.f32`);
+    };
+    const updateStatistics = () => {
+        if (!engine) return;
+        if (params.diagnostics.statistics) engine.startStatistics();
+        else engine.stopStatistics();
+    };
+
+    // Energy spectra every N steps; walled domains get a Hann window, fully periodic ones none.
+    let spectra = [];
+    let lastSpectrumStep = -1;
+    const updateSpectrum = () => {
+        if (!engine) return;
+        const p = params.physics;
+        const periodic = p.boundaryLeft === 0 && p.boundaryRight === 0 && p.boundaryTop === 0 && p.boundaryBottom === 0;
+        engine.setSpectrumInterval(params.diagnostics.spectrum ? params.diagnostics.spectrumEvery : 0, periodic ? 0 : 1);
+        spectra = [];
+        lastSpectrumStep = -1;
+    };
+    const collectSpectrum = () => {
+        if (!params.diagnostics.spectrum || engine.getSpectrumStep() === lastSpectrumStep) return;
+        lastSpectrumStep = engine.getSpectrumStep();
+        spectra.push([lastSpectrumStep, ...engine.getSpectrumView()]);
+    };
+    const downloadSpectra = () => {
+        downloadBytes(spectra.map(row => row.join(',')).join('\n'), `spectra-${simWidth}x${simHeight}.csv`);
+    };
+
+    // Session journals replay headless with tools/replay.cpp
+    const updateRecording = () => {
+        if (!engine) return;
+        if (params.simulation.recording) {
+            engine.startJournal();
+        } else {
+            engine.stopJournal();
+            downloadBytes(engine.getJournalView().slice(), `session-${simWidth}x${simHeight}.jrnl`);
+        }
+    };
+
+    // Async physics: the engine steps on its own thread and the loop draws the latest snapshot.
+    const updateAsync = () => {
+        if (!engine) return;
+        if (params.simulation.asyncMode) {
+            const iterations = params.simulation.paused ? 0 : params.simulation.iterations;
+            if (!engine.startAsync(params.simulation.asyncRate, iterations)) {
+                console.warn('Async physics needs pthread support.');
+                params.simulation.asyncMode = false;
+            }
+        } else {
+            engine.stopAsync();
+        }
+        uploadedVersions = {};
+        packedConfig = '';
+    };
+
+    // Frame budget: the engine picks iterations per frame to fit budgetMs of stepping, and a short
+    // calibration (cached per grid and feature set) picks the thread count.
+    const updateBudget = () => {
+        if (!engine) return;
+        if (params.simulation.autoBudget) {
+            engine.setFrameBudget(params.simulation.budgetMs, 1, 20);
+            if (!params.simulation.asyncMode) {
+                params.simulation.threads = engine.calibrate(navigator.hardwareConcurrency || 4, 4);
+            }
+        } else {
+            engine.setFrameBudget(0, 1, 20);
         }
     };
 
@@ -232,6 +442,11 @@ createFluidEngine().then(Module => {
         engine.setBFECC(params.features.enableBFECC);
     };
 
+    const updateCollisionModel = () => {
+        if (!engine) return;
+        engine.setCollisionModel(params.physics.collisionModel);
+    };
+
     const gui = new lil.GUI({ title: 'Turbulence Simulation' });
 
     const findController = (root, obj, property) => {
@@ -286,18 +501,28 @@ createFluidEngine().then(Module => {
 
     const simFolder = gui.addFolder('Simulation').close();
     simFolder.add(params.simulation, 'resolutionScale', [50, 100, 200, 300, 400, 600, 800, 1000]).name('Grid Resolution').onChange(initSimulation);
-    simFolder.add(params.simulation, 'iterations', 0, 20, 1).name('Iterations/Frame');
+    simFolder.add(params.simulation, 'iterations', 0, 20, 1).name('Iterations/Frame').listen();
+    simFolder.add(params.simulation, 'packedUpload', { 'Off': 0, 'RGBA32F': 1, 'RGBA16F': 2, 'RGBA8 (Quantized)': 3, 'RGBA16 (Quantized)': 4 }).name('Packed Upload');
+    simFolder.add(params.simulation, 'outputLevel', { 'Auto': 0, 'Full': 1, '1/2': 2, '1/4': 4 }).name('Output Level');
     simFolder.add(params.simulation, 'dt', 0.001, 1.5, 0.001).name('Time Step (dt)').step(0.01).onChange(t => engine && engine.setDt(t));
-    simFolder.add(params.simulation, 'threads', 1, 32, 1).name('CPU Threads').onChange(t => {
+    simFolder.add(params.simulation, 'autoBudget').name('Auto Iterations').onChange(updateBudget);
+    simFolder.add(params.simulation, 'timeSliced').name('Time-Sliced Steps');
+    simFolder.add(params.simulation, 'budgetMs', 2, 30, 0.5).name('Step Budget (ms)').onChange(updateBudget);
+    simFolder.add(params.simulation, 'threads', 1, 32, 1).name('CPU Threads').listen().onChange(t => {
         if (engine && typeof engine.setThreadCount === 'function') {
             engine.setThreadCount(t);
         }
     });
     simFolder.add(params.simulation, 'paused').name('Pause').listen();
+    simFolder.add(params.simulation, 'recording').name('Record Session').onChange(updateRecording);
+    simFolder.add(params.simulation, 'asyncMode').name('Async Physics').onChange(updateAsync).listen();
+    simFolder.add(params.simulation, 'asyncRate', 10, 240, 1).name('Physics Rate (Hz)');
 
     const physicsFolder = gui.addFolder('Physics');
     
     physicsFolder.add(params, 'reset').name('Reset Fluid');
+    physicsFolder.add(params, 'saveCheckpoint').name('Save Checkpoint');
+    physicsFolder.add(params, 'loadCheckpoint').name('Load Checkpoint');
 
     physicsFolder.add(params.physics, 'viscosity', 0.001, 10).name('Viscosity').step(0.001).onChange(v => engine && engine.setViscosity(v));
     physicsFolder.add(params.physics, 'decay', 0.0, 0.05).name('Dye Dissipation').step(0.0001).onChange(d => engine && engine.setDecay(d));
@@ -319,10 +544,16 @@ createFluidEngine().then(Module => {
     boundaryFolder.add(params.physics, 'boundaryBottom', boundaryTypes).name('Bottom').onChange(updateBoundaries);
 
     inflowFolder = boundaryFolder.addFolder('Inflow Properties');
-    const updateInflow = () => engine && engine.setInflowProperties(params.physics.inflowVelocityX, params.physics.inflowVelocityY, params.physics.inflowDensity);
+    const updateInflow = () => {
+        if (!engine) return;
+        engine.setInflowProperties(params.physics.inflowVelocityX, params.physics.inflowVelocityY, params.physics.inflowDensity);
+        engine.setInflowTurbulence(params.physics.inflowTurbulence, params.physics.inflowTurbulenceScale);
+    };
     inflowC.vx = inflowFolder.add(params.physics, 'inflowVelocityX', -0.5, 0.5).name('Velocity X').step(0.01).onChange(updateInflow);
     inflowC.vy = inflowFolder.add(params.physics, 'inflowVelocityY', -0.5, 0.5).name('Velocity Y').step(0.01).onChange(updateInflow);
     inflowC.rho = inflowFolder.add(params.physics, 'inflowDensity', 0.1, 5.0).name('Density').onChange(updateInflow);
+    inflowC.turbulence = inflowFolder.add(params.physics, 'inflowTurbulence', 0.0, 0.5).name('Turbulence Intensity').step(0.01).onChange(updateInflow);
+    inflowC.turbulenceScale = inflowFolder.add(params.physics, 'inflowTurbulenceScale', 1, 64, 1).name('Turbulence Scale (cells)').onChange(updateInflow);
 
     wallFolder = boundaryFolder.addFolder('Moving Wall Velocity');
     wallVC.left = wallFolder.add(params.physics, 'movingWallVelocityLeft', -0.5, 0.5).name('Left Wall (vy)').step(0.01).onChange(v => updateWall('Left', v));
@@ -341,6 +572,7 @@ createFluidEngine().then(Module => {
     const advancedPhysicsFolder = physicsFolder.addFolder('Advanced').close();
     advancedPhysicsFolder.add(params.physics, 'maxVelocity', 0.01, 1.0).name('Max Velocity (Stability)').step(0.01).onChange(v => engine && engine.setMaxVelocity(v));
     advancedPhysicsFolder.add(params.features, 'enableBFECC').name('Enable BFECC').onChange(updateBFECC);
+    advancedPhysicsFolder.add(params.physics, 'collisionModel', { 'BGK': 0, 'Regularized': 1 }).name('Collision').onChange(updateCollisionModel);
     
     const turbulenceFolder = physicsFolder.addFolder('Turbulence (LES)').close();
     const smagController = turbulenceFolder.add(params.physics, 'smagorinsky', 0.0, 0.3).name('Smagorinsky Const').step(0.01).onChange(updateSmagorinsky);
@@ -422,6 +654,30 @@ createFluidEngine().then(Module => {
     particleFolder.add(params.particles, 'opacity', 0.0, 1.0).name('Opacity');
     particleFolder.addColor(params.particles, 'color').name('Color');
 
+    const diagFolder = gui.addFolder('Diagnostics').close();
+    diagFolder.add(params.diagnostics, 'enabled').name('Enable').onChange(v => engine && engine.setDiagnostics(v, 256));
+    diagFolder.add(params.diagnostics, 'mass').name('Mass').listen().disable();
+    diagFolder.add(params.diagnostics, 'kineticEnergy').name('Kinetic Energy').listen().disable();
+    diagFolder.add(params.diagnostics, 'enstrophy').name('Enstrophy').listen().disable();
+    diagFolder.add(params.diagnostics, 'maxSpeedRatio').name('Max Speed / Limit').listen().disable();
+    diagFolder.add(params.diagnostics, 'clampedFraction').name('Clamped Fraction').listen().disable();
+    diagFolder.add(params.diagnostics, 'dye').name('Dye Content').listen().disable();
+    diagFolder.add(params.diagnostics, 'heat').name('Heat Content').listen().disable();
+    diagFolder.add(params.diagnostics, 'forces').name('Obstacle Forces').onChange(v => engine && engine.setForceTracking(v, 256));
+    diagFolder.add(params.diagnostics, 'labelObstacles').name('Label Obstacles');
+    diagFolder.add(params.diagnostics, 'obstacleId', 0, 63, 1).name('Obstacle ID');
+    diagFolder.add(params.diagnostics, 'drag').name('Drag (Fx)').listen().disable();
+    diagFolder.add(params.diagnostics, 'lift').name('Lift (Fy)').listen().disable();
+    diagFolder.add(params.diagnostics, 'probeLine').name('Probe Line').onChange(updateProbes);
+    diagFolder.add(params.diagnostics, 'downloadProbes').name('Download Probes CSV');
+    diagFolder.add(params.diagnostics, 'statistics').name('Accumulate Statistics').onChange(updateStatistics);
+    diagFolder.add(params.diagnostics, 'statisticsSamples').name('Samples').listen().disable();
+    diagFolder.add(params.diagnostics, 'resetStatistics').name('Reset Statistics');
+    diagFolder.add(params.diagnostics, 'downloadStatistics').name('Download Statistics');
+    diagFolder.add(params.diagnostics, 'spectrum').name('Energy Spectrum').onChange(updateSpectrum);
+    diagFolder.add(params.diagnostics, 'spectrumEvery', 10, 1000, 10).name('Spectrum Every N Steps').onChange(updateSpectrum);
+    diagFolder.add(params.diagnostics, 'downloadSpectra').name('Download Spectra CSV');
+
     const ppFolder = gui.addFolder('Post Processing').close();
     ppFolder.add(params.postProcessing, 'enabled').name('Enable Filter');
     ppFolder.add(params.postProcessing, 'mode', ['Gaussian Blur', 'Edge Detect', 'Sharpen']).name('Filter Type');
@@ -497,17 +753,96 @@ createFluidEngine().then(Module => {
 
     let simWidth, simHeight;
     
-    let uploadedVersions = {
-        ux: 0,
-        uy: 0,
-        dye: 0,
-        temp: 0,
-        density: 0
+    const FIELD = {
+        VELOCITY: 0,
+        DENSITY: 1,
+        DYE: 2,
+        TEMPERATURE: 3,
+        POROSITY: 4,
+        BARRIERS: 5
+    };
+
+    let uploadedVersions = {};
+
+    const SNAPSHOT = { UX: 0, UY: 1, DENSITY: 2, DYE: 3, TEMPERATURE: 4, POROSITY: 5, BARRIERS: 6 };
+    const DIAG = { STEP: 0, MASS: 1, KINETIC_ENERGY: 2, ENSTROPHY: 3, MAX_SPEED_RATIO: 4, CLAMPED_FRACTION: 5, DYE: 6, HEAT: 7 };
+
+    const PACK = { NONE: 0, UX: 1, UY: 2, DYE: 3, TEMP: 4, RHO: 5, VORTICITY: 6 };
+    const packedChannelsByMode = [
+        [PACK.UX, PACK.UY, PACK.VORTICITY, PACK.NONE],
+        [PACK.UX, PACK.UY, PACK.NONE, PACK.NONE],
+        [PACK.UX, PACK.UY, PACK.DYE, PACK.NONE],
+        [PACK.UX, PACK.UY, PACK.TEMP, PACK.NONE],
+        [PACK.UX, PACK.UY, PACK.RHO, PACK.NONE]
+    ];
+    let packedConfig = '';
+    let uploadedPackedVersion = 0;
+
+    const outputLevelFactor = () => {
+        const level = parseInt(params.simulation.outputLevel);
+        if (level > 0) return level;
+        let factor = 1;
+        while (factor < 4 && simWidth / (factor * 2) >= canvas.width && simHeight / (factor * 2) >= canvas.height) {
+            factor *= 2;
+        }
+        return factor;
+    };
+
+    const fetchPacked = (vizMode) => {
+        const format = parseInt(params.simulation.packedUpload);
+        const channels = packedChannelsByMode[vizMode];
+        const factor = outputLevelFactor();
+        const config = format + ':' + factor + ':' + channels.join(',');
+        if (config !== packedConfig) {
+            engine.setPackedLevel(factor);
+            engine.setPackedOutput(format, channels[0], channels[1], channels[2], channels[3]);
+            packedConfig = config;
+            uploadedPackedVersion = -1;
+        }
+        const data = engine.getPackedView();
+        const version = engine.getPackedVersion();
+        if (version === uploadedPackedVersion) return null;
+        uploadedPackedVersion = version;
+        return {
+            data, format, channels,
+            width: engine.getPackedWidth(),
+            height: engine.getPackedHeight(),
+            min: [0, 1, 2, 3].map(c => engine.getPackedMin(c)),
+            max: [0, 1, 2, 3].map(c => engine.getPackedMax(c))
+        };
+    };
+
+    const fetchDirtyRows = (field) => {
+        const version = engine.getFieldVersion(field);
+        if (uploadedVersions[field] === version) return null;
+        const rowStart = engine.getDirtyRowStart(field);
+        const rowEnd = engine.getDirtyRowEnd(field);
+        engine.clearFieldDirty(field);
+        uploadedVersions[field] = version;
+        if (rowEnd <= rowStart) return null;
+        return { rowStart, rowEnd };
+    };
+
+    const fetchSnapshotRows = (field) => {
+        const version = engine.getSnapshotVersion(field);
+        if (uploadedVersions[field] === version) return null;
+        uploadedVersions[field] = version;
+        return { rowStart: 0, rowEnd: simHeight };
     };
 
     function initSimulation() {
         if (requestId) cancelAnimationFrame(requestId);
-        if (engine) engine.delete();
+        // Carry the flow across resolution changes; the engine resamples on load.
+        let carried = null;
+        if (engine) {
+            engine.stopAsync();
+            carried = engine.saveCheckpoint().slice().buffer;
+            if (params.simulation.recording) {
+                engine.stopJournal();
+                downloadBytes(engine.getJournalView().slice(), `session-${simWidth}x${simHeight}.jrnl`);
+            }
+            engine.delete();
+        }
 
         canvas.width = window.innerWidth;
         canvas.height = window.innerHeight * 0.95;
@@ -520,13 +855,8 @@ createFluidEngine().then(Module => {
 
         engine = new Module.FluidEngine(simWidth, simHeight);
         
-        uploadedVersions = {
-            ux: 0,
-            uy: 0,
-            dye: 0,
-            temp: 0,
-            density: 0
-        };
+        uploadedVersions = {};
+        packedConfig = '';
         
         console.log("FluidEngine instance created.");
         if (engine) {
@@ -565,6 +895,17 @@ createFluidEngine().then(Module => {
         updateSmagorinsky();
         updateTempViscosity();
         updateBFECC();
+        updateCollisionModel();
+        updateBudget();
+        engine.setDiagnostics(params.diagnostics.enabled, 256);
+        engine.setForceTracking(params.diagnostics.forces, 256);
+        updateProbes();
+        updateStatistics();
+        updateSpectrum();
+
+        if (carried) engine.loadCheckpoint(carried);
+        if (params.simulation.recording) engine.startJournal();
+        if (params.simulation.asyncMode) updateAsync();
         
         renderer = new Renderer(canvas, simWidth, simHeight);
         renderer.initParticles(params.particles.count);
@@ -734,48 +1075,85 @@ createFluidEngine().then(Module => {
     window.addEventListener('touchend', () => mouse.isDragging = false);
 
     function loop() {
-        if(!params.simulation.paused) {
-            if (params.simulation.iterations > 0) {
-                engine.step(params.simulation.iterations);
-            }
-        }
-
-        const currentVersion = engine.getDataVersion();
         const views = {};
         const vizMode = params.visualization.mode;
         const particlesOn = params.particles.show;
+        let obsDirty = false;
+
+        if (params.simulation.asyncMode) {
+            engine.setAsyncRate(params.simulation.asyncRate, params.simulation.paused ? 0 : params.simulation.iterations);
+            if (params.simulation.autoBudget) params.simulation.iterations = engine.getFrameBudgetIterations();
+            if (engine.acquireSnapshot()) {
+                const needsUxUy = vizMode === 0 || vizMode === 1 || vizMode === 4 || particlesOn;
+                const velocityRows = needsUxUy ? fetchSnapshotRows(FIELD.VELOCITY) : null;
+                if (velocityRows) {
+                    views.ux = { data: engine.getSnapshotView(SNAPSHOT.UX), ...velocityRows };
+                    views.uy = { data: engine.getSnapshotView(SNAPSHOT.UY), ...velocityRows };
+                }
+                const dyeRows = vizMode === 2 ? fetchSnapshotRows(FIELD.DYE) : null;
+                if (dyeRows) views.dye = { data: engine.getSnapshotView(SNAPSHOT.DYE), ...dyeRows };
+                const tempRows = vizMode === 3 ? fetchSnapshotRows(FIELD.TEMPERATURE) : null;
+                if (tempRows) views.temp = { data: engine.getSnapshotView(SNAPSHOT.TEMPERATURE), ...tempRows };
+                const densityRows = vizMode === 4 ? fetchSnapshotRows(FIELD.DENSITY) : null;
+                if (densityRows) views.density = { data: engine.getSnapshotView(SNAPSHOT.DENSITY), ...densityRows };
+                if (fetchSnapshotRows(FIELD.BARRIERS)) {
+                    views.obs = { data: engine.getSnapshotView(SNAPSHOT.BARRIERS), rects: [0, 0, simWidth, simHeight] };
+                    obsDirty = true;
+                }
+            }
+        } else {
+            if(!params.simulation.paused) {
+                if (params.simulation.timeSliced) {
+                    engine.stepFor(params.simulation.budgetMs * 1000);
+                } else if (params.simulation.autoBudget) {
+                    params.simulation.iterations = engine.stepFrame();
+                } else if (params.simulation.iterations > 0) {
+                    engine.step(params.simulation.iterations);
+                }
+            }
 
-        const needsUxUy = (vizMode === 0 || vizMode === 1 || vizMode === 4 || particlesOn);
-        if (needsUxUy && uploadedVersions.ux !== currentVersion) {
-            views.ux = engine.getVelocityXView();
-            views.uy = engine.getVelocityYView();
-            uploadedVersions.ux = currentVersion;
-            uploadedVersions.uy = currentVersion;
-        }
+            const usePacked = parseInt(params.simulation.packedUpload) !== 0;
+            if (usePacked) {
+                const packed = fetchPacked(vizMode);
+                if (packed) views.packed = packed;
+            } else if (packedConfig !== '') {
+                engine.setPackedOutput(0, 0, 0, 0, 0);
+                packedConfig = '';
+                uploadedVersions = {};
+            }
 
-        const needsDye = (vizMode === 2);
-        if (needsDye && uploadedVersions.dye !== currentVersion) {
-            views.dye = engine.getDyeView();
-            uploadedVersions.dye = currentVersion;
-        }
+            const needsUxUy = !usePacked && (vizMode === 0 || vizMode === 1 || vizMode === 4 || particlesOn);
+            const velocityRows = needsUxUy ? fetchDirtyRows(FIELD.VELOCITY) : null;
+            if (velocityRows) {
+                views.ux = { data: engine.getVelocityXView(), ...velocityRows };
+                views.uy = { data: engine.getVelocityYView(), ...velocityRows };
+            }
 
-        const needsTemp = (vizMode === 3);
-        if (needsTemp && uploadedVersions.temp !== currentVersion) {
-            views.temp = engine.getTemperatureView();
-            uploadedVersions.temp = currentVersion;
-        }
+            const dyeRows = (!usePacked && vizMode === 2) ? fetchDirtyRows(FIELD.DYE) : null;
+            if (dyeRows) {
+                views.dye = { data: engine.getDyeView(), ...dyeRows };
+            }
 
-        const needsDensity = (vizMode === 4);
-        if (needsDensity && uploadedVersions.density !== currentVersion) { 
-            views.density = engine.getDensityView();
-            uploadedVersions.density = currentVersion;
-        }
-        
-        const obsDirty = engine.checkBarrierDirty();
-        if (obsDirty) {
-            views.obs = engine.getBarrierView();
+            const tempRows = (!usePacked && vizMode === 3) ? fetchDirtyRows(FIELD.TEMPERATURE) : null;
+            if (tempRows) {
+                views.temp = { data: engine.getTemperatureView(), ...tempRows };
+            }
+
+            const densityRows = (!usePacked && vizMode === 4) ? fetchDirtyRows(FIELD.DENSITY) : null;
+            if (densityRows) {
+                views.density = { data: engine.getDensityView(), ...densityRows };
+            }
+            
+            obsDirty = engine.getDirtyRectCount(FIELD.BARRIERS) > 0;
+            if (obsDirty) {
+                views.obs = { data: engine.getBarrierView(), rects: engine.getDirtyRects(FIELD.BARRIERS).slice() };
+                engine.clearDirtyRects(FIELD.BARRIERS);
+            }
         }
 
+        drainProbeLine();
+        collectSpectrum();
+
         const vizParamsWithParticles = { ...params.visualization, particles: params.particles };
         renderer.draw(views, vizParamsWithParticles, params.postProcessing, obsDirty);
 
@@ -802,6 +1180,23 @@ createFluidEngine().then(Module => {
             fpsCounter.textContent = `FPS: ${fps}`;
             lastTime = currentTime;
             frameCount = 0;
+            if (params.diagnostics.enabled) {
+                const d = engine.getDiagnosticsView();
+                const diag = params.diagnostics;
+                diag.mass = d[DIAG.MASS];
+                diag.kineticEnergy = d[DIAG.KINETIC_ENERGY];
+                diag.enstrophy = d[DIAG.ENSTROPHY];
+                diag.maxSpeedRatio = d[DIAG.MAX_SPEED_RATIO];
+                diag.clampedFraction = d[DIAG.CLAMPED_FRACTION];
+                diag.dye = d[DIAG.DYE];
+                diag.heat = d[DIAG.HEAT];
+            }
+            params.diagnostics.statisticsSamples = engine.getStatisticsSamples();
+            if (params.diagnostics.forces) {
+                const forces = engine.getObstacleForcesView();
+                params.diagnostics.drag = forces[1 + 2 * params.diagnostics.obstacleId];
+                params.diagnostics.lift = forces[2 + 2 * params.diagnostics.obstacleId];
+            }
         }
 
         requestId = requestAnimationFrame(loop);
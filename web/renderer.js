@@ -28,6 +28,8 @@ class Renderer {
         this.brushProgram = this.createProgram(BRUSH_VS, BRUSH_FS);
         this.postProgram = this.createProgram(POST_VS, POST_FS);
         this.vorticityProgram = this.createProgram(VS_SOURCE, VORTICITY_FS_SOURCE);
+        this.unpackProgram = this.createProgram(VS_SOURCE, UNPACK_FS);
+        this.unpackUintProgram = this.createProgram(VS_SOURCE, UNPACK_UINT_FS);
         
         this.texUx = this.createTexture(this.gl.R32F, this.gl.RED, this.gl.FLOAT, this.width, this.height);
         this.texUy = this.createTexture(this.gl.R32F, this.gl.RED, this.gl.FLOAT, this.width, this.height);
@@ -37,6 +39,11 @@ class Renderer {
         this.texVorticity = this.createTexture(this.gl.R32F, this.gl.RED, this.gl.FLOAT, this.width, this.height);
         this.texRho = this.createTexture(this.gl.R32F, this.gl.RED, this.gl.FLOAT, this.width, this.height);
 
+        this.texPacked = null;
+        this.packedKey = '';
+        this.unpackFBO = this.gl.createFramebuffer();
+        this.packedTargets = [null, this.texUx, this.texUy, this.texDye, this.texTemp, this.texRho, this.texVorticity];
+
         this.quadBuffer = this.gl.createBuffer();
         this.gl.bindBuffer(this.gl.ARRAY_BUFFER, this.quadBuffer);
         this.gl.bufferData(this.gl.ARRAY_BUFFER, new Float32Array([
@@ -123,6 +130,14 @@ class Renderer {
             ux: this.gl.getUniformLocation(this.vorticityProgram, "u_ux"),
             uy: this.gl.getUniformLocation(this.vorticityProgram, "u_uy")
         };
+
+        const unpackUniforms = (program) => ({
+            packed: this.gl.getUniformLocation(program, "u_packed"),
+            offset: this.gl.getUniformLocation(program, "u_offset"),
+            scale: this.gl.getUniformLocation(program, "u_scale")
+        });
+        this.unpackUniforms = unpackUniforms(this.unpackProgram);
+        this.unpackUintUniforms = unpackUniforms(this.unpackUintProgram);
     }
 
     _getVisUniformLocations(program) {
@@ -316,42 +331,97 @@ class Renderer {
         this.particleStateIndex = destIndex;
     }
 
-    draw(views, vizParams, postParams, obsDirty) {
-        if (vizParams.mode === 0 && (views.ux || views.uy)) {
-            this.runVorticityPass();
-        }
+    uploadRows(unit, texture, view, type) {
+        const rows = view.rowEnd - view.rowStart;
+        this.gl.activeTexture(unit);
+        this.gl.bindTexture(this.gl.TEXTURE_2D, texture);
+        this.gl.texSubImage2D(this.gl.TEXTURE_2D, 0, 0, view.rowStart, this.width, rows, this.gl.RED, type,
+            view.data.subarray(view.rowStart * this.width, view.rowEnd * this.width));
+    }
 
-        if (views.ux) {
-            this.gl.activeTexture(this.gl.TEXTURE0);
-            this.gl.bindTexture(this.gl.TEXTURE_2D, this.texUx);
-            this.gl.texSubImage2D(this.gl.TEXTURE_2D, 0, 0, 0, this.width, this.height, this.gl.RED, this.gl.FLOAT, views.ux);
-        }
-        if (views.uy) {
-            this.gl.activeTexture(this.gl.TEXTURE1);
-            this.gl.bindTexture(this.gl.TEXTURE_2D, this.texUy);
-            this.gl.texSubImage2D(this.gl.TEXTURE_2D, 0, 0, 0, this.width, this.height, this.gl.RED, this.gl.FLOAT, views.uy);
+    uploadRects(unit, texture, view, type) {
+        const gl = this.gl;
+        gl.activeTexture(unit);
+        gl.bindTexture(gl.TEXTURE_2D, texture);
+        gl.pixelStorei(gl.UNPACK_ROW_LENGTH, this.width);
+        for (let i = 0; i < view.rects.length; i += 4) {
+            const x0 = view.rects[i], y0 = view.rects[i + 1];
+            const x1 = view.rects[i + 2], y1 = view.rects[i + 3];
+            gl.pixelStorei(gl.UNPACK_SKIP_PIXELS, x0);
+            gl.pixelStorei(gl.UNPACK_SKIP_ROWS, y0);
+            gl.texSubImage2D(gl.TEXTURE_2D, 0, x0, y0, x1 - x0, y1 - y0, gl.RED, type, view.data);
         }
-        if (views.density) {
-            this.gl.activeTexture(this.gl.TEXTURE2);
-            this.gl.bindTexture(this.gl.TEXTURE_2D, this.texRho);
-            this.gl.texSubImage2D(this.gl.TEXTURE_2D, 0, 0, 0, this.width, this.height, this.gl.RED, this.gl.FLOAT, views.density);
+        gl.pixelStorei(gl.UNPACK_ROW_LENGTH, 0);
+        gl.pixelStorei(gl.UNPACK_SKIP_PIXELS, 0);
+        gl.pixelStorei(gl.UNPACK_SKIP_ROWS, 0);
+    }
+
+    uploadPacked(packed) {
+        const gl = this.gl;
+        const formats = {
+            1: [gl.RGBA32F, gl.RGBA, gl.FLOAT, this.filter],
+            2: [gl.RGBA16F, gl.RGBA, gl.HALF_FLOAT, gl.LINEAR],
+            3: [gl.RGBA8, gl.RGBA, gl.UNSIGNED_BYTE, gl.LINEAR],
+            4: [gl.RGBA16UI, gl.RGBA_INTEGER, gl.UNSIGNED_SHORT, gl.NEAREST]
+        };
+        const [internalFormat, format, type, filter] = formats[packed.format];
+
+        const key = packed.format + ':' + packed.width + 'x' + packed.height;
+        if (this.packedKey !== key) {
+            if (this.texPacked) gl.deleteTexture(this.texPacked);
+            this.texPacked = this.createTexture(internalFormat, format, type, packed.width, packed.height);
+            gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, filter);
+            gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MAG_FILTER, filter);
+            this.packedKey = key;
         }
-        if (views.dye) {
-            this.gl.activeTexture(this.gl.TEXTURE3);
-            this.gl.bindTexture(this.gl.TEXTURE_2D, this.texDye);
-            this.gl.texSubImage2D(this.gl.TEXTURE_2D, 0, 0, 0, this.width, this.height, this.gl.RED, this.gl.FLOAT, views.dye);
+
+        gl.activeTexture(gl.TEXTURE0);
+        gl.bindTexture(gl.TEXTURE_2D, this.texPacked);
+        gl.texSubImage2D(gl.TEXTURE_2D, 0, 0, 0, packed.width, packed.height, format, type, packed.data);
+
+        gl.bindFramebuffer(gl.FRAMEBUFFER, this.unpackFBO);
+        const drawBuffers = [];
+        for (let c = 0; c < 4; c++) {
+            const target = this.packedTargets[packed.channels[c]] || null;
+            gl.framebufferTexture2D(gl.FRAMEBUFFER, gl.COLOR_ATTACHMENT0 + c, gl.TEXTURE_2D, target, 0);
+            drawBuffers.push(target ? gl.COLOR_ATTACHMENT0 + c : gl.NONE);
         }
-        if (views.obs) {
-            this.gl.activeTexture(this.gl.TEXTURE4);
-            this.gl.bindTexture(this.gl.TEXTURE_2D, this.texObs);
-            this.gl.texSubImage2D(this.gl.TEXTURE_2D, 0, 0, 0, this.width, this.height, this.gl.RED, this.gl.UNSIGNED_BYTE, views.obs);
+        gl.drawBuffers(drawBuffers);
+        gl.viewport(0, 0, this.width, this.height);
+
+        const isUint = packed.format === 4;
+        const levels = packed.format === 4 ? 65535 : 1;
+        const offset = packed.min;
+        const scale = packed.max.map((max, c) => (max - packed.min[c]) / levels);
+        const uniforms = isUint ? this.unpackUintUniforms : this.unpackUniforms;
+
+        gl.useProgram(isUint ? this.unpackUintProgram : this.unpackProgram);
+        gl.uniform1i(uniforms.packed, 0);
+        gl.uniform4f(uniforms.offset, offset[0], offset[1], offset[2], offset[3]);
+        gl.uniform4f(uniforms.scale, scale[0], scale[1], scale[2], scale[3]);
+        gl.bindVertexArray(this.quadVAO);
+        gl.drawArrays(gl.TRIANGLES, 0, 6);
+        gl.bindVertexArray(null);
+        gl.bindFramebuffer(gl.FRAMEBUFFER, null);
+    }
+
+    draw(views, vizParams, postParams, obsDirty) {
+        if (views.packed) {
+            this.uploadPacked(views.packed);
         }
-        if (views.temp) {
-            this.gl.activeTexture(this.gl.TEXTURE5);
-            this.gl.bindTexture(this.gl.TEXTURE_2D, this.texTemp);
-            this.gl.texSubImage2D(this.gl.TEXTURE_2D, 0, 0, 0, this.width, this.height, this.gl.RED, this.gl.FLOAT, views.temp);
+
+        const packedVorticity = views.packed && views.packed.channels.includes(6);
+        if (vizParams.mode === 0 && (views.ux || views.uy || (views.packed && !packedVorticity))) {
+            this.runVorticityPass();
         }
 
+        if (views.ux) this.uploadRows(this.gl.TEXTURE0, this.texUx, views.ux, this.gl.FLOAT);
+        if (views.uy) this.uploadRows(this.gl.TEXTURE1, this.texUy, views.uy, this.gl.FLOAT);
+        if (views.density) this.uploadRows(this.gl.TEXTURE2, this.texRho, views.density, this.gl.FLOAT);
+        if (views.dye) this.uploadRows(this.gl.TEXTURE3, this.texDye, views.dye, this.gl.FLOAT);
+        if (views.obs) this.uploadRects(this.gl.TEXTURE4, this.texObs, views.obs, this.gl.UNSIGNED_BYTE);
+        if (views.temp) this.uploadRows(this.gl.TEXTURE5, this.texTemp, views.temp, this.gl.FLOAT);
+
         const usePost = postParams && postParams.enabled;
         if (usePost) {
             this.gl.bindFramebuffer(this.gl.FRAMEBUFFER, this.postFBO);
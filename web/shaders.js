@@ -124,6 +124,47 @@ void main() {
     outColor = vec4(curl, 0.0, 0.0, 1.0);
 }`;
 
+const UNPACK_FS = `#version 300 es
+precision highp float;
+uniform sampler2D u_packed;
+uniform vec4 u_offset;
+uniform vec4 u_scale;
+in vec2 v_uv;
+layout(location = 0) out vec4 out_r;
+layout(location = 1) out vec4 out_g;
+layout(location = 2) out vec4 out_b;
+layout(location = 3) out vec4 out_a;
+
+void main() {
+    vec4 texel = u_offset + texture(u_packed, v_uv) * u_scale;
+    out_r = vec4(texel.r);
+    out_g = vec4(texel.g);
+    out_b = vec4(texel.b);
+    out_a = vec4(texel.a);
+}`;
+
+const UNPACK_UINT_FS = `#version 300 es
+precision highp float;
+precision highp usampler2D;
+uniform usampler2D u_packed;
+uniform vec4 u_offset;
+uniform vec4 u_scale;
+in vec2 v_uv;
+layout(location = 0) out vec4 out_r;
+layout(location = 1) out vec4 out_g;
+layout(location = 2) out vec4 out_b;
+layout(location = 3) out vec4 out_a;
+
+void main() {
+    ivec2 size = textureSize(u_packed, 0);
+    ivec2 coord = min(ivec2(v_uv * vec2(size)), size - 1);
+    vec4 texel = u_offset + vec4(texelFetch(u_packed, coord, 0)) * u_scale;
+    out_r = vec4(texel.r);
+    out_g = vec4(texel.g);
+    out_b = vec4(texel.b);
+    out_a = vec4(texel.a);
+}`;
+
 const COMMON_FS_PALETTES = `
 vec3 inferno(float t) {
     float r = 0.0002 + 1.2587 * t + 2.7681 * pow(t, 2.0) - 8.3619 * pow(t, 3.0);